@@ -0,0 +1,307 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "bitgrid.h"
+#include "engine.h"
+#include "grid.h"
+#include "hashlife.h"
+#include "lut_grid.h"
+#include "sparse_grid.h"
+#include "thread_pool.h"
+
+namespace {
+
+// 1, 2, 4, ... up to the number of cores, and at least 2 so that the pool is used
+std::vector<int> thread_counts() {
+    int cores = std::max(2, static_cast<int>(std::thread::hardware_concurrency()));
+    std::vector<int> counts;
+    for (int n = 1; n < cores; n *= 2) {
+        counts.push_back(n);
+    }
+    counts.push_back(cores);
+    return counts;
+}
+
+// Run "generations" generations from "first" on "threads" threads, with rule r
+// Returns the time taken in seconds, and the population at the end
+template <class Grid>
+std::pair<double, std::size_t> run(const Grid &first, int generations, int threads,
+                                   const rule &r) {
+    Grid current_generation = first;
+    Grid next_generation = first;
+    std::unique_ptr<ThreadPool> pool;
+    if (threads > 1) {
+        pool = std::make_unique<ThreadPool>(threads - 1);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int g = 0; g < generations; ++g) {
+        if (pool) {
+            calculate(*pool, current_generation, next_generation, r);
+        } else {
+            calculate(current_generation, next_generation, r);
+        }
+        std::swap(current_generation, next_generation);
+    }
+    std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+    return {time.count(), current_generation.population()};
+}
+
+// The name of a rule, and whether bitgrid has a kernel compiled for it
+std::string describe(const rule &r) {
+    for (const named_rule &compiled : compiled_rules) {
+        if (compiled.value == r) {
+            return rule_name(r) + " (" + compiled.name + ", compiled kernel)";
+        }
+    }
+    return rule_name(r) + " (generic kernel)";
+}
+
+template <class Grid> void scaling_benchmark(Grid first, const rule &r) {
+    // Enough generations for about a second on one thread
+    double once = run(first, 1, 1, r).first;
+    int generations = std::clamp(static_cast<int>(1.0 / once), 1, 10000);
+
+    double cells = static_cast<double>(first.rows()) * first.cols();
+    std::cout << first.rows() << " x " << first.cols() << " cells, " << generations
+              << " generations, rule " << describe(r) << '\n';
+    std::cout << std::setw(8) << "threads" << std::setw(14) << "ms/generation" << std::setw(16)
+              << "Gcell-updates/s" << std::setw(10) << "speedup" << std::setw(14)
+              << "population" << '\n';
+
+    double one_thread = 0;
+    std::size_t expected = 0;
+    for (int threads : thread_counts()) {
+        auto [seconds, population] = run(first, generations, threads, r);
+        if (threads == 1) {
+            one_thread = seconds;
+            expected = population;
+        }
+        std::cout << std::fixed << std::setprecision(2) << std::setw(8) << threads
+                  << std::setw(14) << 1000 * seconds / generations << std::setw(16)
+                  << cells * generations / seconds / 1e9 << std::setw(10)
+                  << one_thread / seconds << std::setw(14) << population
+                  << (population == expected ? "" : "  WRONG") << '\n';
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+// A few patches of 64 x 64 random cells, at random places
+template <class Engine> void add_patches(Engine &life) {
+    const int patches = 16;
+    const int size = 64;
+    std::mt19937 mt(2024);
+    std::uniform_int_distribution<int> row(0, std::max(life.rows() - size, 0));
+    std::uniform_int_distribution<int> column(0, std::max(life.cols() - size, 0));
+    for (int p = 0; p < patches; ++p) {
+        int top = row(mt);
+        int left = column(mt);
+        for (int r = top; r < std::min(top + size, life.rows()); ++r) {
+            for (int c = left; c < std::min(left + size, life.cols()); ++c) {
+                if (mt() % 3 == 0) {
+                    life.create(r, c);
+                }
+            }
+        }
+    }
+}
+
+// Run "generations" generations of "life", and return the time taken in seconds
+template <class Engine> double time_generations(Engine &life, int generations) {
+    auto start = std::chrono::steady_clock::now();
+    for (int g = 0; g < generations; ++g) {
+        life.step();
+    }
+    std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+    return time.count();
+}
+
+// Gosper's glider gun, which sends a glider to the south-east every 30 generations
+const char *const glider_gun[] = {
+    "........................O...........",
+    "......................O.O...........",
+    "............OO......OO............OO",
+    "...........O...O....OO............OO",
+    "OO........O.....O...OO..............",
+    "OO........O...O.OO....O.O...........",
+    "..........O.....O.......O...........",
+    "...........O...O....................",
+    "............OO......................",
+};
+
+template <class Engine> void add_glider_gun(Engine &life, int top, int left) {
+    for (int r = 0; r < static_cast<int>(std::size(glider_gun)); ++r) {
+        for (int c = 0; glider_gun[r][c] != '\0'; ++c) {
+            if (glider_gun[r][c] == 'O') {
+                life.create(top + r, left + c);
+            }
+        }
+    }
+}
+
+} // namespace
+
+void scaling_benchmark(const std::string &engine, int rows, int cols, bool torus,
+                       const rule &r) {
+    // The same cells on every run, and for every grid
+    if (engine == "bit") {
+        bitgrid first(rows, cols, torus);
+        first.randomize(2024, 0.2);
+        scaling_benchmark(first, r);
+    } else if (engine == "lut") {
+        lut_grid first(rows, cols, torus);
+        first.randomize(2024, 0.2);
+        scaling_benchmark(first, r);
+    } else {
+        grid first(rows, cols, torus);
+        first.randomize(2024, 0.2);
+        scaling_benchmark(first, r);
+    }
+}
+
+void kernel_benchmark(int rows, int cols, bool torus, const rule &r) {
+    grid naive(rows, cols, torus);
+    bitgrid bits(rows, cols, torus);
+    lut_grid table(rows, cols, torus);
+    naive.randomize(2024, 0.2);
+    bits.randomize(2024, 0.2);
+    table.randomize(2024, 0.2);
+
+    // Enough generations for about a second with the fastest kernel
+    double once = run(bits, 1, 1, r).first;
+    int generations = std::clamp(static_cast<int>(1.0 / once), 1, 10000);
+
+    double cells = static_cast<double>(rows) * cols;
+    std::cout << rows << " x " << cols << " cells, " << generations
+              << " generations, 1 thread, rule " << describe(r) << '\n';
+    std::cout << std::setw(20) << "kernel" << std::setw(14) << "ms/generation" << std::setw(16)
+              << "Gcell-updates/s" << std::setw(14) << "population" << '\n';
+
+    std::size_t expected = 0;
+    auto report = [&](const std::string &name, double seconds, std::size_t population) {
+        if (expected == 0) {
+            expected = population;
+        }
+        std::cout << std::fixed << std::setprecision(3) << std::setw(20) << name
+                  << std::setw(14) << 1000 * seconds / generations << std::setw(16)
+                  << cells * generations / seconds / 1e9 << std::setw(14) << population
+                  << (population == expected ? "" : "  WRONG") << '\n';
+    };
+
+    // The grid of cells is much slower, so it runs fewer generations, and its
+    // population is not compared
+    int naive_generations = std::max(1, generations / 50);
+    auto [naive_seconds, naive_population] = run(naive, naive_generations, 1, r);
+    std::cout << std::fixed << std::setprecision(3) << std::setw(20) << "grid (naive)"
+              << std::setw(14) << 1000 * naive_seconds / naive_generations << std::setw(16)
+              << cells * naive_generations / naive_seconds / 1e9 << std::setw(14)
+              << naive_population << "  (" << naive_generations << " generations)\n";
+
+    for (isa set : {isa::scalar, isa::sse2, isa::avx2, isa::avx512}) {
+        if (set > detect_isa()) {
+            continue;
+        }
+        bitgrid current_generation = bits;
+        bitgrid next_generation = bits;
+        auto start = std::chrono::steady_clock::now();
+        for (int g = 0; g < generations; ++g) {
+            calculate(current_generation, next_generation, set, r);
+            std::swap(current_generation, next_generation);
+        }
+        std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+        report(std::string("bitgrid ") + isa_name(set), time.count(),
+               current_generation.population());
+    }
+
+    auto [table_seconds, table_population] = run(table, generations, 1, r);
+    report("lut_grid", table_seconds, table_population);
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+void sparse_benchmark(int rows, int cols, bool torus, const rule &r) {
+    ThreadPool pool;
+    double_buffered<bitgrid> dense(pool, rows, cols, torus, r);
+    sparse_grid sparse(pool, rows, cols, torus, r);
+    add_patches(dense);
+    add_patches(sparse);
+
+    // Enough generations for about a second with the dense grid
+    double once = time_generations(dense, 1);
+    int generations = std::clamp(static_cast<int>(1.0 / once), 1, 10000);
+    double dense_seconds = time_generations(dense, generations - 1) + once;
+
+    // Count the tiles calculated in each generation
+    std::size_t tiles_calculated = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int g = 0; g < generations; ++g) {
+        sparse.step();
+        tiles_calculated += sparse.active();
+    }
+    std::chrono::duration<double> sparse_seconds = std::chrono::steady_clock::now() - start;
+
+    double cells = static_cast<double>(rows) * cols;
+    std::cout << rows << " x " << cols << " cells, " << generations << " generations, "
+              << pool.size() + 1 << " threads\n";
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "bitgrid      " << std::setw(10) << 1000 * dense_seconds / generations
+              << " ms/generation " << std::setw(10) << cells * generations / dense_seconds / 1e9
+              << " Gcell-updates/s\n";
+    std::cout << "sparse_grid  " << std::setw(10) << 1000 * sparse_seconds.count() / generations
+              << " ms/generation " << std::setw(10)
+              << cells * generations / sparse_seconds.count() / 1e9 << " Gcell-updates/s, "
+              << 100.0 * tiles_calculated / generations / sparse.tiles()
+              << "% of the tiles calculated\n";
+    std::cout << std::defaultfloat << std::setprecision(6);
+    std::cout << "Speedup " << dense_seconds / sparse_seconds.count() << ", population "
+              << sparse.population()
+              << (sparse.population() == dense.population() ? " (the same)" : " WRONG") << '\n';
+}
+
+void hashlife_benchmark() {
+    // The gliders move a quarter of a cell per generation: after 1024 generations
+    // they are still far from the edges
+    const int first_generations = 1024;
+    bitgrid current_generation(600, 600);
+    bitgrid next_generation(600, 600);
+    add_glider_gun(current_generation, 10, 10);
+    for (int g = 0; g < first_generations; ++g) {
+        calculate(current_generation, next_generation);
+        std::swap(current_generation, next_generation);
+    }
+
+    hashlife life;
+    add_glider_gun(life, 10, 10);
+    life.advance(10);
+    bool same = life.population() == current_generation.population();
+    for (int row = 0; row < current_generation.rows() && same; ++row) {
+        for (int column = 0; column < current_generation.cols(); ++column) {
+            same = same && life.is_alive(row, column) == current_generation.is_alive(row, column);
+        }
+    }
+    std::cout << "Gosper's glider gun, generation " << first_generations << ": "
+              << (same ? "the same as bitgrid" : "WRONG, not the same as bitgrid") << '\n';
+
+    std::cout << std::setw(16) << "generation" << std::setw(16) << "population" << std::setw(12)
+              << "ms" << std::setw(12) << "nodes" << '\n';
+    for (int log2 = 10; log2 <= 40; ++log2) {
+        // From generation 2^log2 to 2^(log2 + 1)
+        auto start = std::chrono::steady_clock::now();
+        life.advance(log2);
+        std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+        std::cout << std::fixed << std::setprecision(3) << std::setw(16) << life.generation()
+                  << std::setw(16) << life.population() << std::setw(12) << time.count()
+                  << std::setw(12) << life.node_count() << '\n';
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+    std::cout << life.collection_count() << " garbage collections\n";
+}
@@ -0,0 +1,30 @@
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include <string>
+
+#include "rule.h"
+
+// Time the parallel calculate() on a random grid, on 1, 2, 4, ... threads, up to one per core
+// Each thread count runs from the same first generation, for about a second, and prints the
+// cell updates per second and the speedup over one thread.
+// One thread calls the sequential calculate(); n threads use a pool of n - 1 workers, since
+// the calling thread also calculates bands while it waits.
+// "engine" is "grid", "bit" or "lut".
+void scaling_benchmark(const std::string &engine, int rows, int cols, bool torus,
+                       const rule &r = conway);
+
+// Compare the kernels on one thread, on the same random cells: grid's
+// will_survive() and will_create(), bitgrid's bit-sliced adders for each
+// instruction set, and lut_grid's lookup table
+void kernel_benchmark(int rows, int cols, bool torus, const rule &r = conway);
+
+// Compare sparse_grid with the dense bitgrid on an empty universe with a few
+// small random patches, for about a second each
+void sparse_benchmark(int rows, int cols, bool torus, const rule &r = conway);
+
+// Run Gosper's glider gun with hashlife, from 2^10 generations up to 2^40, doubling each time
+// The first 1024 generations are checked against bitgrid.
+void hashlife_benchmark();
+
+#endif // BENCHMARK_H_
@@ -0,0 +1,399 @@
+#include "bitgrid.h"
+
+#include "random_cells.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+// Constructor
+// All the cells are dead
+bitgrid::bitgrid(int rows, int cols, bool torus)
+    : nrows(rows), ncols(cols), toroidal(torus), nwords((cols + 63) / 64), stride(nwords + 2),
+      bits((rows + 2) * stride) {}
+
+// Populate the grid with cells, at random
+// The words of random_cells are the words of the grid, so that large grids are quick to fill
+void bitgrid::randomize(std::uint64_t seed, double density) {
+    random_cells cells(seed, density);
+
+    for (int row = 0; row < nrows; ++row) {
+        std::uint64_t *words = row_bits(row);
+        for (std::size_t w = 0; w < nwords; ++w) {
+            words[w] = cells.next_word();
+        }
+        words[nwords - 1] &= last_word_mask();
+    }
+}
+
+// On a toroidal grid, copy each edge next to the opposite edge
+void bitgrid::wrap() {
+    if (!toroidal) {
+        return;
+    }
+
+    int tail = ncols % 64;
+    for (int row = 0; row < nrows; ++row) {
+        std::uint64_t *words = row_bits(row);
+        std::uint64_t first = words[0] & 1;
+        std::uint64_t last = is_alive(row, ncols - 1);
+
+        // The last column goes in the top bit of the extra word before the row
+        words[-1] = last << 63;
+
+        // Column 0 goes in the first bit after the last column: the extra word
+        // after the row, or the unused bits of the last word
+        if (tail == 0) {
+            words[nwords] = first;
+        } else {
+            words[nwords - 1] = (words[nwords - 1] & last_word_mask()) | first << tail;
+        }
+    }
+
+    // The last and first rows, with their extra words, go in the extra rows
+    std::copy_n(row_bits(nrows - 1) - 1, stride, row_bits(-1) - 1);
+    std::copy_n(row_bits(0) - 1, stride, row_bits(nrows) - 1);
+}
+
+// Number of live cells
+std::size_t bitgrid::population() const {
+    std::size_t count = 0;
+    for (int row = 0; row < nrows; ++row) {
+        const std::uint64_t *words = row_bits(row);
+        for (std::size_t w = 0; w + 1 < nwords; ++w) {
+            count += std::popcount(words[w]);
+        }
+        // After wrap(), the bit after the last column may be set
+        count += std::popcount(words[nwords - 1] & last_word_mask());
+    }
+    return count;
+}
+
+namespace {
+
+// W words in one register. With W == 1, just a word.
+// The kernels are written once, with the GCC/Clang vector extensions, and compiled for
+// each instruction set inside a function with a "target" attribute.
+template <int W> struct simd {
+    typedef std::uint64_t type __attribute__((vector_size(W * sizeof(std::uint64_t))));
+};
+template <> struct simd<1> {
+    using type = std::uint64_t;
+};
+template <int W> using vec = typename simd<W>::type;
+
+// Unaligned loads and stores. Vectors are passed by reference: passing them by value to a
+// function compiled without AVX would use a different calling convention.
+template <class V> [[gnu::always_inline]] inline void load(V &v, const std::uint64_t *p) {
+    std::memcpy(&v, p, sizeof(v));
+}
+template <class V> [[gnu::always_inline]] inline void store(std::uint64_t *p, const V &v) {
+    std::memcpy(p, &v, sizeof(v));
+}
+
+// The words at p, and the same cells' neighbours to the west (column - 1) and east (column + 1)
+// Bit 0 of "west" comes from the word before, bit 63 of "east" from the word after.
+template <class V>
+[[gnu::always_inline]] inline void load_row(V &west, V &centre, V &east, const std::uint64_t *p) {
+    V before, after;
+    load(before, p - 1);
+    load(centre, p);
+    load(after, p + 1);
+    west = (centre << 1) | (before >> 63);
+    east = (centre >> 1) | (after << 63);
+}
+
+// The rule of a kernel
+// fixed_rule<R> has the rule as a template argument, so only the terms which R needs are
+// compiled, and nothing tests the rule as the cells are calculated. any_rule reads the rule
+// at runtime instead: each count is added under a mask of all ones or all zeros, which
+// still needs no branches, but adds every count.
+template <rule R> struct fixed_rule {};
+
+struct any_rule {
+    // All ones if a dead cell with n neighbours is born, or a live one survives
+    std::uint64_t birth[9];
+    std::uint64_t survival[9];
+
+    explicit any_rule(const rule &r) {
+        for (int n = 0; n <= 8; ++n) {
+            birth[n] = r.born(n) ? ~std::uint64_t{0} : 0;
+            survival[n] = r.survives(n) ? ~std::uint64_t{0} : 0;
+        }
+    }
+};
+
+// Add to "next" the cells with N neighbours which are alive in the next generation
+// count[i] is bit i of the number of neighbours of each cell.
+template <int N, class V>
+[[gnu::always_inline]] inline void count_is(V &equal, const V (&count)[4]) {
+    equal = (N & 1 ? count[0] : ~count[0]) & (N & 2 ? count[1] : ~count[1]) &
+            (N & 4 ? count[2] : ~count[2]) & (N & 8 ? count[3] : ~count[3]);
+}
+
+template <int N, rule R, class V>
+[[gnu::always_inline]] inline void add_count(V &next, const fixed_rule<R> &, const V &centre,
+                                             const V (&count)[4]) {
+    if constexpr (R.born(N) || R.survives(N)) {
+        V equal;
+        count_is<N>(equal, count);
+        if constexpr (R.born(N) && R.survives(N)) {
+            next |= equal;
+        } else if constexpr (R.born(N)) {
+            next |= equal & ~centre;
+        } else {
+            next |= equal & centre;
+        }
+    }
+}
+
+template <int N, class V>
+[[gnu::always_inline]] inline void add_count(V &next, const any_rule &rule, const V &centre,
+                                             const V (&count)[4]) {
+    V equal;
+    count_is<N>(equal, count);
+    next |= equal & ((~centre & rule.birth[N]) | (centre & rule.survival[N]));
+}
+
+template <class Rule, class V, int... N>
+[[gnu::always_inline]] inline void add_counts(V &next, const Rule &rule, const V &centre,
+                                              const V (&count)[4],
+                                              std::integer_sequence<int, N...>) {
+    next = V{};
+    (add_count<N>(next, rule, centre, count), ...);
+}
+
+// "next" gets one bit of the next generation for each bit of the words at "mid"
+//
+// The eight neighbours are added bit by bit, with no carries between bit positions:
+// - A full adder adds the three cells above: a0 ^ b0 ^ c0 is the low bit of the sum, and the
+//   carry is set where at least two of them are set. The same for the three cells below, and a
+//   half adder for the two at each side.
+// - The three low bits are added the same way, which gives bit 0 of the count and one more
+//   carry.
+// - The four values of weight 2 are added as two pairs: bit 1 is their parity, and each pair
+//   which is full, or the two pairs' odd bits together, carry 4. Both pairs full is 8.
+// - With Conway's rule, the count is 2 or 3 when exactly one of the four values of weight 2 is
+//   set and nothing carries 4. Then the cell is alive if bit 0 is set (3 neighbours: a birth
+//   or a survival), or if it was alive (2 neighbours: a survival). Other rules compare the
+//   count with each number of neighbours of the rule.
+template <class Rule, class V>
+[[gnu::always_inline]] inline void next_cells(V &next, const Rule &rule, const std::uint64_t *up,
+                                              const std::uint64_t *mid, const std::uint64_t *down) {
+    V up_w, up_c, up_e, west, centre, east, down_w, down_c, down_e;
+    load_row(up_w, up_c, up_e, up);
+    load_row(west, centre, east, mid);
+    load_row(down_w, down_c, down_e, down);
+
+    V up_x = up_w ^ up_c;
+    V up0 = up_x ^ up_e;
+    V up1 = (up_w & up_c) | (up_x & up_e);
+    V side0 = west ^ east;
+    V side1 = west & east;
+    V down_x = down_w ^ down_c;
+    V down0 = down_x ^ down_e;
+    V down1 = (down_w & down_c) | (down_x & down_e);
+
+    V low_x = up0 ^ side0;
+    V bit0 = low_x ^ down0;
+    V carry = (up0 & side0) | (low_x & down0);
+
+    V p = up1 ^ side1;
+    V q = down1 ^ carry;
+    V odd = p ^ q;
+    V full_p = up1 & side1;
+    V full_q = down1 & carry;
+    V both = p & q;
+    if constexpr (std::is_same_v<Rule, fixed_rule<conway>>) {
+        next = odd & ~(full_p | full_q | both) & (bit0 | centre);
+    } else {
+        V count[4] = {bit0, odd, full_p ^ full_q ^ both, full_p & full_q};
+        add_counts(next, rule, centre, count, std::make_integer_sequence<int, 9>{});
+    }
+}
+
+// Calculate one row, W words at a time, then the remaining words one at a time
+template <int W, class Rule>
+[[gnu::always_inline]] inline void calculate_row(const Rule &rule, const std::uint64_t *up,
+                                                 const std::uint64_t *mid,
+                                                 const std::uint64_t *down, std::uint64_t *out,
+                                                 std::size_t nwords) {
+    std::size_t w = 0;
+    if constexpr (W > 1) {
+        for (; w + W <= nwords; w += W) {
+            vec<W> next;
+            next_cells(next, rule, up + w, mid + w, down + w);
+            store(out + w, next);
+        }
+    }
+    for (; w < nwords; ++w) {
+        next_cells(out[w], rule, up + w, mid + w, down + w);
+    }
+}
+
+// Calculate the cells of "block"
+// The rows above and below it are only read, so blocks can be calculated in parallel
+template <int W, class Rule>
+[[gnu::always_inline]] inline void calculate_cells(const bitgrid &old_generation,
+                                                   bitgrid &new_generation,
+                                                   const bit_block &block, const Rule &rule) {
+    // Bits beyond the last column of the last word must stay dead
+    bool last_word = block.word_end == old_generation.words();
+    std::uint64_t tail_mask = old_generation.last_word_mask();
+    std::size_t w = block.word_begin;
+    std::size_t nwords = block.word_end - w;
+
+    for (int row = block.row_begin; row < block.row_end; ++row) {
+        std::uint64_t *out = new_generation.row_bits(row) + w;
+        calculate_row<W>(rule, old_generation.row_bits(row - 1) + w,
+                         old_generation.row_bits(row) + w, old_generation.row_bits(row + 1) + w,
+                         out, nwords);
+        if (last_word) {
+            out[nwords - 1] &= tail_mask;
+        }
+    }
+}
+
+template <class Rule>
+void calculate_scalar(const bitgrid &old_generation, bitgrid &new_generation,
+                      const bit_block &block, const Rule &rule) {
+    calculate_cells<1>(old_generation, new_generation, block, rule);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BITGRID_X86 1
+
+// SSE2 is part of x86-64, so this needs no attribute
+template <class Rule>
+void calculate_sse2(const bitgrid &old_generation, bitgrid &new_generation,
+                    const bit_block &block, const Rule &rule) {
+    calculate_cells<2>(old_generation, new_generation, block, rule);
+}
+
+template <class Rule>
+[[gnu::target("avx2")]] void calculate_avx2(const bitgrid &old_generation,
+                                            bitgrid &new_generation, const bit_block &block,
+                                            const Rule &rule) {
+    calculate_cells<4>(old_generation, new_generation, block, rule);
+}
+
+template <class Rule>
+[[gnu::target("avx512f")]] void calculate_avx512(const bitgrid &old_generation,
+                                                 bitgrid &new_generation, const bit_block &block,
+                                                 const Rule &rule) {
+    calculate_cells<8>(old_generation, new_generation, block, rule);
+}
+#endif
+
+// Calculate the cells of "block" with the kernel for "set" and "rule"
+template <class Rule>
+void calculate_with(const bitgrid &old_generation, bitgrid &new_generation,
+                    const bit_block &block, isa set, const Rule &rule) {
+    switch (set) {
+#ifdef BITGRID_X86
+    case isa::sse2:
+        calculate_sse2(old_generation, new_generation, block, rule);
+        return;
+    case isa::avx2:
+        calculate_avx2(old_generation, new_generation, block, rule);
+        return;
+    case isa::avx512:
+        calculate_avx512(old_generation, new_generation, block, rule);
+        return;
+#endif
+    default:
+        calculate_scalar(old_generation, new_generation, block, rule);
+    }
+}
+
+// The same, with the kernel compiled for r if it is one of compiled_rules[I...], or the
+// generic kernel
+template <std::size_t... I>
+void calculate_rule(const bitgrid &old_generation, bitgrid &new_generation,
+                    const bit_block &block, isa set, const rule &r, std::index_sequence<I...>) {
+    bool compiled = ((r == compiled_rules[I].value &&
+                      (calculate_with(old_generation, new_generation, block, set,
+                                      fixed_rule<compiled_rules[I].value>{}),
+                       true)) ||
+                     ...);
+    if (!compiled) {
+        calculate_with(old_generation, new_generation, block, set, any_rule(r));
+    }
+}
+
+} // namespace
+
+// Calculate the cells of "block" with the kernel for "set" and "r"
+void calculate_block(const bitgrid &old_generation, bitgrid &new_generation,
+                     const bit_block &block, isa set, const rule &r) {
+    calculate_rule(old_generation, new_generation, block, set, r,
+                   std::make_index_sequence<std::size(compiled_rules)>{});
+}
+
+// The same, with the best kernel for this CPU
+void calculate_block(const bitgrid &old_generation, bitgrid &new_generation,
+                     const bit_block &block, const rule &r) {
+    static const isa best = detect_isa();
+    calculate_block(old_generation, new_generation, block, best, r);
+}
+
+const char *isa_name(isa set) {
+    switch (set) {
+    case isa::scalar:
+        return "scalar";
+    case isa::sse2:
+        return "SSE2";
+    case isa::avx2:
+        return "AVX2";
+    case isa::avx512:
+        return "AVX-512";
+    }
+    return "unknown";
+}
+
+// The best instruction set supported by this CPU
+isa detect_isa() {
+#ifdef BITGRID_X86
+    if (__builtin_cpu_supports("avx512f"))
+        return isa::avx512;
+    if (__builtin_cpu_supports("avx2"))
+        return isa::avx2;
+    if (__builtin_cpu_supports("sse2"))
+        return isa::sse2;
+#endif
+    return isa::scalar;
+}
+
+// Calculate the next generation with the best kernel for this CPU
+void calculate(bitgrid &old_generation, bitgrid &new_generation, const rule &r) {
+    static const isa best = detect_isa();
+    calculate(old_generation, new_generation, best, r);
+}
+
+// Calculate the next generation with the kernel for "set"
+void calculate(bitgrid &old_generation, bitgrid &new_generation, isa set, const rule &r) {
+    old_generation.wrap();
+    bit_block all{0, old_generation.rows(), 0, old_generation.words()};
+    calculate_block(old_generation, new_generation, all, set, r);
+}
+
+// Calculate the next generation in bands of rows, in parallel
+// Each band reads the row above it and the row below it from old_generation, which no
+// task writes, so the bands need no synchronization until the end of the generation.
+void calculate(ThreadPool &pool, bitgrid &old_generation, bitgrid &new_generation,
+               const rule &r) {
+    old_generation.wrap();
+
+    std::size_t rows = old_generation.rows();
+    std::size_t nbands = std::min(block_count(pool, rows * old_generation.words()), rows);
+    parallel_blocks(pool, nbands, [&](std::size_t band) {
+        bit_block block{static_cast<int>(block_begin(rows, nbands, band)),
+                        static_cast<int>(block_begin(rows, nbands, band + 1)), 0,
+                        old_generation.words()};
+        calculate_block(old_generation, new_generation, block, r);
+    });
+}
@@ -0,0 +1,125 @@
+#ifndef BITGRID_H_
+#define BITGRID_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "life.h"
+#include "rule.h"
+
+class ThreadPool;
+
+// A grid which stores one cell per bit, 64 cells in each 64-bit word
+//
+// grid stores one bool per cell, and will_survive() and will_create() each load
+// the eight neighbours of a cell one by one. Here a whole word of cells is
+// calculated at once: the neighbours of 64 cells are 8 words (the words above,
+// below, and the same words shifted one column to the left and to the right),
+// and they are added with logic operations, as a circuit of full adders would
+// add them. Each bit position is a separate 4-bit sum. With SIMD, 4 words are
+// calculated at once with AVX2, 8 with AVX-512.
+//
+// Cell (row, column) is bit column % 64 of word column / 64 of that row.
+// The rows are stored one after the other in one block of memory, so a grid
+// of 100,000 by 100,000 cells takes 1.25 GB.
+// Each row has an extra word on each side, and there is an extra row above
+// and below. They are empty, so cells beyond the edges are dead. On a
+// toroidal grid, wrap() copies the opposite edges into them instead.
+class bitgrid {
+    int nrows;
+    int ncols;
+    // Do the edges wrap around?
+    bool toroidal;
+    // Words in a row, without the extra words
+    std::size_t nwords;
+    // Words from one row to the next, with the extra words
+    std::size_t stride;
+    std::vector<std::uint64_t> bits;
+
+  public:
+    // Constructor
+    // All the cells are dead
+    bitgrid(int rows = default_rows, int cols = default_cols, bool torus = false);
+
+    int rows() const { return nrows; }
+    int cols() const { return ncols; }
+    bool is_toroidal() const { return toroidal; }
+    std::size_t words() const { return nwords; }
+
+    // The bits of the last word of a row which are cells
+    std::uint64_t last_word_mask() const {
+        return ncols % 64 == 0 ? ~std::uint64_t{0} : (std::uint64_t{1} << ncols % 64) - 1;
+    }
+
+    // The first word of a row. row may be -1 or rows(), the extra rows.
+    const std::uint64_t *row_bits(int row) const { return &bits[(row + 1) * stride + 1]; }
+    std::uint64_t *row_bits(int row) { return &bits[(row + 1) * stride + 1]; }
+
+    bool is_alive(int row, int column) const {
+        return (row_bits(row)[column / 64] >> (column % 64)) & 1;
+    }
+
+    // Create a cell at (row, column)
+    void create(int row, int column) {
+        row_bits(row)[column / 64] |= std::uint64_t{1} << (column % 64);
+    }
+
+    // Erase the cell at (row, column)
+    void erase(int row, int column) {
+        row_bits(row)[column / 64] &= ~(std::uint64_t{1} << (column % 64));
+    }
+
+    // Populate the grid with cells, at random
+    // Each cell is alive with probability "density". The same seed gives the
+    // same cells in every engine.
+    void randomize(std::uint64_t seed, double density);
+
+    // On a toroidal grid, copy each edge next to the opposite edge:
+    // the last column before column 0, column 0 after the last column,
+    // and the last and first rows into the extra rows
+    void wrap();
+
+    // Number of live cells
+    std::size_t population() const;
+};
+
+// Rows [row_begin, row_end) of words [word_begin, word_end) of a bitgrid
+struct bit_block {
+    int row_begin;
+    int row_end;
+    std::size_t word_begin;
+    std::size_t word_end;
+};
+
+// Instruction sets for calculate(), from the most widely available
+enum class isa { scalar, sse2, avx2, avx512 };
+
+const char *isa_name(isa set);
+
+// The best instruction set supported by this CPU
+isa detect_isa();
+
+// Calculate the next generation into new_generation, which must have the same size, with rule r
+// Every cell of new_generation is written, so it does not need to be cleared
+// old_generation is wrapped first, if it is toroidal
+// The rules of compiled_rules have a kernel of their own; any other rule is slower.
+void calculate(bitgrid &old_generation, bitgrid &new_generation, const rule &r = conway);
+
+// The same, with the kernel for "set", which the CPU must support
+void calculate(bitgrid &old_generation, bitgrid &new_generation, isa set,
+               const rule &r = conway);
+
+// The same, in parallel: the rows are split into bands, one task per band
+void calculate(ThreadPool &pool, bitgrid &old_generation, bitgrid &new_generation,
+               const rule &r = conway);
+
+// Calculate only the cells of "block", with the kernel for "set", or the best one
+// old_generation must have been wrapped, if it is toroidal. Blocks which do not
+// overlap can be calculated in parallel.
+void calculate_block(const bitgrid &old_generation, bitgrid &new_generation,
+                     const bit_block &block, isa set, const rule &r = conway);
+void calculate_block(const bitgrid &old_generation, bitgrid &new_generation,
+                     const bit_block &block, const rule &r = conway);
+
+#endif // BITGRID_H_
@@ -1,10 +1,6 @@
 #ifndef CELL_H_
 #define CELL_H_
 
-#include <iostream>
-
-#include "life.h"
-
 class cell {
     // Cell status
     bool alive;
@@ -14,9 +10,6 @@ class cell {
     // Cells are empty by default
     cell() : alive(false) {}
 
-    // Draw the cell on the grid
-    void draw(int row, int col) const;
-
     // Bring cell to life
     void create() { alive = true; }
 
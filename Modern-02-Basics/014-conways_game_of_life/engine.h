@@ -0,0 +1,53 @@
+#ifndef ENGINE_H_
+#define ENGINE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "rule.h"
+#include "thread_pool.h"
+
+// The engines which main() runs all hold the current generation, and have
+//     rows(), cols(), is_alive(row, column), create(row, column),
+//     randomize(seed, density), population(), and step()
+// where step() calculates the next generation. A renderer draws them.
+//
+// grid and bitgrid are a single generation, calculated into another grid by
+// calculate(). This runs them as an engine: it keeps two grids, which swap
+// after each generation. calculate() writes every cell of the next
+// generation, so nothing is cleared or copied. std::swap() only swaps the
+// grids' pointers to their cells.
+template <class Grid> class double_buffered {
+    ThreadPool &pool;
+    rule life_rule;
+    Grid current_generation;
+    Grid next_generation;
+
+  public:
+    double_buffered(ThreadPool &pool, int rows, int cols, bool torus, const rule &r = conway)
+        : pool(pool), life_rule(r), current_generation(rows, cols, torus),
+          next_generation(rows, cols, torus) {}
+
+    int rows() const { return current_generation.rows(); }
+    int cols() const { return current_generation.cols(); }
+    const Grid &cells() const { return current_generation; }
+
+    bool is_alive(int row, int column) const {
+        return current_generation.is_alive(row, column);
+    }
+    void create(int row, int column) { current_generation.create(row, column); }
+
+    void randomize(std::uint64_t seed, double density) {
+        current_generation.randomize(seed, density);
+    }
+    std::size_t population() const { return current_generation.population(); }
+
+    // Calculate the next generation, in parallel
+    void step() {
+        calculate(pool, current_generation, next_generation, life_rule);
+        std::swap(current_generation, next_generation);
+    }
+};
+
+#endif // ENGINE_H_
@@ -1,44 +1,70 @@
 #include "grid.h"
 
+#include "random_cells.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+
+// Constructor
+// All the cells are dead
+grid::grid(int rows, int cols, bool torus)
+    : nrows(rows), ncols(cols), toroidal(torus),
+      cells(static_cast<std::size_t>(rows + 2) * (cols + 2)) {}
+
 // Create a cell at (row, column)
-void grid::create(int row, int column) { cells[row][column].create(); }
-
-// Draw all the cells, including the border
-void grid::draw() {
-    // ANSI control command
-    // \x1b means "escape"
-    // Escape[2J clears the screen and returns the cursor to the "home" position
-    std::cout << "\x1b[2J";
-
-    for (int row = 0; row < rowmax; ++row) {
-        for (int column = 0; column < colmax; ++column) {
-            cells[row][column].draw(row, column);
+void grid::create(int row, int column) { at(row, column).create(); }
+
+// Erase the cell at (row, column)
+void grid::erase(int row, int column) { at(row, column).erase(); }
+
+// Populate the grid with cells, at random
+// Bit b of each word of random_cells is column b of the next 64
+void grid::randomize(std::uint64_t seed, double density) {
+    random_cells cells(seed, density);
+
+    for (int row = 0; row < nrows; ++row) {
+        for (int first = 0; first < ncols; first += 64) {
+            std::uint64_t word = cells.next_word();
+            for (int column = first; column < std::min(first + 64, ncols); ++column) {
+                if ((word >> (column - first)) & 1) {
+                    create(row, column);
+                }
+            }
         }
     }
 }
 
-// Populate the grid with cells, at random
-void grid::randomize() {
-    const int factor = 5;
-    const int cutoff = RAND_MAX / factor;
-    time_t now;
-    time(&now);
-
-    // Uncomment to use the current time as the seed for truly random cells
-    srand(now);
-
-    for (int row = 1; row < rowmax; ++row) {
-        for (int column = 1; column < colmax; ++column) {
-            if (rand() / cutoff == 0) {
-                create(row, column);
-            }
+// Number of live cells
+std::size_t grid::population() const {
+    std::size_t count = 0;
+    for (int row = 0; row < nrows; ++row) {
+        for (int column = 0; column < ncols; ++column) {
+            count += at(row, column).is_alive();
         }
     }
+    return count;
+}
+
+// On a toroidal grid, copy each edge into the border on the opposite side
+void grid::wrap() {
+    if (!toroidal) {
+        return;
+    }
+
+    // The left and right borders
+    for (int row = 0; row < nrows; ++row) {
+        at(row, -1) = at(row, ncols - 1);
+        at(row, ncols) = at(row, 0);
+    }
+
+    // The top and bottom borders, with the corners
+    std::copy_n(&at(nrows - 1, -1), ncols + 2, &at(-1, -1));
+    std::copy_n(&at(0, -1), ncols + 2, &at(nrows, -1));
 }
 
 // Will the cell at (row, column) survive to the next generation?
-bool grid::will_survive(int row, int column) {
-    if (!cells[row][column].is_alive()) {
+bool grid::will_survive(int row, int column, const rule &r) {
+    if (!at(row, column).is_alive()) {
         // There is no cell at this position!
         return false;
     }
@@ -48,12 +74,12 @@ bool grid::will_survive(int row, int column) {
     //   x x x
     //   x o x
     //   x x x
-    int neighbours = cells[row - 1][column - 1].is_alive() + cells[row - 1][column].is_alive() +
-                     cells[row - 1][column + 1].is_alive() + cells[row][column - 1].is_alive() +
-                     cells[row][column + 1].is_alive() + cells[row + 1][column - 1].is_alive() +
-                     cells[row + 1][column].is_alive() + cells[row + 1][column + 1].is_alive();
+    int neighbours = at(row - 1, column - 1).is_alive() + at(row - 1, column).is_alive() +
+                     at(row - 1, column + 1).is_alive() + at(row, column - 1).is_alive() +
+                     at(row, column + 1).is_alive() + at(row + 1, column - 1).is_alive() +
+                     at(row + 1, column).is_alive() + at(row + 1, column + 1).is_alive();
 
-    if (neighbours < min_neighbours || neighbours > max_neighbours) {
+    if (!r.survives(neighbours)) {
         // Cell has died
         return false;
     }
@@ -63,8 +89,8 @@ bool grid::will_survive(int row, int column) {
 }
 
 // Will a cell be born at (row, column) in the next generation?
-bool grid::will_create(int row, int column) {
-    if (cells[row][column].is_alive()) {
+bool grid::will_create(int row, int column, const rule &r) {
+    if (at(row, column).is_alive()) {
         // There already is a cell at this position!
         return false;
     }
@@ -74,12 +100,12 @@ bool grid::will_create(int row, int column) {
     //   x x x
     //   x o x
     //   x x x
-    int parents = cells[row - 1][column - 1].is_alive() + cells[row - 1][column].is_alive() +
-                  cells[row - 1][column + 1].is_alive() + cells[row][column - 1].is_alive() +
-                  cells[row][column + 1].is_alive() + cells[row + 1][column - 1].is_alive() +
-                  cells[row + 1][column].is_alive() + cells[row + 1][column + 1].is_alive();
+    int parents = at(row - 1, column - 1).is_alive() + at(row - 1, column).is_alive() +
+                  at(row - 1, column + 1).is_alive() + at(row, column - 1).is_alive() +
+                  at(row, column + 1).is_alive() + at(row + 1, column - 1).is_alive() +
+                  at(row + 1, column).is_alive() + at(row + 1, column + 1).is_alive();
 
-    if (parents < min_parents || parents > max_parents) {
+    if (!r.born(parents)) {
         // Cannot create a cell here
         return false;
     }
@@ -88,29 +114,45 @@ bool grid::will_create(int row, int column) {
     return true;
 }
 
-// Update to the next generation
-void grid::update(const grid &next) {
-    for (int row = 1; row < rowmax; ++row) {
-        for (int column = 1; column < colmax; ++column) {
-            cells[row][column] = next.cells[row][column];
-        }
-    }
-}
+namespace {
 
-// By default, all cells in the next generation are initially unpopulated
-// Calculate which live cells survive to the next generation
-// and unpopulated cells are populated in the next generation
-void calculate(grid &old_generation, grid &new_generation) {
-    for (int row = 1; row < rowmax; ++row) {
-        for (int column = 1; column < colmax; ++column) {
+// Calculate rows [row_begin, row_end) of the next generation
+// Every cell is written, so new_generation can hold any earlier generation
+void calculate_rows(grid &old_generation, grid &new_generation, int row_begin, int row_end,
+                    const rule &r) {
+    for (int row = row_begin; row < row_end; ++row) {
+        for (int column = 0; column < old_generation.cols(); ++column) {
             // Will this live cell survive to the next generation?
-            if (old_generation.will_survive(row, column)) {
-                new_generation.create(row, column);
-            }
             // Will this unpopulated cell be populated in the next generation?
-            else if (old_generation.will_create(row, column)) {
+            if (old_generation.will_survive(row, column, r) ||
+                old_generation.will_create(row, column, r)) {
                 new_generation.create(row, column);
+            } else {
+                new_generation.erase(row, column);
             }
         }
     }
 }
+
+} // namespace
+
+// Calculate which live cells survive to the next generation
+// and unpopulated cells are populated in the next generation
+void calculate(grid &old_generation, grid &new_generation, const rule &r) {
+    old_generation.wrap();
+    calculate_rows(old_generation, new_generation, 0, old_generation.rows(), r);
+}
+
+// The same, in parallel, in bands of rows
+// The rows above and below a band are only read, from old_generation
+void calculate(ThreadPool &pool, grid &old_generation, grid &new_generation, const rule &r) {
+    old_generation.wrap();
+
+    std::size_t rows = old_generation.rows();
+    std::size_t nbands = std::min(block_count(pool, rows * old_generation.cols()), rows);
+    parallel_blocks(pool, nbands, [&](std::size_t band) {
+        int row_begin = static_cast<int>(block_begin(rows, nbands, band));
+        int row_end = static_cast<int>(block_begin(rows, nbands, band + 1));
+        calculate_rows(old_generation, new_generation, row_begin, row_end, r);
+    });
+}
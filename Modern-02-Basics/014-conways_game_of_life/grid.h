@@ -1,41 +1,81 @@
 #ifndef GRID_H_
 #define GRID_H_
 
-#include <cstdlib>
+#include <cstdint>
 #include <string>
 #include <vector>
 
 #include "cell.h"
+#include "life.h"
+#include "rule.h"
+
+class ThreadPool;
 
 class grid {
-    // The cells on screen.
+    int nrows;
+    int ncols;
+    // Do the edges wrap around?
+    bool toroidal;
+
+    // The cells, row by row, in one block of memory.
     // We have a border consisting of inactive cells.
     // These are used in the calculation for the next generation of cells,
-    // but are not displayed on screen
-    cell cells[rowmax + 2][colmax + 2];
+    // but are not displayed on screen.
+    // On a toroidal grid, the border is a copy of the opposite edge.
+    std::vector<cell> cells;
+
+    // Cell (row, column), for row from -1 to rows() and column from -1 to cols()
+    cell &at(int row, int column) {
+        return cells[static_cast<std::size_t>(row + 1) * (ncols + 2) + column + 1];
+    }
+    const cell &at(int row, int column) const {
+        return cells[static_cast<std::size_t>(row + 1) * (ncols + 2) + column + 1];
+    }
 
   public:
+    // Constructor
+    // All the cells are dead
+    // A grid of 100,000 by 100,000 cells needs 10 GB: bitgrid needs 1.25 GB
+    grid(int rows = default_rows, int cols = default_cols, bool torus = false);
+
+    int rows() const { return nrows; }
+    int cols() const { return ncols; }
+    bool is_toroidal() const { return toroidal; }
+
+    bool is_alive(int row, int column) const { return at(row, column).is_alive(); }
+
     // Create a cell at (row, column)
     void create(int row, int column);
 
-    // Draw all the cells
-    void draw();
+    // Erase the cell at (row, column)
+    void erase(int row, int column);
 
     // Populate the grid with cells, at random
-    void randomize();
+    // Each cell is alive with probability "density". The same seed gives the
+    // same cells in every engine.
+    void randomize(std::uint64_t seed, double density);
+
+    // Number of live cells
+    std::size_t population() const;
+
+    // On a toroidal grid, copy each edge into the border on the opposite side
+    void wrap();
 
     // Will the cell at (row, column) survive to the next generation?
-    bool will_survive(int row, int column);
+    bool will_survive(int row, int column, const rule &r = conway);
 
     // Will a cell be born at (row, column) in the next generation?
-    bool will_create(int row, int column);
-
-    // Update to the next generation
-    void update(const grid &next);
+    bool will_create(int row, int column, const rule &r = conway);
 };
 
 // Non-member function
 // Calculate which cells survive to the next generation and which are born
-void calculate(grid &old_generation, grid &new_generation);
+// The grids must have the same size
+// Every cell of new_generation is written, so it does not need to be cleared
+void calculate(grid &old_generation, grid &new_generation, const rule &r = conway);
+
+// The same, in parallel: the rows are split into bands, one task per band
+void calculate(ThreadPool &pool, grid &old_generation, grid &new_generation,
+               const rule &r = conway);
 
 #endif // GRID_H_
@@ -0,0 +1,355 @@
+#include "hashlife.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "random_cells.h"
+
+// Constructor
+// All the cells are dead
+hashlife::hashlife(int rows, int cols, int step_log2, const rule &r, std::size_t max_nodes)
+    : nodes{{0, 0, 0, 0, no_node, no_node, 0, 0}, {0, 0, 0, 0, no_node, no_node, 1, 0}},
+      live_nodes(2), max_nodes(max_nodes), buckets(1024, no_node), empty_nodes{0},
+      step_log2(step_log2), life_rule(r), view_rows(rows), view_cols(cols) {
+    if (step_log2 < 0 || step_log2 > 48) {
+        throw std::invalid_argument("hashlife: the step must be from 2^0 to 2^48 generations");
+    }
+    if (r.born(0)) {
+        throw std::invalid_argument("hashlife: the rule " + rule_name(r) +
+                                    " has B0, so the universe cannot be finite");
+    }
+    root = empty(3);
+}
+
+namespace {
+
+std::size_t hash(std::uint32_t nw, std::uint32_t ne, std::uint32_t sw, std::uint32_t se) {
+    std::uint64_t h = ((std::uint64_t{nw} << 32 | ne) * 0x9E3779B97F4A7C15ULL) ^
+                      ((std::uint64_t{sw} << 32 | se) * 0xC2B2AE3D27D4EB4FULL);
+    return h ^ (h >> 31);
+}
+
+} // namespace
+
+// Add node i to its hash bucket
+void hashlife::insert(std::uint32_t i) {
+    node &n = nodes[i];
+    std::size_t bucket = hash(n.nw, n.ne, n.sw, n.se) & (buckets.size() - 1);
+    n.next = buckets[bucket];
+    buckets[bucket] = i;
+}
+
+void hashlife::grow_buckets() {
+    buckets.assign(2 * buckets.size(), no_node);
+    for (std::uint32_t i = 2; i < nodes.size(); ++i) {
+        if (nodes[i].level > 0) {
+            insert(i);
+        }
+    }
+}
+
+// The node made of these four, which must be at the same level
+std::uint32_t hashlife::join(std::uint32_t nw, std::uint32_t ne, std::uint32_t sw,
+                             std::uint32_t se) {
+    std::size_t bucket = hash(nw, ne, sw, se) & (buckets.size() - 1);
+    for (std::uint32_t i = buckets[bucket]; i != no_node; i = nodes[i].next) {
+        const node &n = nodes[i];
+        if (n.nw == nw && n.ne == ne && n.sw == sw && n.se == se) {
+            return i;
+        }
+    }
+
+    // A new node, from the free list or at the end
+    node made{nw,
+              ne,
+              sw,
+              se,
+              no_node,
+              buckets[bucket],
+              nodes[nw].population + nodes[ne].population + nodes[sw].population +
+                  nodes[se].population,
+              nodes[nw].level + 1};
+    std::uint32_t i;
+    if (free_list != no_node) {
+        i = free_list;
+        free_list = nodes[i].next;
+        nodes[i] = made;
+    } else {
+        if (nodes.size() == no_node) {
+            throw std::length_error("hashlife: too many nodes");
+        }
+        i = static_cast<std::uint32_t>(nodes.size());
+        nodes.push_back(made);
+    }
+    buckets[bucket] = i;
+
+    if (++live_nodes > buckets.size()) {
+        grow_buckets();
+    }
+    return i;
+}
+
+// The empty node at "level"
+std::uint32_t hashlife::empty(int level) {
+    while (static_cast<int>(empty_nodes.size()) <= level) {
+        std::uint32_t e = empty_nodes.back();
+        empty_nodes.push_back(join(e, e, e, e));
+    }
+    return empty_nodes[level];
+}
+
+// The centre of a node, at the next level down, in the same generation
+std::uint32_t hashlife::centre(std::uint32_t n) {
+    node m = nodes[n];
+    return join(nodes[m.nw].se, nodes[m.ne].sw, nodes[m.sw].ne, nodes[m.se].nw);
+}
+
+// The result of a node at level 2: its centre 2 x 2 cells, one generation later
+std::uint32_t hashlife::result_of_4x4(std::uint32_t n) {
+    // The 16 cells, cell (row, column) in bit 4 * row + column
+    // The children of a node at level 1 are cells: 0 for dead, 1 for alive
+    unsigned cells = 0;
+    auto add = [&](std::uint32_t quarter, int row, int column) {
+        const node &q = nodes[quarter];
+        cells |= q.nw << (4 * row + column) | q.ne << (4 * row + column + 1) |
+                 q.sw << (4 * row + column + 4) | q.se << (4 * row + column + 5);
+    };
+    const node &m = nodes[n];
+    add(m.nw, 0, 0);
+    add(m.ne, 0, 2);
+    add(m.sw, 2, 0);
+    add(m.se, 2, 2);
+
+    auto next = [this, cells](int row, int column) -> std::uint32_t {
+        int neighbours = 0;
+        for (int r = row - 1; r <= row + 1; ++r) {
+            for (int c = column - 1; c <= column + 1; ++c) {
+                neighbours += (cells >> (4 * r + c)) & 1;
+            }
+        }
+        bool alive = (cells >> (4 * row + column)) & 1;
+        neighbours -= alive;
+        return life_rule.next(alive, neighbours);
+    };
+    return join(next(1, 1), next(1, 2), next(2, 1), next(2, 2));
+}
+
+// The result of a node: its centre, 2^min(level - 2, memo_log2) generations later
+std::uint32_t hashlife::result(std::uint32_t n) {
+    if (nodes[n].result != no_node) {
+        return nodes[n].result;
+    }
+
+    // Copies: join() may move the nodes
+    node m = nodes[n];
+    std::uint32_t r;
+    if (m.level == 2) {
+        r = result_of_4x4(n);
+    } else {
+        node nw = nodes[m.nw];
+        node ne = nodes[m.ne];
+        node sw = nodes[m.sw];
+        node se = nodes[m.se];
+
+        // Nine overlapping nodes at level - 1, in three rows of three
+        std::uint32_t n00 = m.nw;
+        std::uint32_t n01 = join(nw.ne, ne.nw, nw.se, ne.sw);
+        std::uint32_t n02 = m.ne;
+        std::uint32_t n10 = join(nw.sw, nw.se, sw.nw, sw.ne);
+        std::uint32_t n11 = join(nw.se, ne.sw, sw.ne, se.nw);
+        std::uint32_t n12 = join(ne.sw, ne.se, se.nw, se.ne);
+        std::uint32_t n20 = m.sw;
+        std::uint32_t n21 = join(sw.ne, se.nw, sw.se, se.sw);
+        std::uint32_t n22 = m.se;
+
+        // Their centres at level - 2: advanced by their results for a full
+        // step, or in the same generation for a shorter one
+        bool full = m.level - 2 <= memo_log2;
+        auto first_half = [&](std::uint32_t x) { return full ? result(x) : centre(x); };
+        std::uint32_t r00 = first_half(n00);
+        std::uint32_t r01 = first_half(n01);
+        std::uint32_t r02 = first_half(n02);
+        std::uint32_t r10 = first_half(n10);
+        std::uint32_t r11 = first_half(n11);
+        std::uint32_t r12 = first_half(n12);
+        std::uint32_t r20 = first_half(n20);
+        std::uint32_t r21 = first_half(n21);
+        std::uint32_t r22 = first_half(n22);
+
+        // Four overlapping nodes at level - 1, advanced by their results
+        std::uint32_t a = result(join(r00, r01, r10, r11));
+        std::uint32_t b = result(join(r01, r02, r11, r12));
+        std::uint32_t c = result(join(r10, r11, r20, r21));
+        std::uint32_t d = result(join(r11, r12, r21, r22));
+        r = join(a, b, c, d);
+    }
+
+    nodes[n].result = r;
+    return r;
+}
+
+// The same universe, with a root one level up, and the old root in its centre
+void hashlife::expand() {
+    node r = nodes[root];
+    std::uint32_t e = empty(r.level - 1);
+    std::uint32_t nw = join(e, e, e, r.nw);
+    std::uint32_t ne = join(e, e, r.ne, e);
+    std::uint32_t sw = join(e, r.sw, e, e);
+    std::uint32_t se = join(r.se, e, e, e);
+    root = join(nw, ne, sw, se);
+    top -= std::int64_t{1} << (r.level - 1);
+    left -= std::int64_t{1} << (r.level - 1);
+}
+
+// Is every live cell in the middle quarter of the root?
+// The middle quarter is made of four nodes three levels down
+bool hashlife::centred() const {
+    const node &r = nodes[root];
+    std::uint64_t middle = nodes[nodes[nodes[r.nw].se].se].population +
+                           nodes[nodes[nodes[r.ne].sw].sw].population +
+                           nodes[nodes[nodes[r.sw].ne].ne].population +
+                           nodes[nodes[nodes[r.se].nw].nw].population;
+    return middle == r.population;
+}
+
+bool hashlife::is_alive(std::int64_t row, std::int64_t column) const {
+    std::uint32_t n = root;
+    int level = nodes[n].level;
+    row -= top;
+    column -= left;
+    if (row < 0 || column < 0 || row >= std::int64_t{1} << level ||
+        column >= std::int64_t{1} << level) {
+        return false;
+    }
+    for (; level > 0; --level) {
+        std::int64_t half = std::int64_t{1} << (level - 1);
+        const node &m = nodes[n];
+        if (row < half) {
+            n = column < half ? m.nw : m.ne;
+        } else {
+            n = column < half ? m.sw : m.se;
+        }
+        row %= half;
+        column %= half;
+    }
+    return n == 1;
+}
+
+// The node n, with the cell at (row, column) from its top left corner alive
+std::uint32_t hashlife::set_cell(std::uint32_t n, std::int64_t row, std::int64_t column) {
+    node m = nodes[n];
+    if (m.level == 0) {
+        return 1;
+    }
+    std::int64_t half = std::int64_t{1} << (m.level - 1);
+    if (row < half) {
+        if (column < half) {
+            return join(set_cell(m.nw, row, column), m.ne, m.sw, m.se);
+        }
+        return join(m.nw, set_cell(m.ne, row, column - half), m.sw, m.se);
+    }
+    if (column < half) {
+        return join(m.nw, m.ne, set_cell(m.sw, row - half, column), m.se);
+    }
+    return join(m.nw, m.ne, m.sw, set_cell(m.se, row - half, column - half));
+}
+
+// Create a cell at (row, column), anywhere in the universe
+void hashlife::create(std::int64_t row, std::int64_t column) {
+    while (true) {
+        std::int64_t size = std::int64_t{1} << nodes[root].level;
+        if (row >= top && row < top + size && column >= left && column < left + size) {
+            break;
+        }
+        expand();
+    }
+    root = set_cell(root, row - top, column - left);
+}
+
+// Populate the view with cells, at random
+// Bit b of each word of random_cells is column b of the next 64, as in grid::randomize()
+void hashlife::randomize(std::uint64_t seed, double density) {
+    random_cells cells(seed, density);
+    for (int row = 0; row < view_rows; ++row) {
+        for (int first = 0; first < view_cols; first += 64) {
+            std::uint64_t word = cells.next_word();
+            for (int column = first; column < std::min(first + 64, view_cols); ++column) {
+                if ((word >> (column - first)) & 1) {
+                    create(row, column);
+                }
+            }
+        }
+    }
+}
+
+// Free the nodes which are not part of the current generation
+// The stored results may be freed nodes, so they are all forgotten
+void hashlife::collect() {
+    std::vector<std::uint8_t> marked(nodes.size());
+    std::vector<std::uint32_t> stack(empty_nodes.begin(), empty_nodes.end());
+    stack.push_back(root);
+    marked[1] = 1;
+    while (!stack.empty()) {
+        std::uint32_t n = stack.back();
+        stack.pop_back();
+        if (marked[n]) {
+            continue;
+        }
+        marked[n] = 1;
+        if (nodes[n].level > 0) {
+            const node &m = nodes[n];
+            stack.insert(stack.end(), {m.nw, m.ne, m.sw, m.se});
+        }
+    }
+
+    std::fill(buckets.begin(), buckets.end(), no_node);
+    for (std::uint32_t i = 2; i < nodes.size(); ++i) {
+        node &n = nodes[i];
+        if (n.level < 0) {
+            continue;
+        }
+        n.result = no_node;
+        if (marked[i]) {
+            insert(i);
+        } else {
+            // Free: level -1 marks a node in the free list
+            n.level = -1;
+            n.next = free_list;
+            free_list = i;
+            --live_nodes;
+        }
+    }
+    memo_log2 = -1;
+    ++collections;
+}
+
+// Advance 2^log2_generations generations
+void hashlife::advance(int log2_generations) {
+    if (log2_generations < 0 || log2_generations > 48) {
+        throw std::invalid_argument("hashlife: can advance from 2^0 to 2^48 generations at once");
+    }
+    if (live_nodes > max_nodes) {
+        collect();
+    }
+
+    // The stored results are for another number of generations
+    if (log2_generations != memo_log2) {
+        for (node &n : nodes) {
+            n.result = no_node;
+        }
+        memo_log2 = log2_generations;
+    }
+
+    // The root's result must be able to hold everything the pattern can
+    // reach: the root must be at least 2^(log2_generations + 3) cells square,
+    // with the pattern in its middle quarter
+    while (nodes[root].level < log2_generations + 3 || !centred()) {
+        expand();
+    }
+
+    std::int64_t quarter = std::int64_t{1} << (nodes[root].level - 2);
+    root = result(root);
+    top += quarter;
+    left += quarter;
+    generation_count += std::uint64_t{1} << log2_generations;
+}
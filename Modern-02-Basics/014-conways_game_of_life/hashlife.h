@@ -0,0 +1,157 @@
+#ifndef HASHLIFE_H_
+#define HASHLIFE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "life.h"
+#include "rule.h"
+
+// Gosper's HashLife: an unbounded universe, which can advance 2^k generations at once
+//
+// The universe is a quadtree. A node at level k is a square of 2^k x 2^k
+// cells, made of four nodes at level k - 1: the north-west, north-east,
+// south-west and south-east quarters. Level 0 is a single cell.
+//
+// - Nodes are unique: a hash table maps four children to the node made of
+//   them, so a square which appears many times in the universe, or in many
+//   generations, is stored once. Empty space costs one node per level.
+// - The result of a node at level k is its centre, 2^(k - 1) cells square,
+//   2^(k - 2) generations later. Cells move at most one cell per generation,
+//   so the centre depends only on the node. The result is calculated from
+//   the results of nine overlapping nodes at level k - 1, and is stored in
+//   the node, so it is calculated only once however often the node appears.
+// - To advance 2^j generations with j < k - 2, the nine nodes are first cut
+//   down to their centres, without advancing them, so the result is that
+//   many generations later instead.
+//
+// A pattern which repeats itself, even as it grows, is made of few distinct
+// nodes, so each doubling of the number of generations adds a few levels.
+//
+// Nodes are never changed once made. The number of nodes is bounded: before
+// each step, if there are more than max_nodes, the nodes which are not part
+// of the current generation are freed, with the stored results. One step may
+// go over the limit.
+//
+// Any rule without B0 can be used. With B0, empty space would come to life,
+// and the universe would not be finite.
+//
+// The rows and columns of the constructor are the part of the universe which
+// randomize() fills and main() shows. Cells outside it live on.
+class hashlife {
+    struct node {
+        // Children: north-west, north-east, south-west, south-east
+        std::uint32_t nw, ne, sw, se;
+        // The result, for memo_log2, or no_node
+        std::uint32_t result;
+        // The next node in the same hash bucket, or in the free list
+        std::uint32_t next;
+        std::uint64_t population;
+        int level;
+    };
+
+    static constexpr std::uint32_t no_node = ~std::uint32_t{0};
+
+    // Nodes 0 and 1 are the dead and live cells, at level 0
+    std::vector<node> nodes;
+    std::uint32_t free_list{no_node};
+    std::size_t live_nodes{0};
+    std::size_t max_nodes;
+    std::size_t collections{0};
+
+    // The hash table. Each bucket is the first node of a chain.
+    std::vector<std::uint32_t> buckets;
+
+    // The empty node at each level
+    std::vector<std::uint32_t> empty_nodes;
+
+    // The current generation: the root node, and the cell in its top left corner
+    std::uint32_t root;
+    std::int64_t top{0};
+    std::int64_t left{0};
+    std::uint64_t generation_count{0};
+
+    // The results stored in the nodes advance 2^memo_log2 generations, or
+    // fewer for nodes below level memo_log2 + 2. -1 when none are stored.
+    int memo_log2{-1};
+
+    // step() advances 2^step_log2 generations
+    int step_log2;
+
+    rule life_rule;
+
+    int view_rows;
+    int view_cols;
+
+    // The node made of these four, which must be at the same level
+    std::uint32_t join(std::uint32_t nw, std::uint32_t ne, std::uint32_t sw, std::uint32_t se);
+
+    // The empty node at "level"
+    std::uint32_t empty(int level);
+
+    // The centre of a node, at the next level down, in the same generation
+    std::uint32_t centre(std::uint32_t n);
+
+    // The result of a node at level 2: its centre 2 x 2 cells, one generation later
+    std::uint32_t result_of_4x4(std::uint32_t n);
+
+    // The result of a node
+    std::uint32_t result(std::uint32_t n);
+
+    // The same universe, with a root one level up, and the old root in its centre
+    void expand();
+
+    // Is every live cell in the middle quarter of the root, at least a quarter
+    // of the root's size away from its edges?
+    bool centred() const;
+
+    // The universe with the cell at (row, column) alive
+    std::uint32_t set_cell(std::uint32_t n, std::int64_t row, std::int64_t column);
+
+    // Free the nodes which are not part of the current generation
+    void collect();
+
+    // Add node i to its hash bucket
+    void insert(std::uint32_t i);
+
+    void grow_buckets();
+
+  public:
+    // Constructor
+    // All the cells are dead. step() advances 2^step_log2 generations.
+    // Throws std::invalid_argument for a rule with B0.
+    hashlife(int rows = default_rows, int cols = default_cols, int step_log2 = 0,
+             const rule &r = conway, std::size_t max_nodes = std::size_t{1} << 22);
+
+    int rows() const { return view_rows; }
+    int cols() const { return view_cols; }
+
+    bool is_alive(std::int64_t row, std::int64_t column) const;
+
+    // Create a cell at (row, column), anywhere in the universe
+    void create(std::int64_t row, std::int64_t column);
+
+    // Populate the view with cells, at random
+    // Each cell is alive with probability "density". The same seed gives the
+    // same cells in every engine.
+    void randomize(std::uint64_t seed, double density);
+
+    // Number of live cells in the whole universe
+    std::size_t population() const { return nodes[root].population; }
+
+    std::uint64_t generation() const { return generation_count; }
+
+    // Advance 2^log2_generations generations, from 2^0 to 2^48
+    // Throws std::invalid_argument for anything else
+    void advance(int log2_generations);
+
+    // Advance 2^step_log2 generations
+    void step() { advance(step_log2); }
+
+    // Memory use
+    std::size_t node_count() const { return live_nodes; }
+    std::size_t collection_count() const { return collections; }
+};
+
+#endif // HASHLIFE_H_
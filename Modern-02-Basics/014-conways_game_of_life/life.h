@@ -4,16 +4,12 @@
 const char live_cell{'X'};
 const char dead_cell{' '};
 
-// Standard ANSI console, with a 1-char border
-// Occupied rows go from 1 to 23
-// Occupied columns go from 1 to 79
-const int rowmax = 23;
-const int colmax = 79;
+// Standard ANSI console
+// The grids are this size by default, and the renderer shows at most this many rows and columns
+// Larger grids are given at runtime
+const int default_rows = 23;
+const int default_cols = 79;
 
-// Conway's parameters
-const int min_neighbours = 2;
-const int max_neighbours = 3;
-const int min_parents = 3;
-const int max_parents = 3;
+// The rules, Conway's and others, are in rule.h
 
 #endif // LIFE_H
\ No newline at end of file
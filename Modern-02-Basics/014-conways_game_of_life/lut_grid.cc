@@ -0,0 +1,155 @@
+#include "lut_grid.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "thread_pool.h"
+
+namespace {
+
+// The next generation of the centre 2 x 2 cells of every 4 x 4 block
+// Index bit 4 * row + column is cell (row, column) of the block. Result bit
+// 2 * row + column is cell (row + 1, column + 1) of the block, a generation later.
+using next_table = std::array<std::uint8_t, 65536>;
+
+next_table make_table(const rule &r) {
+    // The neighbours of each centre cell: the 3 x 3 cells around it, without it
+    std::array<unsigned, 4> neighbourhood{};
+    for (int cell = 0; cell < 4; ++cell) {
+        int row = 1 + cell / 2;
+        int column = 1 + cell % 2;
+        for (int r = row - 1; r <= row + 1; ++r) {
+            for (int c = column - 1; c <= column + 1; ++c) {
+                neighbourhood[cell] |= 1u << (4 * r + c);
+            }
+        }
+        neighbourhood[cell] &= ~(1u << (4 * row + column));
+    }
+
+    next_table table{};
+    for (unsigned cells = 0; cells < table.size(); ++cells) {
+        unsigned result = 0;
+        for (int cell = 0; cell < 4; ++cell) {
+            int neighbours = std::popcount(cells & neighbourhood[cell]);
+            bool alive = (cells >> (4 * (1 + cell / 2) + 1 + cell % 2)) & 1;
+            result |= r.next(alive, neighbours) << cell;
+        }
+        table[cells] = static_cast<std::uint8_t>(result);
+    }
+    return table;
+}
+
+// The table for rule r, made the first time it is needed
+// It takes far too many steps to be a constant expression.
+const next_table &table_for(const rule &r) {
+    static std::mutex mutex;
+    static std::vector<std::pair<rule, std::unique_ptr<next_table>>> tables;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto &[key, table] : tables) {
+        if (key == r) {
+            return *table;
+        }
+    }
+    tables.emplace_back(r, std::make_unique<next_table>(make_table(r)));
+    return *tables.back().second;
+}
+
+// The 34 columns from 32 * half - 1 to 32 * half + 32 of word w, in bits 0 to 33
+inline std::uint64_t window(const std::uint64_t *words, std::size_t w, int half) {
+    if (half == 0) {
+        return words[w] << 1 | words[w - 1] >> 63;
+    }
+    return words[w] >> 31 | words[w + 1] << 33;
+}
+
+// Calculate words [word_begin, word_end) of rows "row" and "row + 1", or only
+// of "row" if "two" is false: the row below the last one is not written.
+void calculate_rows(const bitgrid &old_generation, bitgrid &new_generation, int row, bool two,
+                    std::size_t word_begin, std::size_t word_end, const next_table &next_block) {
+    const std::uint64_t *up = old_generation.row_bits(row - 1);
+    const std::uint64_t *top = old_generation.row_bits(row);
+    const std::uint64_t *bottom = old_generation.row_bits(row + 1);
+    // With one row, the row two below may be past the extra row: it is not needed
+    const std::uint64_t *down = two ? old_generation.row_bits(row + 2) : bottom;
+    std::uint64_t *out_top = new_generation.row_bits(row);
+    std::uint64_t *out_bottom = two ? new_generation.row_bits(row + 1) : nullptr;
+
+    for (std::size_t w = word_begin; w < word_end; ++w) {
+        std::uint64_t next_top = 0;
+        std::uint64_t next_bottom = 0;
+        for (int half = 0; half < 2; ++half) {
+            std::uint64_t a = window(up, w, half);
+            std::uint64_t b = window(top, w, half);
+            std::uint64_t c = window(bottom, w, half);
+            std::uint64_t d = window(down, w, half);
+            for (int column = 32 * half; column < 32 * half + 32; column += 2) {
+                unsigned index = (a & 15) | (b & 15) << 4 | (c & 15) << 8 | (d & 15) << 12;
+                std::uint64_t result = next_block[index];
+                next_top |= (result & 3) << column;
+                next_bottom |= (result >> 2) << column;
+                a >>= 2;
+                b >>= 2;
+                c >>= 2;
+                d >>= 2;
+            }
+        }
+        out_top[w] = next_top;
+        if (two) {
+            out_bottom[w] = next_bottom;
+        }
+    }
+}
+
+// Calculate the cells of "block", two rows at a time
+// The rows above and below it are only read, so blocks can be calculated in parallel
+void calculate_lut_block(const bitgrid &old_generation, bitgrid &new_generation,
+                         const bit_block &block, const next_table &table) {
+    for (int row = block.row_begin; row < block.row_end; row += 2) {
+        bool two = row + 1 < block.row_end;
+        calculate_rows(old_generation, new_generation, row, two, block.word_begin,
+                       block.word_end, table);
+
+        // Bits beyond the last column of the last word must stay dead
+        if (block.word_end == old_generation.words()) {
+            std::size_t last = block.word_end - 1;
+            new_generation.row_bits(row)[last] &= old_generation.last_word_mask();
+            if (two) {
+                new_generation.row_bits(row + 1)[last] &= old_generation.last_word_mask();
+            }
+        }
+    }
+}
+
+} // namespace
+
+// Calculate the next generation
+void calculate(lut_grid &old_generation, lut_grid &new_generation, const rule &r) {
+    old_generation.wrap();
+    bit_block all{0, old_generation.rows(), 0, old_generation.words()};
+    calculate_lut_block(old_generation, new_generation, all, table_for(r));
+}
+
+// Calculate the next generation in bands of rows, in parallel
+// The bands start on even rows, so that only the last one can end with a single row
+void calculate(ThreadPool &pool, lut_grid &old_generation, lut_grid &new_generation,
+               const rule &r) {
+    old_generation.wrap();
+    const next_table &table = table_for(r);
+
+    std::size_t pairs = (old_generation.rows() + 1) / 2;
+    std::size_t nbands = std::min(block_count(pool, pairs * old_generation.words()), pairs);
+    parallel_blocks(pool, nbands, [&](std::size_t band) {
+        int row_begin = static_cast<int>(2 * block_begin(pairs, nbands, band));
+        int row_end = static_cast<int>(2 * block_begin(pairs, nbands, band + 1));
+        bit_block block{row_begin, std::min(row_end, old_generation.rows()), 0,
+                        old_generation.words()};
+        calculate_lut_block(old_generation, new_generation, block, table);
+    });
+}
@@ -0,0 +1,33 @@
+#ifndef LUT_GRID_H_
+#define LUT_GRID_H_
+
+#include "bitgrid.h"
+
+class ThreadPool;
+
+// A bitgrid which is calculated with a lookup table instead of logic operations
+//
+// The next generation of a block of 2 x 2 cells depends only on the 4 x 4
+// cells around it: 16 bits, so a table of 65536 entries, one byte each, holds
+// every answer. There is a table for each rule, made the first time the rule
+// is used, and it fits in the L2 cache.
+// Two rows are calculated at once: the four rows around them are read 32
+// columns at a time, with one column more on each side, and each lookup gives
+// 4 cells, with no branches and no neighbour counts.
+//
+// The storage, and everything but calculate(), are those of bitgrid.
+class lut_grid : public bitgrid {
+  public:
+    using bitgrid::bitgrid;
+};
+
+// Calculate the next generation into new_generation, which must have the same size
+// Every cell of new_generation is written, so it does not need to be cleared
+// old_generation is wrapped first, if it is toroidal
+void calculate(lut_grid &old_generation, lut_grid &new_generation, const rule &r = conway);
+
+// The same, in parallel: the rows are split into bands, one task per band
+void calculate(ThreadPool &pool, lut_grid &old_generation, lut_grid &new_generation,
+               const rule &r = conway);
+
+#endif // LUT_GRID_H_
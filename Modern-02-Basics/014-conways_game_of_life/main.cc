@@ -1,53 +1,353 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "benchmark.h"
+#include "bitgrid.h"
+#include "engine.h"
 #include "grid.h"
+#include "hashlife.h"
+#include "lut_grid.h"
+#include "pattern_io.h"
+#include "renderer.h"
+#include "sparse_grid.h"
+#include "thread_pool.h"
 
 // Uncomment if running in Windows Console
 // #include "ansi_escapes.h"
 
+// Command line options
+struct options {
+    // "grid", "bit", "lut", "sparse" or "hashlife"
+    std::string engine{"grid"};
+    bool torus{false};
+    // hashlife advances 2^step_log2 generations at each step
+    int step_log2{0};
+    bool benchmark{false};
+    bool sized{false};
+    int rows{default_rows};
+    int cols{default_cols};
+
+    // Stop after this many steps, without waiting for the return key.
+    // 0 runs until ctrl+c.
+    long generations{0};
+    bool draw{true};
+
+    // The random first generation: the same seed gives the same cells in
+    // every engine. Without --seed, the seed is the time.
+    std::uint64_t seed{0};
+    bool seeded{false};
+    double density{0.2};
+
+    // Start from the pattern in load_file instead, and save the last generation in save_file
+    std::string load_file;
+    std::string save_file;
+
+    // Conway's, or the rule of --rule, or else of the pattern loaded
+    rule life_rule{conway};
+    bool ruled{false};
+};
+
+// The value of option "name", given as "name=VALUE" or "name VALUE", or nullptr
+// if argv[i] is not that option. i moves to the value.
+const char *option_value(int argc, char *argv[], int &i, const std::string &name) {
+    std::string arg = argv[i];
+    if (arg == name && i + 1 < argc) {
+        return argv[++i];
+    }
+    if (arg.starts_with(name + "=")) {
+        return argv[i] + name.size() + 1;
+    }
+    return nullptr;
+}
+
+// Returns false if an argument is not understood
+bool parse_options(int argc, char *argv[], options &opts) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        const char *value;
+        unsigned long long seed;
+        char end;
+        if (arg == "grid" || arg == "bit" || arg == "lut" || arg == "sparse" ||
+            arg == "hashlife") {
+            opts.engine = arg;
+        } else if (arg == "torus") {
+            opts.torus = true;
+        } else if (arg == "bench") {
+            opts.benchmark = true;
+        } else if (std::sscanf(argv[i], "%dx%d%c", &opts.rows, &opts.cols, &end) == 2 &&
+                   opts.rows > 0 && opts.cols > 0) {
+            opts.sized = true;
+        } else if (std::sscanf(argv[i], "step=%d%c", &opts.step_log2, &end) == 1 &&
+                   opts.step_log2 >= 0 && opts.step_log2 <= 48) {
+            continue;
+        } else if (arg == "--no-draw") {
+            opts.draw = false;
+        } else if ((value = option_value(argc, argv, i, "--generations"))) {
+            if (std::sscanf(value, "%ld%c", &opts.generations, &end) != 1 ||
+                opts.generations <= 0) {
+                std::cerr << "Bad number of generations: " << value << '\n';
+                return false;
+            }
+        } else if ((value = option_value(argc, argv, i, "--seed"))) {
+            if (std::sscanf(value, "%llu%c", &seed, &end) != 1) {
+                std::cerr << "Bad seed: " << value << '\n';
+                return false;
+            }
+            opts.seed = seed;
+            opts.seeded = true;
+        } else if ((value = option_value(argc, argv, i, "--density"))) {
+            if (std::sscanf(value, "%lf%c", &opts.density, &end) != 1 || opts.density < 0 ||
+                opts.density > 1) {
+                std::cerr << "The density must be from 0 to 1, not " << value << '\n';
+                return false;
+            }
+        } else if ((value = option_value(argc, argv, i, "--rule"))) {
+            try {
+                opts.life_rule = parse_rule(value);
+                opts.ruled = true;
+            } catch (const std::invalid_argument &e) {
+                std::cerr << "Bad rule: " << e.what() << '\n';
+                return false;
+            }
+        } else if ((value = option_value(argc, argv, i, "--load"))) {
+            opts.load_file = value;
+        } else if ((value = option_value(argc, argv, i, "--save"))) {
+            opts.save_file = value;
+        } else {
+            std::cerr << "Unknown argument: " << arg << '\n';
+            return false;
+        }
+    }
+    if (opts.engine == "hashlife" && opts.torus) {
+        std::cerr << "The hashlife universe is unbounded: it cannot be a torus\n";
+        return false;
+    }
+    if (opts.benchmark && opts.engine == "hashlife" && opts.ruled) {
+        std::cerr << "The hashlife benchmark runs Conway's glider gun: it has no --rule\n";
+        return false;
+    }
+    if (opts.generations == 0 && (!opts.draw || !opts.save_file.empty())) {
+        std::cerr << "--no-draw and --save need --generations\n";
+        return false;
+    }
+    if (!opts.seeded) {
+        opts.seed = time(nullptr);
+    }
+    return true;
+}
+
+// Time the generations, without drawing them, and print the rates
+// "per_step" is the number of generations of each step.
+template <class Engine>
+void run_headless(Engine &life, const options &opts, std::int64_t per_step) {
+    auto start = std::chrono::steady_clock::now();
+    for (long g = 0; g < opts.generations; ++g) {
+        life.step();
+    }
+    std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+
+    double generations = static_cast<double>(opts.generations) * per_step;
+    double cells = static_cast<double>(life.rows()) * life.cols();
+    std::cout << opts.engine << ", " << rule_name(opts.life_rule) << ", " << life.rows() << " x "
+              << life.cols() << " cells, ";
+    if (opts.load_file.empty()) {
+        std::cout << "seed " << opts.seed << ", density " << opts.density << '\n';
+    } else {
+        std::cout << "pattern " << opts.load_file << '\n';
+    }
+    std::cout << generations << " generations in " << time.count() << " s: "
+              << generations / time.count() << " generations/s, "
+              << cells * generations / time.count() << " cell-updates/s\n";
+    std::cout << "Population " << life.population() << '\n';
+}
+
+// Populate the cells, then draw each generation, and calculate the next one when the user
+// presses return, or run opts.generations steps
+template <class Engine>
+void run(Engine &life, const options &opts, const pattern *first, std::int64_t per_step = 1) {
+    if (first) {
+        // In the middle of the grid
+        int top = std::max(life.rows() - first->rows, 0) / 2;
+        int left = std::max(life.cols() - first->cols, 0) / 2;
+        for (auto [row, column] : first->cells) {
+            life.create(top + row, left + column);
+        }
+    } else {
+        // Populate the cells at random
+        life.randomize(opts.seed, opts.density);
+    }
+
+    if (!opts.draw) {
+        run_headless(life, opts, per_step);
+    } else {
+        // Only the cells which change are drawn again
+        renderer screen(life.rows(), life.cols());
+
+        for (long g = 0; opts.generations == 0 || g < opts.generations; ++g) {
+            // Draw the current generation
+            screen.draw(life);
+
+            // Wait for user to press the return key
+            if (opts.generations == 0) {
+                std::cin.get();
+            }
+
+            // Calculate the next generation
+            life.step();
+        }
+        screen.draw(life);
+        screen.finish();
+    }
+
+    if (!opts.save_file.empty()) {
+        save_pattern(opts.save_file, life.rows(), life.cols(),
+                     [&life](int row, int column) { return life.is_alive(row, column); },
+                     opts.life_rule);
+    }
+}
+
 /**
- * g++ -std=c++17 -Wall -Wextra -pedantic main.cc grid.cc cell.cc ansi_escapes.cc
- * Run `./a.out`
+ * g++ -std=c++20 -Wall -Wextra -pedantic -pthread -O2 main.cc grid.cc bitgrid.cc
+ *     lut_grid.cc sparse_grid.cc hashlife.cc renderer.cc random_cells.cc pattern_io.cc
+ *     benchmark.cc thread_pool.cc ansi_escapes.cc
+ * Run `./a.out [grid | bit | lut | sparse | hashlife] [ROWSxCOLS] [torus] [step=J] [bench]
+ *           [--options]`
+ *   grid        Use the grid of cells (the default)
+ *   bit         Use the bit-packed grid, for large grids
+ *   lut         Use the bit-packed grid, calculated with a lookup table
+ *               of the next 2 x 2 cells of every 4 x 4 block
+ *   sparse      Use the bit-packed grid which only calculates the tiles
+ *               that can change, for large, mostly empty grids
+ *   hashlife    Use HashLife: an unbounded universe, which can advance
+ *               many generations at once, for patterns which repeat
+ *   ROWSxCOLS   The size of the grid, e.g. 100000x100000 (default 23x79,
+ *               or the size of the pattern given with --load)
+ *               Only the top left corner is drawn
+ *   torus       The edges wrap around: cells on the left edge are
+ *               neighbours of cells on the right edge, and top and bottom
+ *               Not with "hashlife"
+ *   step=J      With "hashlife", show every 2^J-th generation (J <= 48)
+ *   bench       Time the generations on 1, 2, 4, ... threads, and stop.
+ *               The default size is 16384x16384, or 2048x2048 for "grid"
+ *               and "lut". With "lut", compare the kernels on one thread first
+ *               With "sparse", compare it with "bit" on an empty universe
+ *               with a few small random patches instead
+ *               With "hashlife", run a glider gun for up to 2^41 generations
+ *   --generations N   Run N steps, drawing each generation without waiting, then stop
+ *   --no-draw         With --generations, only time the steps, and print the
+ *                     generations and cell updates per second
+ *   --seed S          The seed of the random first generation (default: the time).
+ *                     The same seed gives the same cells with every engine.
+ *   --density D       The probability of each cell being alive at first (default 0.2)
+ *   --load FILE       Start from the pattern in FILE instead, in the middle of
+ *                     the grid: RLE, or plaintext ("." and "O")
+ *   --save FILE       With --generations, save the last generation in FILE:
+ *                     RLE if its name ends in ".rle", plaintext otherwise
+ *   --rule RULE       A Life-like rule in B/S notation, e.g. B36/S23 for HighLife
+ *                     (default: B3/S23, or the rule in the RLE file of --load).
+ *                     The rules of rule.h have kernels of their own; others are slower.
+ *                     Not B0 with "hashlife"
  * Press return to display each generation
  * Type ctrl+c to stop the program
  *
- * For debugging, randomization can be turn on or off in "grid.cc"
+ * For example, to compare the engines on the same cells:
+ *     ./a.out bit 4096x4096 --seed 1 --generations 100 --no-draw
+ *     ./a.out sparse 4096x4096 --seed 1 --generations 100 --no-draw
+ * And to run HighLife's replicator:
+ *     ./a.out --rule B36/S23 --load replicator.rle
  */
 int main(int argc, char *argv[]) {
-    std::cout << "Conway's game of Life\n";
-    std::cout << "Press the return key to display each generation\n";
-
-    // Wait for user to press the return key
-    std::cin.get();
-
-    // Uncomment if running in Windows Console
-    // Enable ANSI escape codes on Windows
-    // setupConsole();
+    options opts;
+    if (!parse_options(argc, argv, opts)) {
+        return 1;
+    }
 
-    // Grid for the first generation
-    grid current_generation;
+    if (opts.benchmark) {
+        if (!opts.sized) {
+            opts.rows = opts.cols = opts.engine == "grid" || opts.engine == "lut" ? 2048 : 16384;
+        }
+        if (opts.engine == "sparse") {
+            sparse_benchmark(opts.rows, opts.cols, opts.torus, opts.life_rule);
+        } else if (opts.engine == "hashlife") {
+            hashlife_benchmark();
+        } else {
+            if (opts.engine == "lut") {
+                kernel_benchmark(opts.rows, opts.cols, opts.torus, opts.life_rule);
+            }
+            scaling_benchmark(opts.engine, opts.rows, opts.cols, opts.torus, opts.life_rule);
+        }
+        return 0;
+    }
 
-    // Populate the cells at random
-    current_generation.randomize();
+    pattern first;
+    try {
+        if (!opts.load_file.empty()) {
+            first = load_pattern(opts.load_file);
+            if (first.has_rule && !opts.ruled) {
+                opts.life_rule = first.life_rule;
+            }
+            if (!opts.sized) {
+                opts.rows = std::max(opts.rows, first.rows);
+                opts.cols = std::max(opts.cols, first.cols);
+            } else if (opts.engine != "hashlife" &&
+                       (first.rows > opts.rows || first.cols > opts.cols)) {
+                throw std::invalid_argument("the pattern is larger than the grid");
+            }
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+    const pattern *loaded = opts.load_file.empty() ? nullptr : &first;
 
-    while (true) {
-        // Draw the current generation
-        current_generation.draw();
+    if (opts.generations == 0) {
+        std::cout << "Conway's game of Life\n";
+        std::cout << "Rule " << rule_name(opts.life_rule) << '\n';
+        std::cout << "Press the return key to display each generation\n";
+        if (!loaded) {
+            std::cout << "Seed " << opts.seed << '\n';
+        }
 
         // Wait for user to press the return key
         std::cin.get();
+    }
 
-        // Grid for the next generation
-        grid next_generation;
+    // Uncomment if running in Windows Console
+    // Enable ANSI escape codes on Windows
+    // setupConsole();
 
-        // Populate the cells in the next generation
-        calculate(current_generation, next_generation);
+    // Calculate each generation in parallel
+    ThreadPool pool;
 
-        // Update to the next generation
-        current_generation.update(next_generation);
+    try {
+        if (opts.engine == "bit") {
+            double_buffered<bitgrid> life(pool, opts.rows, opts.cols, opts.torus, opts.life_rule);
+            run(life, opts, loaded);
+        } else if (opts.engine == "lut") {
+            double_buffered<lut_grid> life(pool, opts.rows, opts.cols, opts.torus,
+                                           opts.life_rule);
+            run(life, opts, loaded);
+        } else if (opts.engine == "sparse") {
+            sparse_grid life(pool, opts.rows, opts.cols, opts.torus, opts.life_rule);
+            run(life, opts, loaded);
+        } else if (opts.engine == "hashlife") {
+            hashlife life(opts.rows, opts.cols, opts.step_log2, opts.life_rule);
+            run(life, opts, loaded, std::int64_t{1} << opts.step_log2);
+        } else {
+            double_buffered<grid> life(pool, opts.rows, opts.cols, opts.torus, opts.life_rule);
+            run(life, opts, loaded);
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
     }
 
-    // Move cursor to bottom of screen
-    std::cout << "\x1b[" << 0 << ";" << rowmax - 1 << "H";
-
     // Uncomment if running in Windows Console
     // Restore console on Windows
     // restoreConsole();
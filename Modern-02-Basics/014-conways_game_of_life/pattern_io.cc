@@ -0,0 +1,265 @@
+#include "pattern_io.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+std::invalid_argument parse_error(int line, const std::string &message) {
+    return std::invalid_argument("line " + std::to_string(line) + ": " + message);
+}
+
+// "text" without the spaces at either end
+std::string trim(const std::string &text) {
+    auto is_space = [](unsigned char c) { return std::isspace(c); };
+    auto begin = std::find_if_not(text.begin(), text.end(), is_space);
+    auto end = std::find_if_not(text.rbegin(), text.rend(), is_space).base();
+    return begin < end ? std::string(begin, end) : std::string();
+}
+
+// A size from the RLE header, from 0 to 1e9
+int parse_size(const std::string &value, int line) {
+    if (value.empty() || value.size() > 10 ||
+        !std::all_of(value.begin(), value.end(), [](unsigned char c) { return std::isdigit(c); }) ||
+        std::stoll(value) > 1000000000) {
+        throw parse_error(line, "bad size \"" + value + '"');
+    }
+    return static_cast<int>(std::stoll(value));
+}
+
+// The header: "x = 3, y = 3, rule = B36/S23"
+void read_rle_header(const std::string &text, int line, pattern &p) {
+    bool has_x = false;
+    bool has_y = false;
+    std::istringstream items(text);
+    for (std::string item; std::getline(items, item, ',');) {
+        std::size_t equals = item.find('=');
+        if (equals == std::string::npos) {
+            throw parse_error(line,
+                              "expected NAME = VALUE in the header, not \"" + trim(item) + '"');
+        }
+        std::string name = trim(item.substr(0, equals));
+        std::string value = trim(item.substr(equals + 1));
+        if (name == "x") {
+            p.cols = parse_size(value, line);
+            has_x = true;
+        } else if (name == "y") {
+            p.rows = parse_size(value, line);
+            has_y = true;
+        } else if (name == "rule") {
+            try {
+                p.life_rule = parse_rule(value);
+                p.has_rule = true;
+            } catch (const std::invalid_argument &e) {
+                throw parse_error(line, e.what());
+            }
+        } else {
+            throw parse_error(line, "unknown header item \"" + name + '"');
+        }
+    }
+    if (!has_x || !has_y) {
+        throw parse_error(line, "the header must give x and y");
+    }
+}
+
+// The RLE rows, from lines[first] on
+void read_rle_cells(const std::vector<std::string> &lines, std::size_t first, pattern &p) {
+    // long, so that a run can be added and checked before it overflows
+    long row = 0;
+    long column = 0;
+    long count = 0;
+    for (std::size_t i = first; i < lines.size(); ++i) {
+        int line = static_cast<int>(i) + 1;
+        for (char c : lines[i]) {
+            if (std::isdigit(static_cast<unsigned char>(c))) {
+                count = count * 10 + (c - '0');
+                if (count > 1000000000) {
+                    throw parse_error(line, "run too long");
+                }
+                continue;
+            }
+            if (std::isspace(static_cast<unsigned char>(c))) {
+                continue;
+            }
+
+            long n = count == 0 ? 1 : count;
+            count = 0;
+            switch (c) {
+            case 'b':
+                column += n;
+                if (column > p.cols) {
+                    throw parse_error(line, "cells beyond the width in the header");
+                }
+                break;
+            case 'o':
+                if (row >= p.rows || column + n > p.cols) {
+                    throw parse_error(line, "live cells beyond the size in the header");
+                }
+                for (long k = 0; k < n; ++k) {
+                    p.cells.emplace_back(static_cast<int>(row), static_cast<int>(column++));
+                }
+                break;
+            case '$':
+                row += n;
+                column = 0;
+                if (row > p.rows) {
+                    throw parse_error(line, "rows beyond the height in the header");
+                }
+                break;
+            case '!':
+                return;
+            default:
+                throw parse_error(line, std::string("unexpected '") + c + "' in the cells");
+            }
+        }
+    }
+    throw parse_error(static_cast<int>(lines.size()), "the cells must end with '!'");
+}
+
+pattern read_rle(const std::vector<std::string> &lines) {
+    pattern p;
+    std::size_t i = 0;
+    while (i < lines.size() && (lines[i].empty() || lines[i][0] == '#')) {
+        ++i;
+    }
+    if (i == lines.size()) {
+        throw parse_error(static_cast<int>(i), "no header");
+    }
+    read_rle_header(lines[i], static_cast<int>(i) + 1, p);
+    read_rle_cells(lines, i + 1, p);
+    return p;
+}
+
+pattern read_plaintext(const std::vector<std::string> &lines) {
+    pattern p;
+    for (std::size_t i = 0; i < lines.size(); ++i) {
+        if (!lines[i].empty() && lines[i][0] == '!') {
+            continue;
+        }
+        std::string text = trim(lines[i]);
+        for (int column = 0; column < static_cast<int>(text.size()); ++column) {
+            if (text[column] == 'O' || text[column] == '*') {
+                p.cells.emplace_back(p.rows, column);
+            } else if (text[column] != '.') {
+                throw parse_error(static_cast<int>(i) + 1,
+                                  std::string("unexpected '") + text[column] + "' in the cells");
+            }
+        }
+        p.cols = std::max(p.cols, static_cast<int>(text.size()));
+        ++p.rows;
+    }
+    return p;
+}
+
+} // namespace
+
+// Read a pattern, in RLE or in plaintext
+// An RLE file starts with a "#" comment or the "x = " header; anything else is plaintext
+pattern read_pattern(std::istream &in) {
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(in, line);) {
+        lines.push_back(line);
+    }
+    auto first = std::find_if(lines.begin(), lines.end(),
+                              [](const std::string &line) { return !trim(line).empty(); });
+    if (first == lines.end()) {
+        throw std::invalid_argument("empty pattern");
+    }
+    std::string start = trim(*first);
+    if (start[0] == '#' || start[0] == 'x') {
+        return read_rle(lines);
+    }
+    return read_plaintext(lines);
+}
+
+// The same, from a file
+pattern load_pattern(const std::string &file) {
+    std::ifstream in(file);
+    if (!in) {
+        throw std::runtime_error("cannot read " + file);
+    }
+    try {
+        return read_pattern(in);
+    } catch (const std::invalid_argument &e) {
+        throw std::invalid_argument(file + ": " + e.what());
+    }
+}
+
+// Write rows x cols cells in RLE, with lines of at most 70 characters
+// Dead cells at the end of a row, and empty rows at the end, are left out.
+void write_rle(std::ostream &out, int rows, int cols, const cell_reader &is_alive,
+               const rule &r) {
+    out << "x = " << cols << ", y = " << rows << ", rule = " << rule_name(r) << '\n';
+
+    std::string line;
+    auto put = [&](int count, char tag) {
+        std::string item = (count > 1 ? std::to_string(count) : "") + tag;
+        if (line.size() + item.size() > 70) {
+            out << line << '\n';
+            line.clear();
+        }
+        line += item;
+    };
+
+    // Rows ended, but not written yet: they are written before the next live cell
+    int row_ends = 0;
+    for (int row = 0; row < rows; ++row) {
+        int dead = 0;
+        for (int column = 0; column < cols;) {
+            bool alive = is_alive(row, column);
+            int end = column + 1;
+            while (end < cols && is_alive(row, end) == alive) {
+                ++end;
+            }
+            if (alive) {
+                if (row_ends > 0) {
+                    put(row_ends, '$');
+                    row_ends = 0;
+                }
+                if (dead > 0) {
+                    put(dead, 'b');
+                }
+                put(end - column, 'o');
+                dead = 0;
+            } else {
+                dead = end - column;
+            }
+            column = end;
+        }
+        ++row_ends;
+    }
+    put(1, '!');
+    out << line << '\n';
+}
+
+// Write rows x cols cells in plaintext
+// Dead cells at the end of a row are left out.
+void write_plaintext(std::ostream &out, int rows, int cols, const cell_reader &is_alive) {
+    for (int row = 0; row < rows; ++row) {
+        std::string text;
+        for (int column = 0; column < cols; ++column) {
+            text += is_alive(row, column) ? 'O' : '.';
+        }
+        text.erase(text.find_last_not_of('.') + 1);
+        out << text << '\n';
+    }
+}
+
+// Write to a file: RLE if its name ends in ".rle", plaintext otherwise
+void save_pattern(const std::string &file, int rows, int cols, const cell_reader &is_alive,
+                  const rule &r) {
+    std::ofstream out(file);
+    if (file.ends_with(".rle")) {
+        write_rle(out, rows, cols, is_alive, r);
+    } else {
+        write_plaintext(out, rows, cols, is_alive);
+    }
+    if (!out) {
+        throw std::runtime_error("cannot write " + file);
+    }
+}
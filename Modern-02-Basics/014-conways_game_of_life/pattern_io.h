@@ -0,0 +1,48 @@
+#ifndef PATTERN_IO_H_
+#define PATTERN_IO_H_
+
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rule.h"
+
+// A pattern read from a file: its size, its live cells as (row, column) from
+// its top left corner, and its rule, if the file gives one
+struct pattern {
+    int rows{0};
+    int cols{0};
+    std::vector<std::pair<int, int>> cells;
+    rule life_rule{conway};
+    bool has_rule{false};
+};
+
+// Read a pattern in either of the usual formats, told apart by their first line:
+// - RLE: "#" comment lines, a header "x = COLS, y = ROWS[, rule = B36/S23]", then
+//   the rows, run-length encoded: "b" is a dead cell, "o" a live one, "$" ends
+//   a row and "!" the pattern, each after an optional count. "3o$b2o!"
+// - Plaintext: "!" comment lines, then one line per row: "." is a dead cell,
+//   "O" a live one
+// Throws std::invalid_argument, with the line number, if the pattern is not valid
+pattern read_pattern(std::istream &in);
+
+// The same, from a file
+// Throws std::runtime_error if the file cannot be read
+pattern load_pattern(const std::string &file);
+
+// Whether the cell at (row, column) is alive
+using cell_reader = std::function<bool(int row, int column)>;
+
+// Write rows x cols cells, in RLE, with the rule in the header, or in plaintext
+void write_rle(std::ostream &out, int rows, int cols, const cell_reader &is_alive,
+               const rule &r = conway);
+void write_plaintext(std::ostream &out, int rows, int cols, const cell_reader &is_alive);
+
+// Write to a file: RLE if its name ends in ".rle", plaintext otherwise
+// Throws std::runtime_error if the file cannot be written
+void save_pattern(const std::string &file, int rows, int cols, const cell_reader &is_alive,
+                  const rule &r = conway);
+
+#endif // PATTERN_IO_H_
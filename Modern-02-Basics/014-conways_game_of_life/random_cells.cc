@@ -0,0 +1,22 @@
+#include "random_cells.h"
+
+// The next 64 cells, with "density" to 16 binary digits
+// Each bit compares a random binary fraction with "density", digit by digit,
+// until they differ: the 64 comparisons are done at once.
+std::uint64_t random_cells::next_word() {
+    double rest = density;
+    std::uint64_t less = 0;
+    std::uint64_t undecided = ~std::uint64_t{0};
+    for (int digit = 0; digit < 16 && undecided != 0; ++digit) {
+        rest *= 2;
+        std::uint64_t random = engine();
+        if (rest >= 1) {
+            rest -= 1;
+            less |= undecided & ~random;
+            undecided &= random;
+        } else {
+            undecided &= ~random;
+        }
+    }
+    return less;
+}
@@ -0,0 +1,26 @@
+#ifndef RANDOM_CELLS_H_
+#define RANDOM_CELLS_H_
+
+#include <cstdint>
+#include <random>
+
+// The cells of a random first generation, 64 at a time
+//
+// The engines all fill themselves from this, row by row, 64 columns at a time,
+// so the same seed and density give the same cells in every engine, on every
+// platform. A bitgrid stores the words as they are; the other engines create
+// the cells whose bits are set.
+class random_cells {
+    std::mt19937_64 engine;
+    double density;
+
+  public:
+    // Constructor
+    // Each cell is alive with probability "density", from 0 to 1
+    random_cells(std::uint64_t seed, double density) : engine(seed), density(density) {}
+
+    // The next 64 cells: bit i is alive with probability "density"
+    std::uint64_t next_word();
+};
+
+#endif // RANDOM_CELLS_H_
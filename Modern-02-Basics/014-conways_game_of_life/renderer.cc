@@ -0,0 +1,112 @@
+#include "renderer.h"
+
+#include <algorithm>
+#include <charconv>
+#include <iostream>
+
+#ifdef _WIN32
+#include <cstdio>
+#else
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Unchanged cells between two runs of changed cells are written again when
+// that is no longer than moving the cursor over them
+const int max_gap = 8;
+
+// ANSI control command
+// Escape[n;mH moves the cursor to row n, column m (1-based)
+void move_cursor(std::string &output, int row, int column) {
+    char digits[16];
+    output += "\x1b[";
+    output.append(digits, std::to_chars(digits, digits + sizeof(digits), row + 1).ptr);
+    output += ';';
+    output.append(digits, std::to_chars(digits, digits + sizeof(digits), column + 1).ptr);
+    output += 'H';
+}
+
+// Write all of "text" to the standard output, after what is waiting in std::cout
+void write_out(const std::string &text) {
+    std::cout.flush();
+#ifdef _WIN32
+    std::fwrite(text.data(), 1, text.size(), stdout);
+    std::fflush(stdout);
+#else
+    // A terminal may take less than everything at once
+    const char *next = text.data();
+    std::size_t left = text.size();
+    while (left > 0) {
+        ssize_t written = write(STDOUT_FILENO, next, left);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        next += written;
+        left -= written;
+    }
+#endif
+}
+
+} // namespace
+
+// Constructor
+// The output is reserved for the longest frame: every cell, and a cursor
+// movement for each run. Drawing never allocates.
+renderer::renderer(int rows, int cols)
+    : nrows(std::min(rows, default_rows)), ncols(std::min(cols, default_cols)),
+      shown(nrows * ncols), frame(nrows * ncols) {
+    output.reserve(4 + nrows * (ncols + 16 * (ncols / (max_gap + 1) + 1)));
+}
+
+// Add the changes from "shown" to "frame" to the output, and write it
+void renderer::flush() {
+    output.clear();
+    if (!cleared) {
+        // Escape[2J clears the screen
+        output += "\x1b[2J";
+    }
+
+    for (int row = 0; row < nrows; ++row) {
+        const char *cells = &frame[row * ncols];
+        const char *old_cells = &shown[row * ncols];
+        auto changed = [&](int column) { return !cleared || cells[column] != old_cells[column]; };
+
+        int column = 0;
+        while (column < ncols) {
+            if (!changed(column)) {
+                ++column;
+                continue;
+            }
+
+            // A run of changed cells, with gaps of at most max_gap unchanged cells
+            int last_changed = column;
+            for (int c = column + 1; c < ncols && c - last_changed <= max_gap; ++c) {
+                if (changed(c)) {
+                    last_changed = c;
+                }
+            }
+            move_cursor(output, row, column);
+            output.append(cells + column, last_changed + 1 - column);
+            column = last_changed + 1;
+        }
+    }
+
+    // draw() writes every cell of the next frame, so the old one can be reused
+    std::swap(shown, frame);
+    cleared = true;
+    if (!output.empty()) {
+        write_out(output);
+    }
+}
+
+// Move the cursor to the start of the line below the grid
+void renderer::finish() {
+    output.clear();
+    move_cursor(output, nrows, 0);
+    write_out(output);
+}
@@ -0,0 +1,55 @@
+#ifndef RENDERER_H_
+#define RENDERER_H_
+
+#include <string>
+#include <vector>
+
+#include "life.h"
+
+// Draws the generations of an engine on the terminal
+//
+// Writing each cell with its own escape sequence through std::cout takes
+// thousands of small writes per generation, and clearing the screen first
+// makes the terminal redraw all of it. Here a frame is written into one
+// buffer, and only the cells which changed since the last frame are in it:
+// one cursor movement for each run of changed cells, then the cells. The
+// buffer goes to the terminal with one write(). Only the first frame clears
+// the screen.
+//
+// The top left corner of the grid is shown: at most default_rows x default_cols cells.
+class renderer {
+    int nrows;
+    int ncols;
+
+    // The cells on the screen, and the cells of the frame being drawn
+    std::vector<char> shown;
+    std::vector<char> frame;
+    bool cleared{false};
+
+    // The escape sequences and cells which draw the frame
+    std::string output;
+
+    // Add the changes from "shown" to "frame" to the output, and write it
+    void flush();
+
+  public:
+    // Constructor
+    // For a grid of rows x cols cells. Nothing is drawn until draw().
+    renderer(int rows, int cols);
+
+    // Draw the current generation of "life"
+    template <class Engine> void draw(const Engine &life) {
+        for (int row = 0; row < nrows; ++row) {
+            for (int column = 0; column < ncols; ++column) {
+                frame[row * ncols + column] = life.is_alive(row, column) ? live_cell : dead_cell;
+            }
+        }
+        flush();
+    }
+
+    // Move the cursor to the start of the line below the grid, so that what
+    // is written after the last frame does not overwrite it
+    void finish();
+};
+
+#endif // RENDERER_H_
@@ -0,0 +1,108 @@
+#ifndef RULE_H_
+#define RULE_H_
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// A Life-like rule, in B/S notation: "B3/S23" is Conway's Life
+//
+// A dead cell with a number of live neighbours listed after B is born; a
+// live cell with a number listed after S survives; every other cell dies or
+// stays dead. Bit n of "birth" and "survival" is n neighbours, from 0 to 8.
+//
+// The rule is a literal type, so rules can be constants, and template
+// arguments: bitgrid has a kernel for each of compiled_rules, with the masks
+// built into the code.
+struct rule {
+    std::uint16_t birth{0};
+    std::uint16_t survival{0};
+
+    constexpr bool born(int neighbours) const { return (birth >> neighbours) & 1; }
+    constexpr bool survives(int neighbours) const { return (survival >> neighbours) & 1; }
+
+    // Is the cell alive in the next generation?
+    constexpr bool next(bool alive, int neighbours) const {
+        return alive ? survives(neighbours) : born(neighbours);
+    }
+
+    constexpr bool operator==(const rule &) const = default;
+};
+
+// A rule from its B/S notation: "B36/S23", "b36/s23", "S23/B36", or the older
+// "23/36", survival first. Throws std::invalid_argument if it is not valid.
+constexpr rule parse_rule(std::string_view text) {
+    auto fail = [text]() {
+        throw std::invalid_argument("bad rule \"" + std::string(text) +
+                                    "\": expected B/S notation, e.g. B3/S23");
+    };
+    auto mask = [&fail](std::string_view digits) {
+        std::uint16_t bits = 0;
+        for (char digit : digits) {
+            if (digit < '0' || digit > '8') {
+                fail();
+            }
+            bits |= 1 << (digit - '0');
+        }
+        return bits;
+    };
+    auto letter = [](std::string_view part) {
+        return part.empty() ? '\0' : static_cast<char>(part[0] | 0x20); // Lower case
+    };
+
+    std::size_t slash = text.find('/');
+    if (slash == std::string_view::npos) {
+        fail();
+    }
+    std::string_view first = text.substr(0, slash);
+    std::string_view second = text.substr(slash + 1);
+    if (letter(first) == 'b' && letter(second) == 's') {
+        return {mask(first.substr(1)), mask(second.substr(1))};
+    }
+    if (letter(first) == 's' && letter(second) == 'b') {
+        return {mask(second.substr(1)), mask(first.substr(1))};
+    }
+    return {mask(second), mask(first)};
+}
+
+// The B/S notation of a rule: "B36/S23"
+inline std::string rule_name(const rule &r) {
+    std::string name = "B";
+    for (int n = 0; n <= 8; ++n) {
+        if (r.born(n)) {
+            name += static_cast<char>('0' + n);
+        }
+    }
+    name += "/S";
+    for (int n = 0; n <= 8; ++n) {
+        if (r.survives(n)) {
+            name += static_cast<char>('0' + n);
+        }
+    }
+    return name;
+}
+
+constexpr rule conway = parse_rule("B3/S23");
+
+// The rules which bitgrid compiles a kernel for. Any other rule runs with a
+// generic kernel, which reads the masks as it goes, and is slower.
+struct named_rule {
+    const char *name;
+    rule value;
+};
+
+constexpr named_rule compiled_rules[] = {
+    {"Conway's Life", conway},
+    {"HighLife", parse_rule("B36/S23")},
+    {"Seeds", parse_rule("B2/S")},
+    {"Day & Night", parse_rule("B3678/S34678")},
+    {"Life without Death", parse_rule("B3/S012345678")},
+    {"Replicator", parse_rule("B1357/S1357")},
+    {"2x2", parse_rule("B36/S125")},
+    {"Maze", parse_rule("B3/S12345")},
+    {"Morley", parse_rule("B368/S245")},
+    {"Anneal", parse_rule("B4678/S35678")},
+};
+
+#endif // RULE_H_
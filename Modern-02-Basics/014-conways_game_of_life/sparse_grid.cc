@@ -0,0 +1,203 @@
+#include "sparse_grid.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "thread_pool.h"
+
+namespace {
+
+// Rows in a tile, and words across: 8 words are a 64-byte cache line
+const int tile_height = 16;
+const std::size_t tile_words = 8;
+
+} // namespace
+
+// Constructor
+// All the cells are dead. With B0, empty tiles come to life, so every tile is
+// calculated in the first generation.
+sparse_grid::sparse_grid(ThreadPool &pool, int rows, int cols, bool torus, const rule &r)
+    : pool(pool), life_rule(r), current_generation(rows, cols, torus),
+      next_generation(rows, cols, torus), tile_rows((rows + tile_height - 1) / tile_height),
+      tile_cols((current_generation.words() + tile_words - 1) / tile_words),
+      changed(tile_rows * tile_cols), added(tile_rows * tile_cols) {
+    if (r.born(0)) {
+        for (std::size_t tile = 0; tile < tiles(); ++tile) {
+            mark(tile);
+        }
+    }
+}
+
+// The cells of tile "tile"
+bit_block sparse_grid::block(std::size_t tile) const {
+    int row = static_cast<int>(tile / tile_cols) * tile_height;
+    std::size_t word = tile % tile_cols * tile_words;
+    return {row, std::min(row + tile_height, rows()), word,
+            std::min(word + tile_words, current_generation.words())};
+}
+
+// Mark a tile as changed
+void sparse_grid::mark(std::size_t tile) {
+    if (!changed[tile]) {
+        changed[tile] = 1;
+        changed_tiles.push_back(tile);
+    }
+}
+
+// Create a cell at (row, column)
+void sparse_grid::create(int row, int column) {
+    current_generation.create(row, column);
+    mark(row / tile_height * tile_cols + column / 64 / tile_words);
+}
+
+// Populate the grid with cells, at random
+void sparse_grid::randomize(std::uint64_t seed, double density) {
+    current_generation.randomize(seed, density);
+    for (std::size_t tile = 0; tile < tiles(); ++tile) {
+        mark(tile);
+    }
+}
+
+// The list of active tiles: the changed tiles and their neighbours
+// On a toroidal grid, the tiles on opposite edges are neighbours
+void sparse_grid::find_active_tiles() {
+    active_tiles.clear();
+    long down = tile_rows;
+    long across = tile_cols;
+    for (std::size_t tile : changed_tiles) {
+        long tile_row = tile / tile_cols;
+        long tile_col = tile % tile_cols;
+        for (long r = tile_row - 1; r <= tile_row + 1; ++r) {
+            for (long c = tile_col - 1; c <= tile_col + 1; ++c) {
+                long nr = r;
+                long nc = c;
+                if (is_toroidal()) {
+                    nr = (r + down) % down;
+                    nc = (c + across) % across;
+                } else if (r < 0 || r >= down || c < 0 || c >= across) {
+                    continue;
+                }
+                std::size_t neighbour = nr * tile_cols + nc;
+                if (added[neighbour] != generation) {
+                    added[neighbour] = generation;
+                    active_tiles.push_back(neighbour);
+                }
+            }
+        }
+    }
+
+    // In memory order, to read the grid from front to back
+    std::sort(active_tiles.begin(), active_tiles.end());
+}
+
+// Does the tile differ between the two generations?
+// The bits after the last column are not cells: wrap() may have set one of them
+bool sparse_grid::tile_changed(std::size_t tile) const {
+    bit_block b = block(tile);
+    std::size_t last = b.word_end - 1;
+    std::uint64_t mask = b.word_end == current_generation.words()
+                             ? current_generation.last_word_mask()
+                             : ~std::uint64_t{0};
+    for (int row = b.row_begin; row < b.row_end; ++row) {
+        const std::uint64_t *before = current_generation.row_bits(row);
+        const std::uint64_t *after = next_generation.row_bits(row);
+        std::uint64_t differ = (before[last] ^ after[last]) & mask;
+        for (std::size_t word = b.word_begin; word < last; ++word) {
+            differ |= before[word] ^ after[word];
+        }
+        if (differ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Calculate every cell, then find the tiles which changed
+// A row of tiles is compared just after it is calculated, while its cells
+// are still in the cache: a second pass would read both grids again.
+void sparse_grid::calculate_all() {
+    current_generation.wrap();
+
+    std::size_t words = current_generation.words();
+    std::size_t last = words - 1;
+    std::uint64_t mask = current_generation.last_word_mask();
+    std::size_t nblocks = std::min(block_count(pool, rows() * words), tile_rows);
+    parallel_blocks(pool, nblocks, [&](std::size_t b) {
+        std::vector<std::uint64_t> differ(tile_cols);
+        for (std::size_t tile_row = block_begin(tile_rows, nblocks, b);
+             tile_row < block_begin(tile_rows, nblocks, b + 1); ++tile_row) {
+            int row_begin = static_cast<int>(tile_row) * tile_height;
+            int row_end = std::min(row_begin + tile_height, rows());
+            calculate_block(current_generation, next_generation,
+                            {row_begin, row_end, 0, words}, life_rule);
+
+            // Whole rows at a time, from front to back
+            std::fill(differ.begin(), differ.end(), 0);
+            for (int row = row_begin; row < row_end; ++row) {
+                const std::uint64_t *before = current_generation.row_bits(row);
+                const std::uint64_t *after = next_generation.row_bits(row);
+                for (std::size_t tile_col = 0; tile_col < tile_cols; ++tile_col) {
+                    std::size_t word_end = std::min((tile_col + 1) * tile_words, last);
+                    std::uint64_t bits = 0;
+                    for (std::size_t word = tile_col * tile_words; word < word_end; ++word) {
+                        bits |= before[word] ^ after[word];
+                    }
+                    differ[tile_col] |= bits;
+                }
+                differ[last / tile_words] |= (before[last] ^ after[last]) & mask;
+            }
+            for (std::size_t tile_col = 0; tile_col < tile_cols; ++tile_col) {
+                changed[tile_row * tile_cols + tile_col] = differ[tile_col] != 0;
+            }
+        }
+    });
+
+    std::size_t ntiles = tiles();
+    changed_tiles.clear();
+    for (std::size_t tile = 0; tile < ntiles; ++tile) {
+        if (changed[tile]) {
+            changed_tiles.push_back(tile);
+        }
+    }
+}
+
+// Calculate the active tiles
+// Every tile which changed last time is active, so each entry of "changed"
+// which was set is either set again or cleared here
+void sparse_grid::calculate_active() {
+    current_generation.wrap();
+
+    std::size_t nactive = active_tiles.size();
+    std::size_t nblocks = block_count(pool, nactive * tile_height * tile_words);
+    parallel_blocks(pool, nblocks, [&](std::size_t b) {
+        for (std::size_t i = block_begin(nactive, nblocks, b);
+             i < block_begin(nactive, nblocks, b + 1); ++i) {
+            std::size_t tile = active_tiles[i];
+            calculate_block(current_generation, next_generation, block(tile), life_rule);
+            changed[tile] = tile_changed(tile);
+        }
+    });
+
+    changed_tiles.clear();
+    for (std::size_t tile : active_tiles) {
+        if (changed[tile]) {
+            changed_tiles.push_back(tile);
+        }
+    }
+}
+
+// Calculate the next generation
+void sparse_grid::step() {
+    ++generation;
+    find_active_tiles();
+
+    if (3 * active_tiles.size() > 2 * tiles()) {
+        calculated = tiles();
+        calculate_all();
+    } else {
+        calculated = active_tiles.size();
+        calculate_active();
+    }
+
+    std::swap(current_generation, next_generation);
+}
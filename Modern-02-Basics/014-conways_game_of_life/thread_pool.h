@@ -0,0 +1,170 @@
+/**
+ * Work-stealing thread pool for fork-join algorithms
+ *
+ * This is the pool from 088-thread_pool_work_stealing_contd, with the changes which a library of
+ * parallel algorithms needs:
+ * - Shutdown: the destructor wakes the workers, lets them finish the queued tasks, and joins them.
+ *   (This was the TODO in 088.)
+ * - Idle workers sleep on a condition variable, instead of polling the queues every 10ms. They are
+ *   woken as soon as a task is submitted.
+ * - A worker takes its newest task from the back of its own queue, and steals the oldest task from
+ *   the front of another worker's queue. The newest task works on data which is probably still in
+ *   this core's cache. In a recursive algorithm, the oldest task is the largest one, so a thief
+ *   takes away a big piece of work and does not have to come back soon.
+ * - A task submitted from a worker thread goes to that worker's own queue.
+ * - TaskGroup::wait() runs queued tasks while it waits. A task which forks subtasks and waits for
+ *   them keeps its worker busy, so recursive algorithms cannot deadlock the pool.
+ *
+ * parallel_blocks() and its helpers split an array into blocks, one task per block.
+ *
+ * This file is the pool of Thread-11-Parallel_Building_Blocks, copied in unchanged. Each
+ * calculate() of the Life grids uses block_count() and parallel_blocks() to split the grid into
+ * bands of rows, one task per band, and sparse_grid uses them for its rows of tiles and its list
+ * of active tiles.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// All the task functions will have this type
+using Func = std::function<void()>;
+
+class ThreadPool {
+    // One queue for each worker, in a cache line of its own
+    struct alignas(64) WorkQueue {
+        std::mutex mut;
+        std::deque<Func> tasks;
+    };
+
+    std::unique_ptr<WorkQueue[]> work_queues;
+
+    // Vector of thread objects which make up the pool
+    std::vector<std::thread> threads;
+
+    // The number of threads in the pool
+    int thread_count;
+
+    // Number of tasks in all the queues
+    std::atomic<long> queued{0};
+
+    // Idle workers wait here until "queued" is non-zero, or the pool is stopping
+    std::mutex sleep_mut;
+    std::condition_variable sleep_cv;
+    std::atomic<int> sleepers{0};
+    bool stopping{false};
+
+    // Queue for the next task submitted by a thread which is not a worker
+    std::atomic<unsigned> next_queue{0};
+
+    // Entry point function for the threads
+    void worker(int idx);
+
+    // Take a task from the back of queue "idx"
+    bool try_pop(int idx, Func &task);
+
+    // Take a task from the front of any queue except "idx" (-1 for none)
+    bool try_steal(int idx, Func &task);
+
+    // The calling thread's queue, or -1 if it is not one of our workers
+    int current_index() const;
+
+  public:
+    // By default, one thread for each core but one, as in 088. The thread which waits for a
+    // TaskGroup also runs tasks, and it uses the last core.
+    explicit ThreadPool(int nthreads = default_thread_count());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    static int default_thread_count();
+
+    int size() const { return thread_count; }
+
+    // Add a task to the queue
+    void submit(Func func);
+
+    // Run one queued task on the calling thread. Returns false if there was none.
+    bool run_pending_task();
+};
+
+/**
+ * A set of tasks which can be waited for together:
+ *     TaskGroup group(pool);
+ *     group.run(left_half);
+ *     right_half();            // The current thread does some of the work itself
+ *     group.wait();
+ * If a task throws, wait() rethrows the first exception after all the tasks have finished.
+ */
+class TaskGroup {
+    ThreadPool &pool;
+    std::atomic<long> unfinished{0};
+    std::mutex error_mut;
+    std::exception_ptr error;
+
+    void wait_for_tasks();
+
+  public:
+    explicit TaskGroup(ThreadPool &pool) : pool(pool) {}
+
+    // The tasks refer to this object, so it cannot go away until they have finished
+    ~TaskGroup() { wait_for_tasks(); }
+
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+    template <class F> void run(F func) {
+        this->unfinished.fetch_add(1, std::memory_order_relaxed);
+        this->pool.submit([this, func]() {
+            try {
+                func();
+            } catch (...) {
+                std::lock_guard<std::mutex> lck_guard(this->error_mut);
+                if (!this->error)
+                    this->error = std::current_exception();
+            }
+            // Release: the task's results are visible to the thread which sees the count drop
+            this->unfinished.fetch_sub(1, std::memory_order_release);
+        });
+    }
+
+    // Run queued tasks until all the tasks in this group have finished
+    void wait();
+};
+
+// An array of this many elements is split into blocks of about this size
+constexpr std::size_t block_grain = 64 * 1024;
+
+// Call func(b) for b = 0, 1, ..., nblocks - 1 in parallel
+template <class F> void parallel_blocks(ThreadPool &pool, std::size_t nblocks, F func) {
+    TaskGroup group(pool);
+    for (std::size_t b = 1; b < nblocks; ++b)
+        group.run([&func, b]() { func(b); });
+    func(0);
+    group.wait();
+}
+
+// Split n elements into blocks of about block_grain elements, with at most 4 blocks per thread
+inline std::size_t block_count(const ThreadPool &pool, std::size_t n) {
+    std::size_t max_blocks = 4 * (pool.size() + 1);
+    return std::clamp<std::size_t>(n / block_grain, 1, max_blocks);
+}
+
+// First element of block b, when n elements are split into nblocks blocks
+inline std::size_t block_begin(std::size_t n, std::size_t nblocks, std::size_t b) {
+    return n * b / nblocks;
+}
+
+#endif // THREAD_POOL_H
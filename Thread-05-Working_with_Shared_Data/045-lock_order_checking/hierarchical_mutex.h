@@ -0,0 +1,178 @@
+/**
+ * Mutex wrappers which check the lock order in debug builds
+ *
+ * hierarchical_mutex (from "C++ Concurrency in Action", section 3.2.5)
+ * - Each mutex is given a level number.
+ * - A thread may only lock a mutex whose level is LOWER than the level of every mutex it already
+ *   holds. E.g. holding level 10000, it may lock level 5000 but not level 20000.
+ * - Since every thread locks in decreasing level order, a cycle of waiting threads is impossible.
+ * - A violation throws lock_order_error the first time the wrong order is attempted, even if the
+ *   other thread is nowhere near the mutex. The bug shows up in every test run, not only when the
+ *   timing is unlucky.
+ * - try_lock() cannot deadlock, so it does not check the level. std::lock() and std::scoped_lock
+ *   use it, and may lock the mutexes in any order.
+ * - The mutexes may be unlocked in any order. std::scoped_lock unlocks them in the order they were
+ *   given, which is not the reverse of the order they were locked.
+ *
+ * tracked_mutex
+ * - Wraps any mutex type without asking the programmer to assign levels.
+ * - Every acquisition is recorded in the lock_order_graph, which throws lock_order_error as soon
+ *   as two code paths disagree about the order of two (or more) mutexes.
+ *
+ * Both types meet the Lockable requirements, so they work with std::lock_guard, std::unique_lock
+ * and std::scoped_lock.
+ *
+ * In release builds (NDEBUG defined), both types contain nothing but the wrapped mutex and every
+ * member function is an inline call to it. The checks cost nothing.
+ */
+
+#ifndef HIERARCHICAL_MUTEX_H
+#define HIERARCHICAL_MUTEX_H
+
+#include <algorithm>
+#include <climits>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "lock_order_graph.h"
+
+class hierarchical_mutex {
+    std::mutex mut;
+
+#ifndef NDEBUG
+    // The level of this mutex
+    const unsigned long hierarchy_value;
+
+    const char *name;
+
+    // The hierarchical mutexes which each thread holds, in the order it locked them.
+    // unlock() removes its own entry, wherever it is in the list.
+    static inline thread_local std::vector<const hierarchical_mutex *> held_mutexes;
+
+    // The lowest level which this thread holds.
+    // A thread which holds no hierarchical_mutex can lock any of them.
+    static unsigned long this_thread_hierarchy_value() {
+        unsigned long value = ULONG_MAX;
+        for (const hierarchical_mutex *held : held_mutexes) {
+            value = std::min(value, held->hierarchy_value);
+        }
+        return value;
+    }
+
+    void check_for_hierarchy_violation() const {
+        unsigned long thread_value = this_thread_hierarchy_value();
+        if (thread_value <= hierarchy_value) {
+            throw lock_order_error(std::string("hierarchy violated: locking \"") + name +
+                                   "\" (level " + std::to_string(hierarchy_value) +
+                                   ") while holding a mutex of level " +
+                                   std::to_string(thread_value));
+        }
+    }
+
+    void forget_held() {
+        // Mutexes are usually unlocked in reverse order, so search from the back
+        auto it = std::find(held_mutexes.rbegin(), held_mutexes.rend(), this);
+        if (it != held_mutexes.rend()) {
+            held_mutexes.erase(std::next(it).base());
+        }
+    }
+#endif
+
+  public:
+#ifndef NDEBUG
+    explicit hierarchical_mutex(unsigned long value, const char *name = "hierarchical_mutex")
+        : hierarchy_value(value), name(name) {}
+    ~hierarchical_mutex() { lock_order_graph::instance().forget(this); }
+#else
+    explicit hierarchical_mutex(unsigned long, const char * = nullptr) {}
+#endif
+
+    hierarchical_mutex(const hierarchical_mutex &) = delete;
+    hierarchical_mutex &operator=(const hierarchical_mutex &) = delete;
+
+    void lock() {
+#ifndef NDEBUG
+        check_for_hierarchy_violation();
+        lock_order_graph::instance().before_lock(this, name, true);
+#endif
+        mut.lock();
+#ifndef NDEBUG
+        held_mutexes.push_back(this);
+#endif
+    }
+
+    // Never throws: std::lock_guard and std::scoped_lock call it from their destructors
+    void unlock() {
+#ifndef NDEBUG
+        forget_held();
+#endif
+        mut.unlock();
+#ifndef NDEBUG
+        lock_order_graph::instance().after_unlock(this);
+#endif
+    }
+
+    bool try_lock() {
+#ifndef NDEBUG
+        lock_order_graph::instance().before_lock(this, name, false);
+        if (!mut.try_lock()) {
+            lock_order_graph::instance().lock_failed(this);
+            return false;
+        }
+        held_mutexes.push_back(this);
+        return true;
+#else
+        return mut.try_lock();
+#endif
+    }
+};
+
+template <class Mutex = std::mutex> class tracked_mutex {
+    Mutex mut;
+
+#ifndef NDEBUG
+    const char *name;
+#endif
+
+  public:
+#ifndef NDEBUG
+    explicit tracked_mutex(const char *name = "tracked_mutex") : name(name) {}
+    ~tracked_mutex() { lock_order_graph::instance().forget(this); }
+#else
+    explicit tracked_mutex(const char * = nullptr) {}
+#endif
+
+    tracked_mutex(const tracked_mutex &) = delete;
+    tracked_mutex &operator=(const tracked_mutex &) = delete;
+
+    void lock() {
+#ifndef NDEBUG
+        lock_order_graph::instance().before_lock(this, name, true);
+#endif
+        mut.lock();
+    }
+
+    void unlock() {
+        mut.unlock();
+#ifndef NDEBUG
+        lock_order_graph::instance().after_unlock(this);
+#endif
+    }
+
+    bool try_lock() {
+#ifndef NDEBUG
+        lock_order_graph::instance().before_lock(this, name, false);
+        if (!mut.try_lock()) {
+            lock_order_graph::instance().lock_failed(this);
+            return false;
+        }
+        return true;
+#else
+        return mut.try_lock();
+#endif
+    }
+};
+
+#endif // HIERARCHICAL_MUTEX_H
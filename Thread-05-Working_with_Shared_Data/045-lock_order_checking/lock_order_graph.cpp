@@ -0,0 +1,191 @@
+/**
+ * Lock-order graph implementation (debug builds only)
+ */
+
+#include "lock_order_graph.h"
+
+#ifndef NDEBUG
+
+#include <algorithm>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <execinfo.h>
+#include <sstream>
+#include <thread>
+
+namespace {
+// A mutex which is currently held by this thread
+struct held_mutex {
+    const void *mtx;
+    const char *name;
+};
+
+// Each thread has its own list of held mutexes, so it needs no locking
+thread_local std::vector<held_mutex> held;
+
+// Turn "./a.out(_Z5funcAv+0x2b) [0x...]" into "./a.out(funcA()+0x2b) [0x...]"
+std::string demangle(const char *symbol) {
+    std::string str(symbol);
+    auto open = str.find('(');
+    auto plus = str.find('+', open);
+
+    if (open == std::string::npos || plus == std::string::npos || plus == open + 1)
+        return str;
+
+    int status = 0;
+    std::string mangled = str.substr(open + 1, plus - open - 1);
+    char *name = abi::__cxa_demangle(mangled.c_str(), nullptr, nullptr, &status);
+
+    if (status == 0 && name) {
+        str.replace(open + 1, mangled.size(), name);
+    }
+    std::free(name);
+    return str;
+}
+
+// Number of stack frames shown for each call site in a report
+constexpr int frames_to_print = 4;
+
+void print_site(std::ostringstream &os, const lock_order_graph::call_site &site) {
+    char **symbols = backtrace_symbols(site.frames, site.depth);
+    if (!symbols) {
+        os << "        (no backtrace available)\n";
+        return;
+    }
+
+    // The innermost frames are the graph itself and the mutex wrapper. Skip them, so that the
+    // first frame printed is the std::lock_guard or the user code which called lock()
+    int first = 0;
+    while (first < site.depth) {
+        std::string frame = demangle(symbols[first]);
+        if (frame.find("lock_order_graph::") == std::string::npos &&
+            frame.find("hierarchical_mutex::") == std::string::npos &&
+            frame.find("tracked_mutex<") == std::string::npos)
+            break;
+        ++first;
+    }
+
+    // The outermost frames are usually thread start-up code, which is not interesting
+    for (int i = first; i < site.depth && i < first + frames_to_print; ++i) {
+        os << "        #" << i - first << ' ' << demangle(symbols[i]) << '\n';
+    }
+    std::free(symbols);
+}
+} // namespace
+
+lock_order_graph &lock_order_graph::instance() {
+    // Never destroyed, so that mutexes with static storage duration can still use it at exit
+    static lock_order_graph *graph = new lock_order_graph;
+    return *graph;
+}
+
+bool lock_order_graph::find_path(const void *from, const void *to,
+                                 std::vector<const void *> &path,
+                                 std::unordered_set<const void *> &visited) {
+    path.push_back(from);
+    if (from == to)
+        return true;
+
+    // A node we have already searched from has no path to "to"
+    if (visited.insert(from).second) {
+        auto it = nodes.find(from);
+        if (it != nodes.end()) {
+            for (auto &[next, e] : it->second.out) {
+                if (find_path(next, to, path, visited))
+                    return true;
+            }
+        }
+    }
+
+    path.pop_back();
+    return false;
+}
+
+std::string lock_order_graph::describe_cycle(const void *held_mtx, const void *acquiring,
+                                             const call_site &acquiring_site,
+                                             const std::vector<const void *> &path) {
+    std::ostringstream os;
+    auto name = [this](const void *mtx) { return '"' + nodes[mtx].name + '"'; };
+
+    os << "lock-order inversion in thread " << std::this_thread::get_id() << ": locking "
+       << name(acquiring) << " while holding " << name(held_mtx) << '\n';
+
+    os << "    " << name(acquiring) << " is being locked at:\n";
+    print_site(os, acquiring_site);
+
+    os << "but the opposite order was established earlier:\n";
+    for (std::size_t i = 0; i + 1 < path.size(); ++i) {
+        const edge &e = nodes[path[i]].out.at(path[i + 1]);
+        os << "    " << name(path[i]) << " -> " << name(path[i + 1]) << '\n';
+        os << "      " << name(path[i + 1]) << " was locked, while holding " << name(path[i])
+           << ", at:\n";
+        print_site(os, e.site);
+    }
+    return os.str();
+}
+
+void lock_order_graph::before_lock(const void *mtx, const char *name, bool blocking) {
+    if (blocking) {
+        // Locking a non-recursive mutex twice is the simplest deadlock of all
+        auto self = std::find_if(held.begin(), held.end(),
+                                 [mtx](const held_mutex &h) { return h.mtx == mtx; });
+        if (self != held.end()) {
+            throw lock_order_error(std::string("thread tried to lock \"") + name +
+                                   "\" which it already holds");
+        }
+
+        // Add an edge from every mutex we hold to the one we are about to lock
+        if (!held.empty()) {
+            std::lock_guard<std::mutex> lck_guard(mut);
+            nodes[mtx].name = name;
+
+            // Taken the first time it is needed, so that an order seen before costs no backtrace
+            call_site site;
+
+            for (auto &h : held) {
+                auto &from = nodes[h.mtx];
+                from.name = h.name;
+
+                // Most acquisitions follow an order we have already seen
+                if (from.out.count(mtx))
+                    continue;
+
+                if (site.depth == 0) {
+                    site.depth = backtrace(site.frames, max_frames);
+                }
+
+                // A path back from the new mutex to one we hold means the new edge closes a cycle
+                std::vector<const void *> path;
+                std::unordered_set<const void *> visited;
+                if (find_path(mtx, h.mtx, path, visited)) {
+                    throw lock_order_error(describe_cycle(h.mtx, mtx, site, path));
+                }
+
+                from.out.emplace(mtx, edge{site});
+            }
+        }
+    }
+
+    held.push_back({mtx, name});
+}
+
+void lock_order_graph::lock_failed(const void *mtx) { after_unlock(mtx); }
+
+void lock_order_graph::after_unlock(const void *mtx) {
+    // Mutexes are usually unlocked in reverse order, so search from the back
+    auto it = std::find_if(held.rbegin(), held.rend(),
+                           [mtx](const held_mutex &h) { return h.mtx == mtx; });
+    if (it != held.rend()) {
+        held.erase(std::next(it).base());
+    }
+}
+
+void lock_order_graph::forget(const void *mtx) {
+    std::lock_guard<std::mutex> lck_guard(mut);
+    nodes.erase(mtx);
+    for (auto &[ptr, n] : nodes) {
+        n.out.erase(mtx);
+    }
+}
+
+#endif // NDEBUG
@@ -0,0 +1,101 @@
+/**
+ * Lock-order graph
+ *
+ * A deadlock needs a cycle of threads, each holding one mutex and waiting for the next. The cycle
+ * only shows up when the threads happen to interleave badly, which is why lock-order bugs hide in
+ * testing and appear under production load.
+ *
+ * The graph records an edge "A -> B" whenever a thread locks B while it is holding A. If a thread
+ * ever locks A while holding B, the edge "B -> A" closes a cycle and the program CAN deadlock, even
+ * if this particular run did not. We detect the cycle when the edge is added, i.e. at acquisition
+ * time, before the thread blocks on the mutex.
+ *
+ * Each edge remembers where it was first created (a backtrace of the call which locked "to" while
+ * holding "from"), so the report shows the two (or more) call sites that disagree about the order.
+ * The backtrace is only taken for a new edge or for a report: locking in an order which has been
+ * seen before costs no backtrace.
+ *
+ * The graph only exists in debug builds. When NDEBUG is defined, every hook is an empty inline
+ * function and the mutex wrappers in hierarchical_mutex.h have no extra data members.
+ */
+
+#ifndef LOCK_ORDER_GRAPH_H
+#define LOCK_ORDER_GRAPH_H
+
+#include <stdexcept>
+#include <string>
+
+// Thrown when locking a mutex would break the lock order
+class lock_order_error : public std::logic_error {
+  public:
+    explicit lock_order_error(const std::string &what) : std::logic_error(what) {}
+};
+
+#ifndef NDEBUG
+
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class lock_order_graph {
+  public:
+    // Maximum number of stack frames remembered for each call site
+    static constexpr int max_frames = 16;
+
+    // A backtrace taken when a mutex was locked in a new order
+    struct call_site {
+        void *frames[max_frames];
+        int depth{0};
+    };
+
+  private:
+    // "from" was held when "to" was locked
+    struct edge {
+        call_site site; // where "to" was locked while holding "from"
+    };
+
+    struct node {
+        std::string name;
+        std::unordered_map<const void *, edge> out;
+    };
+
+    // Protects the graph. The graph is shared by all threads.
+    std::mutex mut;
+    std::unordered_map<const void *, node> nodes;
+
+    lock_order_graph() = default;
+
+    // Depth-first search for a path from "from" to "to". On success, "path" holds the nodes
+    bool find_path(const void *from, const void *to, std::vector<const void *> &path,
+                   std::unordered_set<const void *> &visited);
+
+    std::string describe_cycle(const void *held, const void *acquiring,
+                               const call_site &acquiring_site,
+                               const std::vector<const void *> &path);
+
+  public:
+    lock_order_graph(const lock_order_graph &) = delete;
+    lock_order_graph &operator=(const lock_order_graph &) = delete;
+
+    // There is one graph for the whole program
+    static lock_order_graph &instance();
+
+    // Called by a mutex wrapper BEFORE it locks "mtx". Throws lock_order_error if the new edges
+    // would close a cycle. "blocking" is false for try_lock(), which cannot deadlock and so only
+    // records that the mutex is held.
+    void before_lock(const void *mtx, const char *name, bool blocking);
+
+    // Called by a mutex wrapper after a try_lock() which failed
+    void lock_failed(const void *mtx);
+
+    // Called by a mutex wrapper AFTER it unlocks "mtx"
+    void after_unlock(const void *mtx);
+
+    // Called from a mutex wrapper's destructor, since its address may be reused
+    void forget(const void *mtx);
+};
+
+#endif // NDEBUG
+
+#endif // LOCK_ORDER_GRAPH_H
@@ -0,0 +1,101 @@
+/**
+ * Lock-order checking
+ *
+ * `039-deadlock.cpp` only deadlocks when thread A and thread B run at the same time. If thread B
+ * happens to start after thread A has released its locks, the program runs correctly and the bug
+ * is hidden until it meets a busier machine.
+ *
+ * Here we run the same two functions one after the other, so they can never actually deadlock.
+ * The lock-order checks still find the bug, because they look at the ORDER in which each thread
+ * locks the mutexes, not at whether any thread is waiting.
+ *
+ * Build in debug mode to enable the checks, and with -rdynamic so that the reports can show
+ * function names. Build with -DNDEBUG and the wrappers are plain mutexes again.
+ */
+
+#include "hierarchical_mutex.h"
+
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+/**
+ * The deadlock from 039-deadlock.cpp, using tracked mutexes
+ * - Thread A locks mutex 1, then mutex 2.
+ * - Thread B locks mutex 2, then mutex 1.
+ */
+tracked_mutex<> mut1("mutex 1");
+tracked_mutex<> mut2("mutex 2");
+void funcA() {
+    std::lock_guard<tracked_mutex<>> lck_guard1(mut1);
+    std::lock_guard<tracked_mutex<>> lck_guard2(mut2);
+    std::cout << "Thread A has locked mutex 1 and mutex 2\n";
+}
+void funcB() {
+    std::lock_guard<tracked_mutex<>> lck_guard1(mut2);
+    std::lock_guard<tracked_mutex<>> lck_guard2(mut1); // Reverses the order used by funcA
+    std::cout << "Thread B has locked mutex 2 and mutex 1\n";
+}
+
+/**
+ * Layered code with hierarchical mutexes
+ * - High-level code (level 10000) may call low-level code (level 5000) while holding its lock.
+ * - Low-level code must not call back into high-level code while holding its lock.
+ */
+hierarchical_mutex high_level_mutex(10000, "high-level mutex");
+hierarchical_mutex low_level_mutex(5000, "low-level mutex");
+void low_level_func() {
+    std::lock_guard<hierarchical_mutex> lck_guard(low_level_mutex);
+    std::cout << "Low-level function has locked the low-level mutex\n";
+}
+void high_level_func() {
+    std::lock_guard<hierarchical_mutex> lck_guard(high_level_mutex);
+    low_level_func(); // OK: 10000 -> 5000
+}
+void callback_func() {
+    std::lock_guard<hierarchical_mutex> lck_guard(low_level_mutex);
+    std::lock_guard<hierarchical_mutex> lck_guard2(high_level_mutex); // Error: 5000 -> 10000
+    std::cout << "Callback function has locked the low-level and high-level mutexes\n";
+}
+
+void scoped_lock_func() {
+    // Locks both, then unlocks the high-level mutex first
+    std::scoped_lock lck(high_level_mutex, low_level_mutex);
+    std::cout << "scoped_lock has locked the high-level and low-level mutexes\n";
+}
+
+// Run a function in a thread and report any lock-order error it throws
+template <typename Func> void run(const char *label, Func func) {
+    std::thread thr([label, func]() {
+        try {
+            func();
+        } catch (const lock_order_error &e) {
+            std::cout << label << " - lock_order_error:\n" << e.what() << '\n';
+        }
+    });
+    thr.join();
+}
+
+// Debug build:   g++ -std=c++20 -Wall -Wextra -pedantic -pthread -rdynamic main.cpp
+//                lock_order_graph.cpp && ./a.out
+// Release build: g++ -std=c++20 -Wall -Wextra -pedantic -pthread -O2 -DNDEBUG main.cpp
+//                lock_order_graph.cpp && ./a.out
+int main() {
+#ifdef NDEBUG
+    std::cout << "Release build: lock-order checks are disabled\n";
+    std::cout << "sizeof(hierarchical_mutex) == sizeof(std::mutex): " << std::boolalpha
+              << (sizeof(hierarchical_mutex) == sizeof(std::mutex)) << '\n';
+#endif
+
+    // The threads run one at a time, so there is no deadlock...
+    run("Thread A", funcA);
+
+    // ...but thread B is told that it locks the mutexes in the wrong order
+    run("Thread B", funcB);
+
+    std::cout << "--------------------------------\n";
+
+    run("High-level thread", high_level_func);
+    run("scoped_lock thread", scoped_lock_func);
+    run("Callback thread", callback_func);
+}
@@ -0,0 +1,152 @@
+/**
+ * Test program for the resource arbiter
+ *
+ * Part 1: the dining philosophers from 044-dining_philosophers_problem_part3.cpp. Each philosopher
+ *         asks the arbiter for both forks at once, so there is no try_lock() and no waiting for
+ *         seconds before trying again. Every philosopher gets the same number of mouthfuls.
+ *
+ * Part 2: a stress test with thousands of resources and a thousand clients. Each client repeatedly
+ *         takes a random set of resources, and updates a counter in each of them without any other
+ *         locking. If the arbiter ever gave a resource to two clients at once, an update would be
+ *         lost, and the counters would add up to less than the number of uses.
+ */
+
+#include "resource_arbiter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::literals;
+
+// Part 1
+constexpr int nforks = 5;
+constexpr int nphilosophers = nforks;
+constexpr int meals = 20;
+std::string names[nphilosophers] = {"A", "B", "C", "D", "E"};
+int mouthfuls[nphilosophers] = {0};
+
+void dine(ResourceArbiter &arbiter, int phil_no) {
+    std::size_t lfork = phil_no;
+    std::size_t rfork = (phil_no + 1) % nforks;
+
+    for (int i = 0; i < meals; ++i) {
+        // Think
+        std::this_thread::sleep_for(1ms);
+
+        // Pick up both forks, or wait until both are available
+        ResourceArbiter::Lease forks(arbiter, phil_no, {lfork, rfork});
+
+        // Eat
+        ++mouthfuls[phil_no];
+        std::this_thread::sleep_for(2ms);
+
+        // The forks are put down when "forks" goes out of scope
+    }
+}
+
+// Part 2
+constexpr std::size_t nresources = 4'000;
+constexpr std::size_t nclients = 1'000;
+constexpr int rounds = 20;
+
+// One counter per resource. Only modified while the resource is held.
+std::vector<long> uses(nresources);
+
+// The number of uses the clients made, which the counters should add up to
+std::atomic<long> expected_uses{0};
+
+void client(ResourceArbiter &arbiter, std::size_t client_no) {
+    std::mt19937 mt(client_no);
+    std::uniform_int_distribution<std::size_t> resource(0, nresources - 1);
+    std::uniform_int_distribution<int> set_size(2, 8);
+
+    for (int i = 0; i < rounds; ++i) {
+        std::vector<std::size_t> wanted(set_size(mt));
+        for (auto &id : wanted)
+            id = resource(mt);
+
+        ResourceArbiter::Lease lease(arbiter, client_no, wanted);
+
+        // Read-modify-write without any extra locking. Duplicates in "wanted" are only held
+        // once, so only count each resource once.
+        std::sort(wanted.begin(), wanted.end());
+        wanted.erase(std::unique(wanted.begin(), wanted.end()), wanted.end());
+        for (auto id : wanted) {
+            long value = uses[id];
+            std::this_thread::yield();
+            uses[id] = value + 1;
+        }
+        expected_uses += static_cast<long>(wanted.size());
+    }
+}
+
+void stress(Arbitration mode, const char *label) {
+    ResourceArbiter arbiter(nresources, nclients, mode);
+    std::fill(uses.begin(), uses.end(), 0);
+    expected_uses = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> clients;
+    for (std::size_t i = 0; i < nclients; ++i)
+        clients.push_back(std::thread{client, std::ref(arbiter), i});
+    for (auto &thr : clients)
+        thr.join();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    // Summarize the per-client metrics
+    long acquisitions = 0;
+    std::chrono::nanoseconds total_wait{0}, worst_mean{0}, worst_max{0};
+    for (std::size_t i = 0; i < nclients; ++i) {
+        const ClientStats &stats = arbiter.stats(i);
+        acquisitions += stats.acquisitions;
+        total_wait += stats.total_wait;
+        worst_mean = std::max(worst_mean, stats.mean_wait());
+        worst_max = std::max(worst_max, stats.max_wait);
+    }
+
+    long total_uses = 0;
+    for (auto n : uses)
+        total_uses += n;
+
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    using std::chrono::milliseconds;
+    std::cout << label << ":\n";
+    std::cout << "  " << acquisitions << " acquisitions in "
+              << duration_cast<milliseconds>(elapsed).count() << " ms\n";
+    std::cout << "  mean wait " << duration_cast<microseconds>(total_wait / acquisitions).count()
+              << " us, worst client's mean wait "
+              << duration_cast<microseconds>(worst_mean).count() << " us, longest wait "
+              << duration_cast<microseconds>(worst_max).count() << " us\n";
+    std::cout << "  resource uses counted: " << total_uses << " of " << expected_uses << ' '
+              << (total_uses == expected_uses ? "OK" : "WRONG") << '\n';
+}
+
+// g++ -std=c++20 -Wall -Wextra -pedantic -pthread -O2 main.cpp resource_arbiter.cpp && ./a.out
+int main() {
+    ResourceArbiter table(nforks, nphilosophers, Arbitration::fair);
+
+    std::vector<std::thread> philos;
+    for (int i = 0; i < nphilosophers; ++i)
+        philos.push_back(std::thread{dine, std::ref(table), i});
+    for (auto &philo : philos)
+        philo.join();
+
+    for (int i = 0; i < nphilosophers; ++i) {
+        std::cout << "Philosopher " << names[i] << " had " << mouthfuls[i] << " mouthful(s), ";
+        std::cout << "longest wait for forks "
+                  << std::chrono::duration_cast<std::chrono::microseconds>(table.stats(i).max_wait)
+                         .count()
+                  << " us\n";
+    }
+
+    std::cout << "--------------------------------\n";
+
+    stress(Arbitration::ordered, "Ordered acquisition");
+    stress(Arbitration::fair, "Fair (FIFO) acquisition");
+}
@@ -0,0 +1,114 @@
+/**
+ * Resource arbiter implementation
+ */
+
+#include "resource_arbiter.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+ResourceArbiter::ResourceArbiter(std::size_t resources, std::size_t clients, Arbitration mode)
+    : mode(mode), table(std::make_unique<Resource[]>(resources)), resource_count(resources),
+      client_stats(std::make_unique<PaddedStats[]>(clients)), client_count(clients) {}
+
+ResourceArbiter::Lease::Lease(ResourceArbiter &arbiter, std::size_t client,
+                              std::vector<std::size_t> ids)
+    : arbiter(arbiter), ids(std::move(ids)) {
+    if (client >= arbiter.client_count)
+        throw std::out_of_range("ResourceArbiter: no such client");
+
+    // Sorting gives every client the same global order, which is what prevents deadlock.
+    // Duplicates would make a client wait for itself.
+    std::sort(this->ids.begin(), this->ids.end());
+    this->ids.erase(std::unique(this->ids.begin(), this->ids.end()), this->ids.end());
+
+    if (!this->ids.empty() && this->ids.back() >= arbiter.resource_count)
+        throw std::out_of_range("ResourceArbiter: no such resource");
+
+    auto start = std::chrono::steady_clock::now();
+
+    if (arbiter.mode == Arbitration::ordered)
+        acquire_ordered();
+    else
+        acquire_fair();
+
+    auto waited = std::chrono::steady_clock::now() - start;
+    ClientStats &stats = arbiter.client_stats[client].stats;
+    ++stats.acquisitions;
+    stats.total_wait += waited;
+    stats.max_wait = std::max<std::chrono::nanoseconds>(stats.max_wait, waited);
+}
+
+ResourceArbiter::Lease::~Lease() {
+    if (arbiter.mode == Arbitration::ordered)
+        release_ordered();
+    else
+        release_fair();
+}
+
+void ResourceArbiter::Lease::acquire_ordered() {
+    // Lock in increasing order. If a lock throws, release the ones we already hold.
+    std::size_t locked = 0;
+    try {
+        for (; locked < ids.size(); ++locked)
+            arbiter.table[ids[locked]].mut.lock();
+    } catch (...) {
+        while (locked > 0)
+            arbiter.table[ids[--locked]].mut.unlock();
+        throw;
+    }
+}
+
+void ResourceArbiter::Lease::release_ordered() {
+    for (auto it = ids.rbegin(); it != ids.rend(); ++it)
+        arbiter.table[*it].mut.unlock();
+}
+
+void ResourceArbiter::Lease::acquire_fair() {
+    pending = ids.size();
+
+    // Join the queues of all our resources in one step. The queue mutexes are locked in increasing
+    // order, so this cannot deadlock. Two requests which share a resource both need that
+    // resource's mutex, so one of them joins all its queues before the other: they are in the same
+    // order in every queue they share, and there is no cycle of requests waiting for each other.
+    std::vector<std::unique_lock<std::mutex>> locks;
+    locks.reserve(ids.size());
+    for (auto id : ids)
+        locks.emplace_back(arbiter.table[id].mut);
+
+    std::size_t at_front = 0;
+    for (auto id : ids) {
+        auto &waiting = arbiter.table[id].waiting;
+        waiting.push_back(this);
+        if (waiting.size() == 1)
+            ++at_front;
+    }
+    pending -= at_front;
+
+    // Unlock in reverse order
+    while (!locks.empty())
+        locks.pop_back();
+
+    // Sleep until we are at the front of every queue
+    for (auto left = pending.load(); left != 0; left = pending.load())
+        pending.wait(left);
+}
+
+void ResourceArbiter::Lease::release_fair() {
+    for (auto id : ids) {
+        Resource &res = arbiter.table[id];
+        std::lock_guard<std::mutex> lck_guard(res.mut);
+
+        // We are at the front of the queue, because we hold the resource
+        res.waiting.pop_front();
+
+        if (!res.waiting.empty()) {
+            // The next request now has this resource. Wake it up if it has all of them.
+            // We still hold res.mut, and the other client must lock it to release its lease, so
+            // the Lease object cannot be destroyed before we have finished notifying it.
+            Lease *next = res.waiting.front();
+            if (next->pending.fetch_sub(1) == 1)
+                next->pending.notify_one();
+        }
+    }
+}
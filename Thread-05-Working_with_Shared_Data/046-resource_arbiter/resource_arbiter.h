@@ -0,0 +1,124 @@
+/**
+ * Resource arbiter
+ *
+ * A generalization of the dining philosophers problem:
+ * - There are many resources (forks) and many clients (philosophers).
+ * - A client may need ANY set of resources, not just its two neighbouring forks.
+ * - A client holds all the resources in its set, or none of them.
+ *
+ * The arbiter offers two modes:
+ *
+ * 1. Arbitration::ordered
+ *    Every resource has a mutex, and a client locks the mutexes in increasing resource number.
+ *    This is the idea behind std::lock() and std::scoped_lock, but works for a set of resources
+ *    which is only known at runtime. Since every client locks in the same global order, no cycle of
+ *    waiting clients can form and there is no deadlock. It is the fastest mode, but a std::mutex is
+ *    not fair, so an unlucky client can be overtaken again and again (starvation).
+ *
+ * 2. Arbitration::fair
+ *    Every resource has a FIFO queue of waiting requests. A request is added to the queues of all
+ *    its resources in one step, and is granted when it reaches the front of every one of them. As
+ *    in the Chandy-Misra solution, where a fork that has just been used is given to the neighbour
+ *    who is waiting for it, a client which has been waiting longer always has priority over a later
+ *    client that wants the same resource:
+ *    - No deadlock: the oldest waiting request is at the front of all its queues.
+ *    - No starvation: a request is only ever overtaken by requests which do not conflict with it.
+ *    Each queue has its own mutex, and the mutexes are only held while a request is added or
+ *    removed, so clients which use different resources never contend with each other.
+ *
+ * The arbiter measures how long each client waits for its resources.
+ */
+
+#ifndef RESOURCE_ARBITER_H
+#define RESOURCE_ARBITER_H
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+enum class Arbitration { ordered, fair };
+
+// Wait-time metrics for one client
+struct ClientStats {
+    std::size_t acquisitions{0};
+    std::chrono::nanoseconds total_wait{0};
+    std::chrono::nanoseconds max_wait{0};
+
+    std::chrono::nanoseconds mean_wait() const {
+        if (acquisitions == 0)
+            return std::chrono::nanoseconds{0};
+        return total_wait / static_cast<long>(acquisitions);
+    }
+};
+
+class ResourceArbiter {
+  public:
+    class Lease;
+
+  private:
+    // Padded to a cache line, so that clients using neighbouring resources do not slow each
+    // other down through false sharing
+    struct alignas(64) Resource {
+        std::mutex mut;
+        std::deque<Lease *> waiting; // Arbitration::fair only. The front is the current holder
+    };
+
+    // Each client only writes its own stats, so they need no lock. Padded like Resource.
+    struct alignas(64) PaddedStats {
+        ClientStats stats;
+    };
+
+    Arbitration mode;
+    std::unique_ptr<Resource[]> table;
+    std::size_t resource_count;
+    std::unique_ptr<PaddedStats[]> client_stats;
+    std::size_t client_count;
+
+  public:
+    ResourceArbiter(std::size_t resources, std::size_t clients,
+                    Arbitration mode = Arbitration::fair);
+
+    ResourceArbiter(const ResourceArbiter &) = delete;
+    ResourceArbiter &operator=(const ResourceArbiter &) = delete;
+
+    std::size_t resources() const { return resource_count; }
+    std::size_t clients() const { return client_count; }
+
+    // Read a client's metrics. Only call this while the client is not acquiring resources.
+    const ClientStats &stats(std::size_t client) const { return client_stats[client].stats; }
+
+    /**
+     * RAII object which holds a set of resources, like std::scoped_lock holds a set of mutexes.
+     * The constructor blocks until the client holds all the resources. The destructor releases them.
+     * A Lease can be neither copied nor moved, because waiting clients refer to it by address.
+     */
+    class Lease {
+        ResourceArbiter &arbiter;
+
+        // The resource numbers, sorted and without duplicates
+        std::vector<std::size_t> ids;
+
+        // Arbitration::fair only. The number of queues in which this request is not yet at the
+        // front. The request is granted when it reaches zero.
+        std::atomic<std::size_t> pending{0};
+
+        void acquire_ordered();
+        void acquire_fair();
+        void release_ordered();
+        void release_fair();
+
+        friend class ResourceArbiter;
+
+      public:
+        Lease(ResourceArbiter &arbiter, std::size_t client, std::vector<std::size_t> ids);
+        ~Lease();
+
+        Lease(const Lease &) = delete;
+        Lease &operator=(const Lease &) = delete;
+    };
+};
+
+#endif // RESOURCE_ARBITER_H
@@ -0,0 +1,121 @@
+/**
+ * Sharded counters compared with a mutex and a single atomic
+ *
+ * Every thread increments a shared request counter many times, as in
+ * 055-integer_operations_and_threads.cpp. All three versions give the correct total, but they
+ * take very different times once several cores are incrementing at the same time.
+ *
+ * The second part records simulated request latencies into sharded min/max and histogram
+ * accumulators, and prints a snapshot.
+ */
+
+#include "sharded_counter.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+constexpr int increments = 10'000'000;
+
+// Time how long "nthreads" threads take to call "func" "increments" times each
+template <typename Func> double time_threads(int nthreads, Func func) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nthreads; ++i) {
+        threads.push_back(std::thread([&func]() {
+            for (int j = 0; j < increments; ++j)
+                func();
+        }));
+    }
+    for (auto &thr : threads)
+        thr.join();
+
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+void compare_counters(int nthreads) {
+    // A mutex protects a plain int
+    std::mutex mut;
+    long mutex_counter = 0;
+    double mutex_ms = time_threads(nthreads, [&]() {
+        std::lock_guard<std::mutex> lck_guard(mut);
+        ++mutex_counter;
+    });
+
+    // One atomic, so one cache line, shared by all the threads
+    std::atomic<long> atomic_counter{0};
+    double atomic_ms = time_threads(nthreads, [&]() { ++atomic_counter; });
+
+    // One padded slot per thread
+    ShardedCounter sharded_counter;
+    double sharded_ms = time_threads(nthreads, [&]() { ++sharded_counter; });
+
+    std::cout << std::setw(8) << nthreads << std::fixed << std::setprecision(1) << std::setw(12)
+              << mutex_ms << std::setw(12) << atomic_ms << std::setw(12) << sharded_ms
+              << "    totals " << mutex_counter << ", " << atomic_counter << ", "
+              << sharded_counter.value() << '\n';
+}
+
+void record_latencies(int nthreads) {
+    ShardedCounter requests;
+    ShardedMinMax<double> extremes;
+    ShardedHistogram<double> latencies({0.1, 0.2, 0.5, 1.0, 2.0, 5.0, 10.0});
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nthreads; ++i) {
+        threads.push_back(std::thread([&, i]() {
+            // Simulated latencies in milliseconds, with a long tail
+            std::mt19937 mt(i);
+            std::lognormal_distribution<double> dist(-1.0, 1.0);
+
+            for (int j = 0; j < 100'000; ++j) {
+                double latency = dist(mt);
+                ++requests;
+                extremes.record(latency);
+                latencies.record(latency);
+            }
+        }));
+    }
+    for (auto &thr : threads)
+        thr.join();
+
+    auto minmax = extremes.snapshot();
+    auto snap = latencies.snapshot();
+
+    std::cout << std::setprecision(3);
+    std::cout << "Requests: " << requests.value() << '\n';
+    std::cout << "Latency min " << minmax.min << " ms, max " << minmax.max << " ms, mean "
+              << snap.mean() << " ms, p50 < " << snap.percentile(0.5) << " ms, p99 < "
+              << snap.percentile(0.99) << " ms\n";
+    std::cout << "Histogram:\n";
+    for (std::size_t b = 0; b < snap.buckets.size(); ++b) {
+        std::cout << "  ";
+        if (b < snap.bounds.size())
+            std::cout << "< " << std::setw(5) << snap.bounds[b] << " ms: ";
+        else
+            std::cout << ">= " << std::setw(4) << snap.bounds.back() << " ms: ";
+        std::cout << snap.buckets[b] << '\n';
+    }
+}
+
+// g++ -std=c++20 -Wall -Wextra -pedantic -pthread -O2 main.cpp && ./a.out
+int main() {
+    std::cout << "Time (ms) for each thread to increment the counter " << increments
+              << " times\n";
+    std::cout << std::setw(8) << "threads" << std::setw(12) << "mutex" << std::setw(12) << "atomic"
+              << std::setw(12) << "sharded" << '\n';
+
+    int max_threads = std::max(4u, std::thread::hardware_concurrency());
+    for (int nthreads = 1; nthreads <= max_threads; nthreads *= 2)
+        compare_counters(nthreads);
+
+    std::cout << "--------------------------------\n";
+
+    record_latencies(4);
+}
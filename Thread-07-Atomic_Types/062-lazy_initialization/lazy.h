@@ -0,0 +1,83 @@
+/**
+ * lazy<T>: thread-safe lazy initialization without a memory leak
+ *
+ * `038-double_checked_locking.cpp` and `060-lock_free_programming.cpp` lazily create an object with
+ * `new` and never delete it. lazy<T> keeps the object inside itself instead:
+ * - The storage is a suitably aligned byte array. There is no heap allocation, and the object is
+ *   destroyed when the lazy<T> is destroyed.
+ * - Fast path: once the object exists, get() is a single atomic load with acquire ordering and a
+ *   branch. No lock, no read-modify-write, so the cache line stays shared by all the cores.
+ * - Slow path: the first callers lock a mutex, check again and construct the object. The store
+ *   with release ordering "publishes" the fully constructed object to the acquire loads.
+ * - If the constructor throws, the object is not marked as ready and the exception propagates to
+ *   the caller. The next call to get() tries again, like std::call_once.
+ *
+ * This is the double-checked locking pattern of 060-lock_free_programming.cpp, with the
+ * memory ordering made explicit and the object stored in place.
+ */
+
+#ifndef LAZY_H
+#define LAZY_H
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <utility>
+
+template <class T> class lazy {
+    // Raw storage for the object. It is only a T after "ready" has been set.
+    alignas(T) unsigned char storage[sizeof(T)];
+
+    // Set (with release ordering) after the object has been constructed
+    std::atomic<bool> ready{false};
+
+    // Serializes the threads which find the object is not ready yet
+    std::mutex mut;
+
+    T *object() { return std::launder(reinterpret_cast<T *>(storage)); }
+
+    // Kept out of line, so that the fast path in get() is small enough to be inlined everywhere
+    template <class Func> [[gnu::noinline]] T &initialize(Func &&make) {
+        std::lock_guard<std::mutex> lck_guard(mut);
+
+        // Another thread may have initialized the object while we were waiting for the lock.
+        // The mutex gives us all the synchronization we need, so this load can be relaxed.
+        if (!ready.load(std::memory_order_relaxed)) {
+            // If make() or the constructor throws, "ready" is still false and the lock is
+            // released, so a later call will try again
+            ::new (static_cast<void *>(storage)) T(std::invoke(std::forward<Func>(make)));
+            ready.store(true, std::memory_order_release);
+        }
+        return *object();
+    }
+
+  public:
+    lazy() = default;
+
+    ~lazy() {
+        if (ready.load(std::memory_order_relaxed))
+            object()->~T();
+    }
+
+    // The object is shared by address. Copying or moving the lazy<T> would not be thread-safe.
+    lazy(const lazy &) = delete;
+    lazy &operator=(const lazy &) = delete;
+
+    // Returns the object, calling make() to create it if this is the first call.
+    // make() must return a T (or something a T can be constructed from).
+    template <class Func> T &get(Func &&make) {
+        if (ready.load(std::memory_order_acquire))
+            return *object();
+        return initialize(std::forward<Func>(make));
+    }
+
+    // Returns the object, default-constructing it if this is the first call
+    T &get() {
+        return get([]() { return T(); });
+    }
+
+    bool initialized() const { return ready.load(std::memory_order_acquire); }
+};
+
+#endif // LAZY_H
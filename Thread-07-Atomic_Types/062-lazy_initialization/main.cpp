@@ -0,0 +1,179 @@
+/**
+ * Benchmark of thread-safe lazy initialization
+ *
+ * We compare four ways to lazily create a shared object (see 038-double_checked_locking.cpp):
+ * 1. lazy<T>: acquire load on the fast path, object stored in place
+ * 2. std::call_once() with a std::once_flag, object stored in a std::unique_ptr
+ * 3. Function-local static variable (Meyers singleton, see 035-shared_data_initialization)
+ * 4. Naive: lock a mutex on every access
+ *
+ * Two measurements:
+ * - "Cold": all the threads are released at the same moment and race to be the first to use a
+ *   brand-new object, then keep using it. This is the "heavy concurrent first access" case.
+ *   Every trial needs a fresh object. For the function-local static, we get a fresh object by
+ *   instantiating a function template once per trial.
+ * - "Hot": the object already exists, and every thread uses it over and over. This is what the
+ *   program does for the rest of its life, so the fast path matters most. The time is wall-clock
+ *   time divided by the accesses made by each thread, so it grows once there are more threads than
+ *   cores.
+ */
+
+#include "lazy.h"
+
+#include <atomic>
+#include <barrier>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// The lazily-initialized object. Its constructor does a little work.
+class Test {
+    int data[16];
+
+  public:
+    Test() {
+        for (int i = 0; i < 16; ++i)
+            data[i] = i;
+    }
+    int func() const { return data[7]; }
+};
+
+// The thread counts to measure
+constexpr int thread_counts[] = {1, 2, 4, 8, 16};
+constexpr int nlevels = std::size(thread_counts);
+
+// Each thread count runs "trials" trials, and every trial needs a fresh object
+constexpr int trials = 32;
+constexpr int nobjects = nlevels * trials;
+
+constexpr int cold_accesses = 10'000;
+constexpr int hot_accesses = 2'000'000;
+
+// 1. lazy<T>
+lazy<Test> lazy_tests[nobjects];
+const Test &get_lazy(int trial) { return lazy_tests[trial].get(); }
+
+// 2. std::call_once()
+std::once_flag once_flags[nobjects];
+std::unique_ptr<Test> once_tests[nobjects];
+const Test &get_call_once(int trial) {
+    std::call_once(once_flags[trial], [trial]() { once_tests[trial] = std::make_unique<Test>(); });
+    return *once_tests[trial];
+}
+
+// 3. Function-local static. Each instantiation of get_static<I> has its own static variable.
+template <int I> const Test &get_static() {
+    static Test test;
+    return test;
+}
+template <int... I> auto make_static_table(std::integer_sequence<int, I...>) {
+    return std::vector<const Test &(*)()>{&get_static<I>...};
+}
+const auto static_table = make_static_table(std::make_integer_sequence<int, nobjects>{});
+const Test &get_static_local(int trial) { return static_table[trial](); }
+
+// 4. Mutex locked on every access
+std::mutex mutexes[nobjects];
+std::unique_ptr<Test> mutex_tests[nobjects];
+const Test &get_mutex(int trial) {
+    std::lock_guard<std::mutex> lck_guard(mutexes[trial]);
+    if (!mutex_tests[trial])
+        mutex_tests[trial] = std::make_unique<Test>();
+    return *mutex_tests[trial];
+}
+
+// Prevents the compiler from removing the accesses
+std::atomic<long> sink{0};
+
+// Average time for "nthreads" threads to make "accesses" accesses each, starting together
+template <typename Getter>
+double run(Getter get, int nthreads, int accesses, int first_trial, int ntrials) {
+    double total_ns = 0.0;
+    for (int trial = first_trial; trial < first_trial + ntrials; ++trial) {
+        std::chrono::steady_clock::time_point start;
+        std::barrier sync(nthreads + 1, []() noexcept {});
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < nthreads; ++t) {
+            threads.push_back(std::thread([&, trial]() {
+                sync.arrive_and_wait(); // Start line
+                long sum = 0;
+                for (int i = 0; i < accesses; ++i)
+                    sum += get(trial).func();
+                sink += sum;
+                sync.arrive_and_wait(); // Finish line
+            }));
+        }
+
+        sync.arrive_and_wait();
+        start = std::chrono::steady_clock::now();
+        sync.arrive_and_wait();
+        total_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() -
+                                                             start)
+                        .count();
+
+        for (auto &thr : threads)
+            thr.join();
+    }
+    return total_ns / ntrials;
+}
+
+template <typename Getter> void benchmark(const char *name, Getter get, int level) {
+    int nthreads = thread_counts[level];
+    int first = level * trials;
+
+    // Cold: a fresh object for each trial, except the last one which is kept for the hot run
+    double cold_ns = run(get, nthreads, cold_accesses, first, trials - 1);
+
+    // Hot: the object is created before the clock starts
+    int last = first + trials - 1;
+    get(last);
+    double hot_ns = run(get, nthreads, hot_accesses, last, 1);
+
+    std::cout << std::setw(16) << name << std::setw(10) << nthreads << std::setw(14) << std::fixed
+              << std::setprecision(1) << cold_ns / 1000.0 << std::setw(18) << std::setprecision(2)
+              << hot_ns / hot_accesses << '\n';
+}
+
+// Exception-safe retry: the first attempt to create the object fails
+void retry_demo() {
+    lazy<Test> lazy_test;
+    int attempts = 0;
+    auto make = [&attempts]() {
+        if (++attempts == 1)
+            throw std::runtime_error("first attempt failed");
+        return Test();
+    };
+
+    try {
+        lazy_test.get(make);
+    } catch (const std::exception &e) {
+        std::cout << "Caught \"" << e.what() << "\", initialized: " << std::boolalpha
+                  << lazy_test.initialized() << '\n';
+    }
+    lazy_test.get(make);
+    std::cout << "Second attempt, initialized: " << lazy_test.initialized()
+              << ", attempts: " << attempts << '\n';
+}
+
+// g++ -std=c++20 -Wall -Wextra -pedantic -pthread -O2 main.cpp && ./a.out
+int main() {
+    retry_demo();
+    std::cout << "--------------------------------\n";
+
+    std::cout << std::setw(16) << "method" << std::setw(10) << "threads" << std::setw(14)
+              << "cold (us)" << std::setw(18) << "hot (ns/access)" << '\n';
+
+    for (int level = 0; level < nlevels; ++level) {
+        benchmark("lazy<T>", get_lazy, level);
+        benchmark("std::call_once", get_call_once, level);
+        benchmark("local static", get_static_local, level);
+        benchmark("mutex", get_mutex, level);
+    }
+}
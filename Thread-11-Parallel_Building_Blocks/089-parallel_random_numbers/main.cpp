@@ -0,0 +1,190 @@
+/**
+ * Test program for the parallel random number service
+ *
+ * 1. Philox4x32-10 gives the known answers from the Random123 library's test vectors.
+ * 2. Each thread's local() engine gives different numbers (compare 036-thread_local_variables.cpp).
+ * 3. A Monte Carlo estimate of pi, split into tasks which each use stream(task number). The
+ *    result is identical, to the last bit, with 1, 2, 4 or 8 threads.
+ * 4. Throughput of bulk generation compared with the standard library engines.
+ */
+
+#include "parallel_rng.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+// 1. Known-answer test: counter, key and output, from kat_vectors in Random123
+struct known_answer {
+    std::uint32_t ctr[4];
+    std::uint32_t key[2];
+    std::uint32_t out[4];
+};
+
+constexpr known_answer known_answers[] = {
+    {{0x00000000, 0x00000000, 0x00000000, 0x00000000},
+     {0x00000000, 0x00000000},
+     {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}},
+    {{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+     {0xffffffff, 0xffffffff},
+     {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}},
+    {{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344},
+     {0xa4093822, 0x299f31d0},
+     {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}},
+};
+
+bool check_known_answers() {
+    bool correct = true;
+    for (const known_answer &test : known_answers) {
+        std::uint32_t out[4];
+        Philox4x32::generate(test.ctr, test.key, out);
+        correct = correct && std::equal(out, out + 4, test.out);
+    }
+    return correct;
+}
+
+// 2. Each thread's engine is different
+void print_local(ParallelRng &rng) {
+    std::uniform_real_distribution<double> dist(0, 1);
+    Philox4x32 &engine = rng.local();
+    for (int i = 0; i < 5; ++i)
+        std::cout << dist(engine) << ", ";
+}
+
+// 3. Monte Carlo estimate of pi
+constexpr int ntasks = 64;
+constexpr std::size_t batch = 4096;
+constexpr std::size_t batches_per_task = 256;
+constexpr std::size_t samples_per_task = batch * batches_per_task;
+
+// Throw darts at the unit square and count how many land inside the quarter circle
+long count_hits(const ParallelRng &rng, int task) {
+    // The stream belongs to the task, not to the thread which happens to run it
+    Philox4x32 engine = rng.stream(task);
+
+    std::vector<double> xy(2 * batch);
+    long hits = 0;
+
+    for (std::size_t b = 0; b < batches_per_task; ++b) {
+        engine.fill_uniform(xy.data(), xy.size());
+        for (std::size_t i = 0; i < batch; ++i) {
+            double x = xy[2 * i], y = xy[2 * i + 1];
+            hits += (x * x + y * y < 1.0);
+        }
+    }
+    return hits;
+}
+
+double estimate_pi(const ParallelRng &rng, int nthreads) {
+    std::vector<long> hits(ntasks);
+    std::vector<std::thread> threads;
+
+    // Thread t runs tasks t, t + nthreads, t + 2 * nthreads, ...
+    for (int t = 0; t < nthreads; ++t) {
+        threads.push_back(std::thread([&, t]() {
+            for (int task = t; task < ntasks; task += nthreads)
+                hits[task] = count_hits(rng, task);
+        }));
+    }
+    for (auto &thr : threads)
+        thr.join();
+
+    // Combine in task order, so the result does not depend on which thread finished first
+    long total = 0;
+    for (auto h : hits)
+        total += h;
+    return 4.0 * total / (static_cast<double>(ntasks) * samples_per_task);
+}
+
+// 4. Throughput
+constexpr std::size_t nvalues = 32 * 1024 * 1024;
+
+template <typename Func> void report(const char *name, std::vector<double> &out, Func fill) {
+    auto start = std::chrono::steady_clock::now();
+    fill(out.data(), out.size());
+    double secs =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Print one value, so the compiler cannot remove the work
+    std::cout << std::setw(45) << name << std::setw(10) << std::setprecision(3)
+              << out.size() * sizeof(double) / secs / 1e9 << " GB/s   (" << out[out.size() / 2]
+              << ")\n";
+}
+
+// g++ -std=c++20 -Wall -Wextra -pedantic -pthread -O3 -march=native main.cpp && ./a.out
+int main() {
+    std::cout << "Philox4x32-10 known-answer test: " << (check_known_answers() ? "ok" : "WRONG")
+              << '\n';
+
+    std::cout << "--------------------------------\n";
+
+    ParallelRng rng(2024);
+
+    for (int i = 0; i < 2; ++i) {
+        std::cout << "Thread " << i + 1 << "'s random values:\n";
+        std::thread thr(print_local, std::ref(rng));
+        thr.join();
+        std::cout << '\n';
+    }
+
+    std::cout << "--------------------------------\n";
+
+    for (int nthreads = 1; nthreads <= 8; nthreads *= 2) {
+        std::cout << nthreads << " thread(s): pi is about " << std::setprecision(17)
+                  << estimate_pi(rng, nthreads) << '\n';
+    }
+
+    std::cout << "--------------------------------\n";
+
+    std::vector<double> out(nvalues);
+
+    report("std::mt19937 + uniform_real_distribution", out, [](double *p, std::size_t n) {
+        std::mt19937 mt;
+        std::uniform_real_distribution<double> dist(0, 1);
+        for (std::size_t i = 0; i < n; ++i)
+            p[i] = dist(mt);
+    });
+    report("std::mt19937_64 + uniform_real_distribution", out, [](double *p, std::size_t n) {
+        std::mt19937_64 mt;
+        std::uniform_real_distribution<double> dist(0, 1);
+        for (std::size_t i = 0; i < n; ++i)
+            p[i] = dist(mt);
+    });
+    report("Philox4x32 + uniform_real_distribution", out, [&rng](double *p, std::size_t n) {
+        Philox4x32 engine = rng.stream(0);
+        std::uniform_real_distribution<double> dist(0, 1);
+        for (std::size_t i = 0; i < n; ++i)
+            p[i] = dist(engine);
+    });
+    report("Philox4x32::fill_uniform", out,
+           [&rng](double *p, std::size_t n) { rng.stream(0).fill_uniform(p, n); });
+
+    report("std::mt19937_64 + normal_distribution", out, [](double *p, std::size_t n) {
+        std::mt19937_64 mt;
+        std::normal_distribution<double> dist(0, 1);
+        for (std::size_t i = 0; i < n; ++i)
+            p[i] = dist(mt);
+    });
+    report("Philox4x32::fill_normal", out,
+           [&rng](double *p, std::size_t n) { rng.stream(0).fill_normal(p, n); });
+
+    // Bulk fills parallelize with no coordination: each thread fills its own part of the output
+    // from its own stream
+    unsigned nthreads = std::max(1u, std::thread::hardware_concurrency());
+    report("Philox4x32::fill_uniform, all cores", out, [&rng, nthreads](double *p, std::size_t n) {
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < nthreads; ++t) {
+            threads.push_back(std::thread([&rng, p, n, t, nthreads]() {
+                std::size_t begin = n * t / nthreads, end = n * (t + 1) / nthreads;
+                rng.stream(t).fill_uniform(p + begin, end - begin);
+            }));
+        }
+        for (auto &thr : threads)
+            thr.join();
+    });
+}
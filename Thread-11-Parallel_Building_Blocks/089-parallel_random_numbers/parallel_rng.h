@@ -0,0 +1,70 @@
+/**
+ * Random number service for parallel programs
+ *
+ * `036-thread_local_variables.cpp` shows the two usual mistakes:
+ * - A thread_local std::mt19937 is default-seeded, so every thread gets the SAME sequence.
+ * - A global engine is shared state, so it needs a lock and the threads take turns.
+ *
+ * ParallelRng hands out Philox streams instead. All streams come from one seed and are
+ * statistically independent, so no two workers ever see the same numbers.
+ *
+ * There are two ways to get a stream:
+ * - stream(id): the caller chooses the stream number. Number the streams after the units of WORK
+ *   (task 0, task 1, ...), not after the threads, and the results are bit-for-bit reproducible
+ *   whatever the number of threads and whichever thread runs which task.
+ * - local(): a thread_local engine for the calling thread, with the next unused stream number.
+ *   Each thread gets different numbers, but which thread gets which stream depends on timing.
+ *   A thread caches one engine: if it alternates between two ParallelRng objects, it is given a
+ *   fresh stream each time it switches.
+ */
+
+#ifndef PARALLEL_RNG_H
+#define PARALLEL_RNG_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "philox.h"
+
+class ParallelRng {
+    std::uint64_t seed;
+
+    // Streams handed out by local() count down from the top, so they do not collide with the small
+    // stream numbers which callers pass to stream()
+    std::atomic<std::uint64_t> next_local{UINT64_MAX};
+
+    // Identifies this object in the thread_local cache of local()
+    std::uint64_t serial;
+
+    static std::uint64_t next_serial() {
+        static std::atomic<std::uint64_t> counter{0};
+        return ++counter;
+    }
+
+  public:
+    explicit ParallelRng(std::uint64_t seed) : seed(seed), serial(next_serial()) {}
+
+    ParallelRng(const ParallelRng &) = delete;
+    ParallelRng &operator=(const ParallelRng &) = delete;
+
+    // Reproducible stream number "id"
+    Philox4x32 stream(std::uint64_t id) const { return Philox4x32(seed, id); }
+
+    // The calling thread's own engine
+    Philox4x32 &local() {
+        struct Cache {
+            std::uint64_t owner{0};
+            Philox4x32 engine;
+        };
+        thread_local Cache cache;
+
+        // First call in this thread, or the thread last used a different ParallelRng
+        if (cache.owner != serial) {
+            cache.owner = serial;
+            cache.engine = stream(next_local.fetch_sub(1, std::memory_order_relaxed));
+        }
+        return cache.engine;
+    }
+};
+
+#endif // PARALLEL_RNG_H
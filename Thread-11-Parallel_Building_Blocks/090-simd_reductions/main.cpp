@@ -0,0 +1,182 @@
+/**
+ * Test program for the SIMD reduction kernels
+ *
+ * 1. Every instruction set gives the same results as the standard algorithms.
+ * 2. Accuracy of the summation methods.
+ * 3. Speed of each instruction set, on data which fits in the cache and on data which does not.
+ * 4. The 4-way parallel sum of 069-data_parallelism.cpp, with std::accumulate and with simd_sum().
+ */
+
+#include "simd_reduce.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <vector>
+
+static std::mt19937 mt;
+std::uniform_real_distribution<double> dist(0, 100);
+
+std::vector<Isa> supported_isas() {
+    std::vector<Isa> isas;
+    for (Isa isa : {Isa::scalar, Isa::sse2, Isa::avx2, Isa::avx512}) {
+        if (isa <= detect_isa())
+            isas.push_back(isa);
+    }
+    return isas;
+}
+
+// 1. Compare with the standard algorithms
+void check_results(const std::vector<double> &a, const std::vector<double> &b) {
+    std::size_t n = a.size();
+    double sum = std::accumulate(a.begin(), a.end(), 0.0);
+    double min = *std::min_element(a.begin(), a.end());
+    double max = *std::max_element(a.begin(), a.end());
+    double dot = std::inner_product(a.begin(), a.end(), b.begin(), 0.0);
+    double max_diff = std::transform_reduce(
+        a.begin(), a.end(), b.begin(), 0.0, [](auto x, auto y) { return std::max(x, y); },
+        [](auto x, auto y) { return std::abs(x - y); });
+
+    std::cout << std::setw(10) << "std" << std::setprecision(15) << std::setw(24) << sum
+              << std::setw(22) << min << std::setw(22) << max << std::setw(24) << dot
+              << std::setw(22) << max_diff << '\n';
+
+    for (Isa isa : supported_isas()) {
+        const ReductionKernels &k = reduction_kernels(isa);
+        std::cout << std::setw(10) << isa_name(isa) << std::setw(24) << k.sum(a.data(), n)
+                  << std::setw(22) << k.min(a.data(), n) << std::setw(22) << k.max(a.data(), n)
+                  << std::setw(24) << k.dot(a.data(), b.data(), n) << std::setw(22)
+                  << k.max_abs_diff(a.data(), b.data(), n) << '\n';
+    }
+}
+
+// 2. Add 0.1 ten million times. 0.1 has no exact binary representation, and each addition to a
+// large running total loses some of its low-order bits.
+void check_accuracy() {
+    std::vector<double> tenths(10'000'000, 0.1);
+    const double *p = tenths.data();
+    std::size_t n = tenths.size();
+
+    std::cout << std::setprecision(17);
+    std::cout << "Exact:           1000000\n";
+    std::cout << "std::accumulate: " << std::accumulate(p, p + n, 0.0) << '\n';
+    std::cout << "simd_sum:        " << simd_sum(p, n) << '\n';
+    std::cout << "pairwise_sum:    " << pairwise_sum(p, n) << '\n';
+    std::cout << "kahan_sum:       " << kahan_sum(p, n) << '\n';
+}
+
+// 3. Throughput in GB/s of the bytes read
+template <typename Func> double gb_per_sec(std::size_t bytes, int repeats, Func func) {
+    volatile double sink = 0.0; // So the compiler cannot remove the work
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; ++r)
+        sink = sink + func();
+    double secs =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return bytes * repeats / secs / 1e9;
+}
+
+void compare_speed(const char *title, std::size_t n, int repeats) {
+    std::vector<double> a(n), b(n);
+    std::generate(a.begin(), a.end(), []() { return dist(mt); });
+    std::generate(b.begin(), b.end(), []() { return dist(mt); });
+    const double *pa = a.data(), *pb = b.data();
+    std::size_t bytes = n * sizeof(double);
+
+    std::cout << title << ", GB/s\n";
+    std::cout << std::setw(16) << "" << std::setw(10) << "sum" << std::setw(10) << "min"
+              << std::setw(10) << "dot" << std::setw(10) << "max diff" << std::setw(10) << "kahan"
+              << '\n';
+    std::cout << std::setprecision(3);
+
+    std::cout << std::setw(16) << "std algorithms"
+              << std::setw(10)
+              << gb_per_sec(bytes, repeats, [&]() { return std::accumulate(pa, pa + n, 0.0); })
+              << std::setw(10)
+              << gb_per_sec(bytes, repeats, [&]() { return *std::min_element(pa, pa + n); })
+              << std::setw(10)
+              << gb_per_sec(2 * bytes, repeats,
+                            [&]() { return std::inner_product(pa, pa + n, pb, 0.0); })
+              << '\n';
+
+    for (Isa isa : supported_isas()) {
+        const ReductionKernels &k = reduction_kernels(isa);
+        std::cout << std::setw(16) << isa_name(isa) << std::setw(10)
+                  << gb_per_sec(bytes, repeats, [&]() { return k.sum(pa, n); }) << std::setw(10)
+                  << gb_per_sec(bytes, repeats, [&]() { return k.min(pa, n); }) << std::setw(10)
+                  << gb_per_sec(2 * bytes, repeats, [&]() { return k.dot(pa, pb, n); })
+                  << std::setw(10)
+                  << gb_per_sec(2 * bytes, repeats, [&]() { return k.max_abs_diff(pa, pb, n); })
+                  << std::setw(10)
+                  << gb_per_sec(bytes, repeats, [&]() { return k.kahan_sum(pa, n); }) << '\n';
+    }
+}
+
+// 4. The parallel sum from 069-data_parallelism.cpp, with the summation function as a parameter
+using SumFunc = std::function<double(const double *, std::size_t)>;
+
+double add_parallel(std::vector<double> &vec, SumFunc sum) {
+    double *vec0 = &vec[0];
+    auto vsize = vec.size();
+
+    auto fut1 = std::async(std::launch::async, sum, vec0, vsize / 4);
+    auto fut2 = std::async(std::launch::async, sum, vec0 + vsize / 4, vsize / 4);
+    auto fut3 = std::async(std::launch::async, sum, vec0 + 2 * vsize / 4, vsize / 4);
+    auto fut4 = std::async(std::launch::async, sum, vec0 + 3 * vsize / 4, vsize - 3 * vsize / 4);
+
+    return fut1.get() + fut2.get() + fut3.get() + fut4.get();
+}
+
+void compare_parallel() {
+    std::vector<double> vrand(16 * 1024 * 1024);
+    std::generate(vrand.begin(), vrand.end(), []() { return dist(mt); });
+    std::size_t bytes = vrand.size() * sizeof(double);
+
+    SumFunc accum = [](const double *p, std::size_t n) { return std::accumulate(p, p + n, 0.0); };
+    SumFunc simd = simd_sum;
+
+    std::cout << "4 tasks over " << bytes / (1024 * 1024) << " MB, GB/s\n";
+    std::cout << std::setprecision(3);
+    std::cout << "  std::accumulate: "
+              << gb_per_sec(bytes, 10, [&]() { return add_parallel(vrand, accum); }) << '\n';
+    std::cout << "  simd_sum:        "
+              << gb_per_sec(bytes, 10, [&]() { return add_parallel(vrand, simd); }) << '\n';
+}
+
+// g++ -std=c++20 -Wall -Wextra -pedantic -pthread -O2 main.cpp simd_reduce.cpp && ./a.out
+int main() {
+    std::cout << "Best instruction set on this CPU: " << isa_name(detect_isa()) << "\n\n";
+
+    // An odd size, so that every kernel has some leftover elements
+    std::vector<double> a(10'007), b(10'007);
+    std::generate(a.begin(), a.end(), []() { return dist(mt); });
+    std::generate(b.begin(), b.end(), []() { return dist(mt); });
+
+    std::cout << std::setw(10) << "" << std::setw(24) << "sum" << std::setw(22) << "min"
+              << std::setw(22) << "max" << std::setw(24) << "dot" << std::setw(22) << "max diff"
+              << '\n';
+    check_results(a, b);
+
+    // The vectors from 075-new_parallel_algorithms_practical.cpp
+    std::vector<double> expected{0.1, 0.2, 0.3, 0.4, 0.5};
+    std::vector<double> actual{0.09, 0.22, 0.27, 0.41, 0.52};
+    std::cout << "Max difference is: " << std::setprecision(6)
+              << simd_max_abs_diff(expected.data(), actual.data(), expected.size()) << "\n\n";
+
+    check_accuracy();
+    std::cout << '\n';
+
+    // 16K doubles in each array fit in the L1 and L2 caches
+    compare_speed("In cache (128 KB)", 16 * 1024, 20'000);
+    std::cout << '\n';
+    compare_speed("Out of cache (128 MB)", 16 * 1024 * 1024, 10);
+    std::cout << '\n';
+
+    compare_parallel();
+}
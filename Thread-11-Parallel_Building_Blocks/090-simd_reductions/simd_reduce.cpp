@@ -0,0 +1,356 @@
+/**
+ * SIMD reduction kernels
+ *
+ * Each reduction is written once, as a template on the number of doubles per register, using the
+ * GCC/Clang vector extensions: arithmetic on a vector type works lane by lane, and the compiler
+ * chooses the instructions. The template is then compiled for each instruction set inside a small
+ * function with a "target" attribute. These functions are always_inline'd into the target
+ * functions, so their code is generated with that function's instruction set.
+ */
+
+#include "simd_reduce.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace {
+
+// Number of independent register accumulators in each kernel
+constexpr int accumulators = 4;
+
+// W doubles in one register. With W == 1, just a double.
+template <int W> struct Simd {
+    typedef double type __attribute__((vector_size(W * sizeof(double))));
+};
+template <> struct Simd<1> {
+    using type = double;
+};
+template <int W> using Vec = typename Simd<W>::type;
+
+template <class V> [[gnu::always_inline]] inline void load(V &v, const double *p) {
+    std::memcpy(&v, p, sizeof(v)); // An unaligned load
+}
+
+// Each operation has an identity element, a step which folds the elements at index i into an
+// accumulator, and a function to combine two accumulators. "V" is a vector or a double.
+// Vectors are passed by reference: passing them by value to a function compiled without AVX would
+// use a different calling convention from one compiled with AVX, and GCC warns about it.
+struct Sum {
+    static constexpr double identity = 0.0;
+    template <class V>
+    [[gnu::always_inline]] static void step(V &acc, const double *a, const double *,
+                                            std::size_t i) {
+        V x;
+        load(x, a + i);
+        acc += x;
+    }
+    template <class V> [[gnu::always_inline]] static void combine(V &x, const V &y) { x += y; }
+};
+
+struct Min {
+    static constexpr double identity = std::numeric_limits<double>::infinity();
+    template <class V>
+    [[gnu::always_inline]] static void step(V &acc, const double *a, const double *,
+                                            std::size_t i) {
+        V x;
+        load(x, a + i);
+        combine(acc, x);
+    }
+    template <class V> [[gnu::always_inline]] static void combine(V &x, const V &y) {
+        x = y < x ? y : x;
+    }
+};
+
+struct Max {
+    static constexpr double identity = -std::numeric_limits<double>::infinity();
+    template <class V>
+    [[gnu::always_inline]] static void step(V &acc, const double *a, const double *,
+                                            std::size_t i) {
+        V x;
+        load(x, a + i);
+        combine(acc, x);
+    }
+    template <class V> [[gnu::always_inline]] static void combine(V &x, const V &y) {
+        x = y > x ? y : x;
+    }
+};
+
+struct Dot {
+    static constexpr double identity = 0.0;
+    template <class V>
+    [[gnu::always_inline]] static void step(V &acc, const double *a, const double *b,
+                                            std::size_t i) {
+        V x, y;
+        load(x, a + i);
+        load(y, b + i);
+        acc += x * y;
+    }
+    template <class V> [[gnu::always_inline]] static void combine(V &x, const V &y) { x += y; }
+};
+
+struct MaxAbsDiff {
+    static constexpr double identity = 0.0;
+    template <class V>
+    [[gnu::always_inline]] static void step(V &acc, const double *a, const double *b,
+                                            std::size_t i) {
+        V x, y;
+        load(x, a + i);
+        load(y, b + i);
+        V diff = x - y;
+        if constexpr (std::is_same_v<V, double>)
+            diff = std::fabs(diff); // The ternary below becomes a branch for scalars
+        else
+            diff = diff < 0 ? -diff : diff;
+        combine(acc, diff);
+    }
+    template <class V> [[gnu::always_inline]] static void combine(V &x, const V &y) {
+        x = y > x ? y : x;
+    }
+};
+
+// Combine the lanes of one register
+template <class Op, class V> [[gnu::always_inline]] inline double horizontal(const V &v) {
+    if constexpr (std::is_same_v<V, double>) {
+        return v;
+    } else {
+        double result = v[0];
+        for (std::size_t j = 1; j < sizeof(V) / sizeof(double); ++j)
+            Op::combine(result, double{v[j]});
+        return result;
+    }
+}
+
+// Reduce a[0..n), and b[0..n) for the operations with two inputs
+template <class Op, int W>
+[[gnu::always_inline]] inline double reduce(const double *a, const double *b, std::size_t n) {
+    using V = Vec<W>;
+
+    // Set every lane of every accumulator to the identity
+    V acc[accumulators];
+    for (auto &v : acc)
+        v = V{} + Op::identity;
+
+    // The main loop: "accumulators" registers at a time, which do not depend on each other
+    std::size_t i = 0;
+    for (; i + accumulators * W <= n; i += accumulators * W) {
+#pragma GCC unroll 8
+        for (int k = 0; k < accumulators; ++k)
+            Op::step(acc[k], a, b, i + k * W);
+    }
+
+    // Then one register at a time
+    for (; i + W <= n; i += W)
+        Op::step(acc[0], a, b, i);
+
+    for (int k = 1; k < accumulators; ++k)
+        Op::combine(acc[0], acc[k]);
+    double result = horizontal<Op>(acc[0]);
+
+    // Then the last few elements
+    for (; i < n; ++i)
+        Op::step(result, a, b, i);
+    return result;
+}
+
+// Kahan summation in every lane: "comp" holds the low-order bits which were lost when the last
+// element was added to "sum", and they are subtracted from the next element.
+// This only works if the compiler keeps the order of the operations, so never use -ffast-math.
+template <class V> [[gnu::always_inline]] inline void kahan_add(V &sum, V &comp, const V &x) {
+    V y = x - comp;
+    V t = sum + y;
+    comp = (t - sum) - y;
+    sum = t;
+}
+
+template <int W> [[gnu::always_inline]] inline double kahan(const double *a, std::size_t n) {
+    using V = Vec<W>;
+    V sum[accumulators], comp[accumulators];
+    for (int k = 0; k < accumulators; ++k)
+        sum[k] = comp[k] = V{};
+
+    std::size_t i = 0;
+    for (; i + accumulators * W <= n; i += accumulators * W) {
+#pragma GCC unroll 8
+        for (int k = 0; k < accumulators; ++k) {
+            V x;
+            load(x, a + i + k * W);
+            kahan_add(sum[k], comp[k], x);
+        }
+    }
+    for (; i + W <= n; i += W) {
+        V x;
+        load(x, a + i);
+        kahan_add(sum[0], comp[0], x);
+    }
+
+    // Combine the partial sums, still with compensation
+    double total = 0.0, total_comp = 0.0;
+    for (int k = 0; k < accumulators; ++k) {
+        for (int j = 0; j < W; ++j) {
+            double s, c;
+            if constexpr (W == 1) {
+                s = sum[k];
+                c = comp[k];
+            } else {
+                s = sum[k][j];
+                c = comp[k][j];
+            }
+            kahan_add(total, total_comp, s);
+            kahan_add(total, total_comp, -c);
+        }
+    }
+    for (; i < n; ++i)
+        kahan_add(total, total_comp, a[i]);
+    return total;
+}
+
+// The kernels for each instruction set. Every function with a "target" attribute inlines the
+// templates above, so they are compiled with its instruction set.
+
+double scalar_sum(const double *a, std::size_t n) { return reduce<Sum, 1>(a, nullptr, n); }
+double scalar_min(const double *a, std::size_t n) { return reduce<Min, 1>(a, nullptr, n); }
+double scalar_max(const double *a, std::size_t n) { return reduce<Max, 1>(a, nullptr, n); }
+double scalar_dot(const double *a, const double *b, std::size_t n) {
+    return reduce<Dot, 1>(a, b, n);
+}
+double scalar_max_abs_diff(const double *a, const double *b, std::size_t n) {
+    return reduce<MaxAbsDiff, 1>(a, b, n);
+}
+double scalar_kahan(const double *a, std::size_t n) { return kahan<1>(a, n); }
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_REDUCE_X86 1
+
+// SSE2 is part of x86-64, so these need no attribute
+double sse2_sum(const double *a, std::size_t n) { return reduce<Sum, 2>(a, nullptr, n); }
+double sse2_min(const double *a, std::size_t n) { return reduce<Min, 2>(a, nullptr, n); }
+double sse2_max(const double *a, std::size_t n) { return reduce<Max, 2>(a, nullptr, n); }
+double sse2_dot(const double *a, const double *b, std::size_t n) {
+    return reduce<Dot, 2>(a, b, n);
+}
+double sse2_max_abs_diff(const double *a, const double *b, std::size_t n) {
+    return reduce<MaxAbsDiff, 2>(a, b, n);
+}
+double sse2_kahan(const double *a, std::size_t n) { return kahan<2>(a, n); }
+
+[[gnu::target("avx2")]] double avx2_sum(const double *a, std::size_t n) {
+    return reduce<Sum, 4>(a, nullptr, n);
+}
+[[gnu::target("avx2")]] double avx2_min(const double *a, std::size_t n) {
+    return reduce<Min, 4>(a, nullptr, n);
+}
+[[gnu::target("avx2")]] double avx2_max(const double *a, std::size_t n) {
+    return reduce<Max, 4>(a, nullptr, n);
+}
+[[gnu::target("avx2")]] double avx2_dot(const double *a, const double *b, std::size_t n) {
+    return reduce<Dot, 4>(a, b, n);
+}
+[[gnu::target("avx2")]] double avx2_max_abs_diff(const double *a, const double *b, std::size_t n) {
+    return reduce<MaxAbsDiff, 4>(a, b, n);
+}
+[[gnu::target("avx2")]] double avx2_kahan(const double *a, std::size_t n) { return kahan<4>(a, n); }
+
+[[gnu::target("avx512f")]] double avx512_sum(const double *a, std::size_t n) {
+    return reduce<Sum, 8>(a, nullptr, n);
+}
+[[gnu::target("avx512f")]] double avx512_min(const double *a, std::size_t n) {
+    return reduce<Min, 8>(a, nullptr, n);
+}
+[[gnu::target("avx512f")]] double avx512_max(const double *a, std::size_t n) {
+    return reduce<Max, 8>(a, nullptr, n);
+}
+[[gnu::target("avx512f")]] double avx512_dot(const double *a, const double *b, std::size_t n) {
+    return reduce<Dot, 8>(a, b, n);
+}
+[[gnu::target("avx512f")]] double avx512_max_abs_diff(const double *a, const double *b,
+                                                      std::size_t n) {
+    return reduce<MaxAbsDiff, 8>(a, b, n);
+}
+[[gnu::target("avx512f")]] double avx512_kahan(const double *a, std::size_t n) {
+    return kahan<8>(a, n);
+}
+#endif
+
+const ReductionKernels scalar_kernels{Isa::scalar, scalar_sum, scalar_min,         scalar_max,
+                                      scalar_dot,  scalar_max_abs_diff, scalar_kahan};
+#ifdef SIMD_REDUCE_X86
+const ReductionKernels sse2_kernels{Isa::sse2, sse2_sum, sse2_min,         sse2_max,
+                                    sse2_dot,  sse2_max_abs_diff, sse2_kahan};
+const ReductionKernels avx2_kernels{Isa::avx2, avx2_sum, avx2_min,         avx2_max,
+                                    avx2_dot,  avx2_max_abs_diff, avx2_kahan};
+const ReductionKernels avx512_kernels{Isa::avx512, avx512_sum, avx512_min,         avx512_max,
+                                      avx512_dot,  avx512_max_abs_diff, avx512_kahan};
+#endif
+
+} // namespace
+
+const char *isa_name(Isa isa) {
+    switch (isa) {
+    case Isa::scalar:
+        return "scalar";
+    case Isa::sse2:
+        return "SSE2";
+    case Isa::avx2:
+        return "AVX2";
+    case Isa::avx512:
+        return "AVX-512";
+    }
+    return "unknown";
+}
+
+Isa detect_isa() {
+#ifdef SIMD_REDUCE_X86
+    if (__builtin_cpu_supports("avx512f"))
+        return Isa::avx512;
+    if (__builtin_cpu_supports("avx2"))
+        return Isa::avx2;
+    if (__builtin_cpu_supports("sse2"))
+        return Isa::sse2;
+#endif
+    return Isa::scalar;
+}
+
+const ReductionKernels &reduction_kernels(Isa isa) {
+    switch (isa) {
+#ifdef SIMD_REDUCE_X86
+    case Isa::sse2:
+        return sse2_kernels;
+    case Isa::avx2:
+        return avx2_kernels;
+    case Isa::avx512:
+        return avx512_kernels;
+#endif
+    default:
+        return scalar_kernels;
+    }
+}
+
+const ReductionKernels &best_reduction_kernels() {
+    // Thread-safe initialization of a local static, as in 062-lazy_initialization
+    static const ReductionKernels &best = reduction_kernels(detect_isa());
+    return best;
+}
+
+double simd_sum(const double *data, std::size_t n) { return best_reduction_kernels().sum(data, n); }
+double simd_min(const double *data, std::size_t n) { return best_reduction_kernels().min(data, n); }
+double simd_max(const double *data, std::size_t n) { return best_reduction_kernels().max(data, n); }
+double simd_dot(const double *a, const double *b, std::size_t n) {
+    return best_reduction_kernels().dot(a, b, n);
+}
+double simd_max_abs_diff(const double *a, const double *b, std::size_t n) {
+    return best_reduction_kernels().max_abs_diff(a, b, n);
+}
+double kahan_sum(const double *data, std::size_t n) {
+    return best_reduction_kernels().kahan_sum(data, n);
+}
+
+double pairwise_sum(const double *data, std::size_t n) {
+    // Below this size, the accumulators of simd_sum() already split the additions into short chains
+    constexpr std::size_t block = 1024;
+    if (n <= block)
+        return simd_sum(data, n);
+    std::size_t half = n / 2;
+    return pairwise_sum(data, half) + pairwise_sum(data + half, n - half);
+}
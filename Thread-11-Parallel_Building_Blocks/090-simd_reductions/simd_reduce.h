@@ -0,0 +1,75 @@
+/**
+ * SIMD reduction kernels for arrays of doubles
+ *
+ * `accum()` in 069-data_parallelism.cpp calls std::accumulate, which is a chain of dependent
+ * additions: each one must wait for the previous result. An addition takes about 4 cycles, so one
+ * core adds fewer than one double per cycle, although it could load and add 8 or 16 per cycle.
+ * The compiler may not change the order of floating-point additions, so it cannot fix this itself.
+ *
+ * These kernels change the order explicitly:
+ * - SIMD: one instruction works on a whole register, 2 doubles with SSE2, 4 with AVX2 and 8 with
+ *   AVX-512.
+ * - Multiple accumulators: each kernel keeps several independent register accumulators, so that
+ *   several additions are in flight at once and the chain of dependencies is broken.
+ * The partial results are combined at the end. For a large array, the kernels are limited by
+ * memory bandwidth instead of by the latency of the additions.
+ *
+ * Runtime dispatch:
+ * - The kernels are compiled for SSE2, AVX2 and AVX-512 in the same program, with no -march flag.
+ * - On the first call, the best instruction set which the CPU supports is chosen.
+ *
+ * Because the additions happen in a different order, simd_sum() may differ from std::accumulate
+ * in the last few bits. For better accuracy, kahan_sum() carries a compensation term which
+ * recovers the bits lost by each addition, and pairwise_sum() adds in a balanced tree, whose
+ * rounding error grows with log(n) instead of n.
+ *
+ * min/max kernels: the input must not contain NaN. The result for an empty array is +infinity for
+ * min and -infinity for max.
+ */
+
+#ifndef SIMD_REDUCE_H
+#define SIMD_REDUCE_H
+
+#include <cstddef>
+
+// Instruction sets, from the most widely available
+enum class Isa { scalar, sse2, avx2, avx512 };
+
+const char *isa_name(Isa isa);
+
+// The best instruction set supported by this CPU
+Isa detect_isa();
+
+// One implementation of each reduction
+struct ReductionKernels {
+    Isa isa;
+    double (*sum)(const double *data, std::size_t n);
+    double (*min)(const double *data, std::size_t n);
+    double (*max)(const double *data, std::size_t n);
+    double (*dot)(const double *a, const double *b, std::size_t n);
+    double (*max_abs_diff)(const double *a, const double *b, std::size_t n);
+    double (*kahan_sum)(const double *data, std::size_t n);
+};
+
+// The kernels for "isa". The CPU must support it.
+const ReductionKernels &reduction_kernels(Isa isa);
+
+// The kernels for detect_isa(), chosen on the first call
+const ReductionKernels &best_reduction_kernels();
+
+// These call the best kernels
+double simd_sum(const double *data, std::size_t n);
+double simd_min(const double *data, std::size_t n);
+double simd_max(const double *data, std::size_t n);
+double simd_dot(const double *a, const double *b, std::size_t n);
+
+// The largest |a[i] - b[i]|, as in 075-new_parallel_algorithms_practical.cpp
+double simd_max_abs_diff(const double *a, const double *b, std::size_t n);
+
+// Compensated summation, about as fast as simd_sum() once the data is out of cache
+double kahan_sum(const double *data, std::size_t n);
+
+// Splits the array in halves until the pieces are small, and sums the pieces with simd_sum()
+double pairwise_sum(const double *data, std::size_t n);
+
+#endif // SIMD_REDUCE_H
@@ -0,0 +1,136 @@
+/**
+ * Benchmark of the parallel sorting algorithms
+ *
+ * Sorts random 64-bit integers, random doubles, and event log records (sorted by timestamp) with
+ * std::sort, std::sort(std::execution::par), and the algorithms in parallel_sort.h.
+ * Every result is checked against std::stable_sort.
+ *
+ * The sizes go from 1 million elements up to the command line argument (10 million by default):
+ *     ./a.out 1000000000
+ * An array of 1 billion 8-byte elements needs 8 GB, and the same again for the buffer.
+ */
+
+#include "parallel_sort.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <execution>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// A record from an event log
+struct Event {
+    std::uint64_t timestamp; // Nanoseconds
+    std::uint32_t source;
+    std::uint32_t kind;
+    double value;
+};
+
+bool operator==(const Event &a, const Event &b) {
+    return a.timestamp == b.timestamp && a.source == b.source && a.kind == b.kind &&
+           a.value == b.value;
+}
+
+auto by_timestamp = [](const Event &a, const Event &b) { return a.timestamp < b.timestamp; };
+
+// Unstable sorts may put equal elements in any order. Put them back in their original order (the
+// value of each test event is its original position), so that the check only fails if the order
+// of the keys is wrong.
+template <class T> void restore_order_of_equal_elements(std::vector<T> &data) {
+    if constexpr (std::is_same_v<T, Event>) {
+        std::sort(data.begin(), data.end(), [](const Event &a, const Event &b) {
+            return a.timestamp < b.timestamp || (a.timestamp == b.timestamp && a.value < b.value);
+        });
+    }
+}
+
+// Time one sort of a copy of "input", and check the result
+template <class T, class Sort>
+void run(const char *name, bool stable, const std::vector<T> &input,
+         const std::vector<T> &expected, Sort sort) {
+    std::vector<T> data(input);
+
+    auto start = std::chrono::steady_clock::now();
+    sort(data);
+    double secs =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!stable)
+        restore_order_of_equal_elements(data);
+
+    std::cout << std::setw(28) << name << std::setw(10) << std::fixed << std::setprecision(1)
+              << secs * 1000 << " ms" << std::setw(10) << input.size() / secs / 1e6 << " M/s";
+    if (data != expected)
+        std::cout << "   WRONG RESULT";
+    std::cout << '\n';
+}
+
+template <class T, class Compare>
+void compare_sorts(ThreadPool &pool, const std::vector<T> &input, Compare comp) {
+    std::vector<T> expected(input);
+    std::stable_sort(expected.begin(), expected.end(), comp);
+
+    run("std::sort", false, input, expected,
+        [&](std::vector<T> &v) { std::sort(v.begin(), v.end(), comp); });
+    run("std::sort(par)", false, input, expected,
+        [&](std::vector<T> &v) { std::sort(std::execution::par, v.begin(), v.end(), comp); });
+    run("parallel_merge_sort", true, input, expected,
+        [&](std::vector<T> &v) { parallel_merge_sort(pool, v.begin(), v.end(), comp); });
+    run("parallel_sample_sort", false, input, expected,
+        [&](std::vector<T> &v) { parallel_sample_sort(pool, v.begin(), v.end(), comp); });
+    if constexpr (std::is_same_v<T, Event>) {
+        run("parallel_radix_sort", true, input, expected, [&](std::vector<T> &v) {
+            parallel_radix_sort(pool, v.begin(), v.end(),
+                                [](const Event &e) { return e.timestamp; });
+        });
+    } else {
+        run("parallel_radix_sort", true, input, expected,
+            [&](std::vector<T> &v) { parallel_radix_sort(pool, v.begin(), v.end()); });
+    }
+}
+
+// g++ -std=c++20 -Wall -Wextra -pedantic -pthread -O2 main.cpp thread_pool.cpp -ltbb && ./a.out
+int main(int argc, char *argv[]) {
+    std::size_t max_size = argc > 1 ? std::stoull(argv[1]) : 10'000'000;
+
+    ThreadPool pool;
+    std::cout << "Thread pool with " << pool.size() << " threads, plus the main thread\n";
+
+    std::mt19937_64 mt(42);
+
+    for (std::size_t n = 1'000'000; n <= max_size; n *= 10) {
+        std::cout << "--------------------------------\n";
+        std::cout << n << " elements\n";
+
+        {
+            std::cout << "64-bit integers:\n";
+            std::vector<std::uint64_t> input(n);
+            for (auto &x : input)
+                x = mt();
+            compare_sorts(pool, input, std::less<>{});
+        }
+        {
+            std::cout << "Doubles, normally distributed:\n";
+            std::normal_distribution<double> dist(0.0, 1000.0);
+            std::vector<double> input(n);
+            for (auto &x : input)
+                x = dist(mt);
+            compare_sorts(pool, input, std::less<>{});
+        }
+        {
+            // Events from 64 sources, each roughly in time order, with many duplicate timestamps
+            std::cout << "Event records, by timestamp:\n";
+            std::vector<Event> input(n);
+            std::uniform_int_distribution<std::uint64_t> jitter(0, 1'000'000);
+            for (std::size_t i = 0; i < n; ++i) {
+                auto source = static_cast<std::uint32_t>(i % 64);
+                input[i] = {(i / 64) * 1000 + jitter(mt) / 1000 * 1000, source,
+                            static_cast<std::uint32_t>(mt() % 8), static_cast<double>(i)};
+            }
+            compare_sorts(pool, input, by_timestamp);
+        }
+    }
+}
@@ -0,0 +1,343 @@
+/**
+ * Parallel sorting algorithms on the work-stealing thread pool
+ *
+ * 070-standard_algorithms.cpp and 071-execution_policies.cpp sort with
+ * std::sort(std::execution::par, ...), which is only parallel if the program is linked with TBB.
+ * These algorithms only need the ThreadPool in this directory.
+ *
+ * - parallel_merge_sort(): stable. Each half is sorted in a separate task, recursively, and the
+ *   sorted halves are merged by a parallel merge. Merging needs a buffer as large as the input.
+ * - parallel_radix_sort(): least significant digit radix sort for integer and floating-point keys,
+ *   one byte per pass. It never compares two elements, so it does O(n) work per pass instead of
+ *   O(n log n) in total. Passes in which every key has the same byte are skipped. Stable.
+ * - parallel_sample_sort(): picks splitters from a random sample, moves each element to the bucket
+ *   between two splitters, and then sorts the buckets independently. Each element is moved once
+ *   before the final sort, so it suits large inputs which do not fit in the cache. Not stable.
+ * - parallel_sort(): radix sort for arithmetic types in ascending order, otherwise sample sort.
+ *
+ * The data must be in contiguous memory (std::vector, std::array or a C array). The algorithms
+ * need a temporary buffer of the same size, so the element type must be default constructible
+ * and move assignable.
+ */
+
+#ifndef PARALLEL_SORT_H
+#define PARALLEL_SORT_H
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "thread_pool.h"
+
+// Below these sizes, a piece of work is done by a single task
+constexpr std::size_t sort_grain = 8 * 1024;
+constexpr std::size_t merge_grain = 16 * 1024;
+constexpr std::size_t block_grain = 64 * 1024;
+
+// Call func(b) for b = 0, 1, ..., nblocks - 1 in parallel
+template <class F> void parallel_blocks(ThreadPool &pool, std::size_t nblocks, F func) {
+    TaskGroup group(pool);
+    for (std::size_t b = 1; b < nblocks; ++b)
+        group.run([&func, b]() { func(b); });
+    func(0);
+    group.wait();
+}
+
+// Split n elements into blocks of about block_grain elements, with at most 4 blocks per thread
+inline std::size_t block_count(const ThreadPool &pool, std::size_t n) {
+    std::size_t max_blocks = 4 * (pool.size() + 1);
+    return std::clamp<std::size_t>(n / block_grain, 1, max_blocks);
+}
+
+// First element of block b, when n elements are split into nblocks blocks
+inline std::size_t block_begin(std::size_t n, std::size_t nblocks, std::size_t b) {
+    return n * b / nblocks;
+}
+
+//----------------------------------------------------------------------------------------------
+// Merge sort
+
+// Merge the sorted ranges [first1, last1) and [first2, last2) into "out", moving the elements.
+// The larger range is split at its middle element, and the other range is split at the same
+// value, so that each half of the output can be merged independently.
+template <class T, class Compare>
+void parallel_merge(ThreadPool &pool, T *first1, T *last1, T *first2, T *last2, T *out,
+                    Compare comp) {
+    std::size_t n1 = last1 - first1, n2 = last2 - first2;
+    if (n1 + n2 <= merge_grain) {
+        std::merge(std::make_move_iterator(first1), std::make_move_iterator(last1),
+                   std::make_move_iterator(first2), std::make_move_iterator(last2), out, comp);
+        return;
+    }
+
+    // For stability, elements of the first range go before equal elements of the second range
+    T *mid1, *mid2;
+    if (n1 >= n2) {
+        mid1 = first1 + n1 / 2;
+        mid2 = std::lower_bound(first2, last2, *mid1, comp);
+    } else {
+        mid2 = first2 + n2 / 2;
+        mid1 = std::upper_bound(first1, last1, *mid2, comp);
+    }
+    T *mid_out = out + (mid1 - first1) + (mid2 - first2);
+
+    TaskGroup group(pool);
+    group.run([=, &pool]() { parallel_merge(pool, first1, mid1, first2, mid2, out, comp); });
+    parallel_merge(pool, mid1, last1, mid2, last2, mid_out, comp);
+    group.wait();
+}
+
+// Sort the n elements at "a". The result is left in "a" if to_a is true, otherwise in "b".
+// "b" is a buffer of n elements. The two arrays swap roles at each level of the recursion, so
+// the elements are only moved once per level.
+template <class T, class Compare>
+void merge_sort_into(ThreadPool &pool, T *a, T *b, std::size_t n, bool to_a, Compare comp) {
+    if (n <= sort_grain) {
+        std::stable_sort(a, a + n, comp);
+        if (!to_a)
+            std::move(a, a + n, b);
+        return;
+    }
+
+    // Sort each half into the other array
+    std::size_t half = n / 2;
+    TaskGroup group(pool);
+    group.run([=, &pool]() { merge_sort_into(pool, a, b, half, !to_a, comp); });
+    merge_sort_into(pool, a + half, b + half, n - half, !to_a, comp);
+    group.wait();
+
+    // Then merge them back
+    T *src = to_a ? b : a;
+    T *dst = to_a ? a : b;
+    parallel_merge(pool, src, src + half, src + half, src + n, dst, comp);
+}
+
+template <std::contiguous_iterator It, class Compare = std::less<>>
+void parallel_merge_sort(ThreadPool &pool, It first, It last, Compare comp = Compare{}) {
+    using T = std::iter_value_t<It>;
+    std::size_t n = last - first;
+    if (n <= sort_grain) {
+        std::stable_sort(first, last, comp);
+        return;
+    }
+
+    auto buffer = std::make_unique_for_overwrite<T[]>(n);
+    merge_sort_into(pool, std::to_address(first), buffer.get(), n, true, comp);
+}
+
+//----------------------------------------------------------------------------------------------
+// Radix sort
+
+// Map a key to an unsigned integer with the same order, so that the bytes can be compared one
+// at a time, from the most significant.
+template <class K> auto radix_bits(K key) {
+    if constexpr (std::is_floating_point_v<K>) {
+        // IEEE 754: positive numbers are ordered like their bit patterns. Setting the sign bit
+        // puts them above the negative numbers. Negative numbers are ordered backwards, so all
+        // their bits are flipped. NaNs go to the ends.
+        using U = std::conditional_t<sizeof(K) == 4, std::uint32_t, std::uint64_t>;
+        constexpr U sign = U{1} << (8 * sizeof(U) - 1);
+        U bits = std::bit_cast<U>(key);
+        return (bits & sign) ? ~bits : (bits | sign);
+    } else if constexpr (std::is_signed_v<K>) {
+        // Flipping the sign bit moves the negative numbers below the positive ones
+        using U = std::make_unsigned_t<K>;
+        constexpr U sign = U{1} << (8 * sizeof(U) - 1);
+        return static_cast<U>(static_cast<U>(key) ^ sign);
+    } else {
+        static_assert(std::is_unsigned_v<K>, "radix sort needs an arithmetic key");
+        return key;
+    }
+}
+
+/**
+ * Sort by key(element) in ascending order. "key" must return an integer or floating-point value.
+ * Each pass looks at one byte of the keys:
+ * 1. Each block of the input counts how many of its keys have each value of the byte.
+ * 2. From the counts, each block knows where its elements with each byte value go in the output.
+ * 3. Each block copies its elements to those positions, in order, which keeps the sort stable.
+ */
+template <std::contiguous_iterator It, class KeyFn>
+void parallel_radix_sort(ThreadPool &pool, It first, It last, KeyFn key) {
+    using T = std::iter_value_t<It>;
+    using Bits = decltype(radix_bits(key(*first)));
+    constexpr int passes = sizeof(Bits);
+
+    std::size_t n = last - first;
+    if (n < 2)
+        return;
+
+    std::size_t nblocks = block_count(pool, n);
+    T *data = std::to_address(first);
+
+    // Find the bits which are not the same in every key. The passes for bytes without any of them
+    // have nothing to do.
+    Bits reference = radix_bits(key(data[0]));
+    std::vector<Bits> differences(nblocks);
+    parallel_blocks(pool, nblocks, [&](std::size_t b) {
+        Bits diff = 0;
+        for (std::size_t i = block_begin(n, nblocks, b); i < block_begin(n, nblocks, b + 1); ++i)
+            diff |= radix_bits(key(data[i])) ^ reference;
+        differences[b] = diff;
+    });
+    Bits differing = 0;
+    for (Bits diff : differences)
+        differing |= diff;
+    if (differing == 0)
+        return;
+
+    auto buffer = std::make_unique_for_overwrite<T[]>(n);
+    T *src = data, *dst = buffer.get();
+    std::vector<std::array<std::size_t, 256>> offsets(nblocks);
+
+    for (int pass = 0; pass < passes; ++pass) {
+        int shift = 8 * pass;
+        if (((differing >> shift) & 0xFF) == 0)
+            continue;
+
+        // 1. Count
+        parallel_blocks(pool, nblocks, [&](std::size_t b) {
+            auto &counts = offsets[b];
+            counts.fill(0);
+            for (std::size_t i = block_begin(n, nblocks, b); i < block_begin(n, nblocks, b + 1);
+                 ++i)
+                ++counts[(radix_bits(key(src[i])) >> shift) & 0xFF];
+        });
+
+        // 2. Turn the counts into positions: all the elements with byte value 0 (from block 0,
+        // then block 1, ...), then all the elements with byte value 1, and so on
+        std::size_t pos = 0;
+        for (int digit = 0; digit < 256; ++digit) {
+            for (std::size_t b = 0; b < nblocks; ++b) {
+                std::size_t count = offsets[b][digit];
+                offsets[b][digit] = pos;
+                pos += count;
+            }
+        }
+
+        // 3. Scatter
+        parallel_blocks(pool, nblocks, [&](std::size_t b) {
+            auto &next = offsets[b];
+            for (std::size_t i = block_begin(n, nblocks, b); i < block_begin(n, nblocks, b + 1);
+                 ++i)
+                dst[next[(radix_bits(key(src[i])) >> shift) & 0xFF]++] = std::move(src[i]);
+        });
+
+        std::swap(src, dst);
+    }
+
+    // After an odd number of passes, the result is in the buffer
+    if (src != data) {
+        parallel_blocks(pool, nblocks, [&](std::size_t b) {
+            std::move(src + block_begin(n, nblocks, b), src + block_begin(n, nblocks, b + 1),
+                      data + block_begin(n, nblocks, b));
+        });
+    }
+}
+
+// Sort integers or floating-point numbers in ascending order
+template <std::contiguous_iterator It>
+    requires std::is_arithmetic_v<std::iter_value_t<It>>
+void parallel_radix_sort(ThreadPool &pool, It first, It last) {
+    parallel_radix_sort(pool, first, last, [](auto value) { return value; });
+}
+
+//----------------------------------------------------------------------------------------------
+// Sample sort
+
+template <std::contiguous_iterator It, class Compare = std::less<>>
+void parallel_sample_sort(ThreadPool &pool, It first, It last, Compare comp = Compare{}) {
+    using T = std::iter_value_t<It>;
+    std::size_t n = last - first;
+    std::size_t nblocks = block_count(pool, n);
+    if (nblocks < 2) {
+        std::sort(first, last, comp);
+        return;
+    }
+    T *data = std::to_address(first);
+
+    // 1. Choose nblocks - 1 splitters from a sorted random sample. Oversampling makes the buckets
+    // more even. A fixed seed makes the result the same every time.
+    constexpr std::size_t oversampling = 32;
+    std::size_t nbuckets = nblocks;
+    std::vector<T> sample(nbuckets * oversampling);
+    std::mt19937_64 mt(n);
+    std::uniform_int_distribution<std::size_t> dist(0, n - 1);
+    for (auto &s : sample)
+        s = data[dist(mt)];
+    std::sort(sample.begin(), sample.end(), comp);
+
+    std::vector<T> splitters(nbuckets - 1);
+    for (std::size_t i = 0; i + 1 < nbuckets; ++i)
+        splitters[i] = sample[(i + 1) * oversampling];
+
+    // 2. Find the bucket of each element, and count the elements of each bucket in each block.
+    // Bucket i holds the elements between splitters[i - 1] and splitters[i].
+    std::vector<std::uint32_t> bucket_of(n);
+    std::vector<std::vector<std::size_t>> offsets(nblocks, std::vector<std::size_t>(nbuckets));
+    parallel_blocks(pool, nblocks, [&](std::size_t b) {
+        for (std::size_t i = block_begin(n, nblocks, b); i < block_begin(n, nblocks, b + 1); ++i) {
+            auto bucket = std::upper_bound(splitters.begin(), splitters.end(), data[i], comp) -
+                          splitters.begin();
+            bucket_of[i] = static_cast<std::uint32_t>(bucket);
+            ++offsets[b][bucket];
+        }
+    });
+
+    // 3. Positions of each block's elements in each bucket, as in the radix sort
+    std::vector<std::size_t> bucket_begin(nbuckets + 1);
+    std::size_t pos = 0;
+    for (std::size_t bucket = 0; bucket < nbuckets; ++bucket) {
+        bucket_begin[bucket] = pos;
+        for (std::size_t b = 0; b < nblocks; ++b) {
+            std::size_t count = offsets[b][bucket];
+            offsets[b][bucket] = pos;
+            pos += count;
+        }
+    }
+    bucket_begin[nbuckets] = n;
+
+    // 4. Move the elements to their buckets
+    auto buffer = std::make_unique_for_overwrite<T[]>(n);
+    parallel_blocks(pool, nblocks, [&](std::size_t b) {
+        auto &next = offsets[b];
+        for (std::size_t i = block_begin(n, nblocks, b); i < block_begin(n, nblocks, b + 1); ++i)
+            buffer[next[bucket_of[i]]++] = std::move(data[i]);
+    });
+
+    // 5. Sort each bucket and move it back. With many equal keys, one bucket may hold much more
+    // than its share, so a large bucket is sorted in parallel too.
+    parallel_blocks(pool, nbuckets, [&](std::size_t bucket) {
+        T *begin = buffer.get() + bucket_begin[bucket];
+        T *end = buffer.get() + bucket_begin[bucket + 1];
+        if (static_cast<std::size_t>(end - begin) > 2 * n / nbuckets)
+            parallel_merge_sort(pool, begin, end, comp);
+        else
+            std::sort(begin, end, comp);
+        std::move(begin, end, data + bucket_begin[bucket]);
+    });
+}
+
+//----------------------------------------------------------------------------------------------
+
+// The fastest algorithm for the element type
+template <std::contiguous_iterator It, class Compare = std::less<>>
+void parallel_sort(ThreadPool &pool, It first, It last, Compare comp = Compare{}) {
+    using T = std::iter_value_t<It>;
+    if constexpr (std::is_arithmetic_v<T> &&
+                  (std::is_same_v<Compare, std::less<>> || std::is_same_v<Compare, std::less<T>>))
+        parallel_radix_sort(pool, first, last);
+    else
+        parallel_sample_sort(pool, first, last, comp);
+}
+
+#endif // PARALLEL_SORT_H
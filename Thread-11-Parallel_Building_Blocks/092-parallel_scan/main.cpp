@@ -0,0 +1,212 @@
+/**
+ * Test program for the parallel scans
+ *
+ * 1. The scans give the same results as std::inclusive_scan and std::exclusive_scan.
+ * 2. A segmented scan: running totals per customer.
+ * 3. Filtering a column with parallel_copy_if, as in a column store.
+ * 4. Grouping rows by bin with parallel_histogram and histogram_to_offsets.
+ * 5. Throughput compared with std::inclusive_scan, sequential and with std::execution::par.
+ */
+
+#include "parallel_scan.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <execution>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <ranges>
+#include <vector>
+
+static std::mt19937 mt;
+
+template <class T> void print(const char *name, const std::vector<T> &vec, int width = 4) {
+    std::cout << std::setw(10) << name << ": ";
+    for (auto x : vec)
+        std::cout << std::setw(width) << x;
+    std::cout << '\n';
+}
+
+// Largest relative difference between two vectors of numbers
+template <class T> double max_error(const std::vector<T> &a, const std::vector<T> &b) {
+    double err = 0.0;
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        double scale = std::max(1.0, std::abs(static_cast<double>(b[i])));
+        double diff = std::abs(static_cast<double>(a[i]) - static_cast<double>(b[i]));
+        err = std::max(err, diff / scale);
+    }
+    return err;
+}
+
+// 1. Compare with the standard library
+template <class T> void check_scans(ThreadPool &pool, const char *type_name, std::size_t n) {
+    std::uniform_int_distribution<int> dist(-100, 100);
+    std::vector<T> in(n), expected(n), out(n);
+    for (auto &x : in)
+        x = static_cast<T>(dist(mt));
+
+    std::cout << std::setw(8) << type_name << std::setw(12) << n;
+
+    std::inclusive_scan(in.begin(), in.end(), expected.begin());
+    parallel_inclusive_scan(pool, in.begin(), in.end(), out.begin());
+    std::cout << "  inclusive " << max_error(out, expected);
+
+    std::exclusive_scan(in.begin(), in.end(), expected.begin(), T{7});
+    parallel_exclusive_scan(pool, in.begin(), in.end(), out.begin(), T{7});
+    std::cout << "  exclusive " << max_error(out, expected);
+
+    // In place
+    out = in;
+    parallel_inclusive_scan(pool, out.begin(), out.end(), out.begin(), std::plus<>{}, T{7});
+    std::inclusive_scan(in.begin(), in.end(), expected.begin(), std::plus<>{}, T{7});
+    std::cout << "  in place " << max_error(out, expected);
+
+    // An operation which is not a sum: running maximum
+    auto max_op = [](T a, T b) { return std::max(a, b); };
+    std::inclusive_scan(in.begin(), in.end(), expected.begin(), max_op);
+    parallel_inclusive_scan(pool, in.begin(), in.end(), out.begin(), max_op);
+    std::cout << "  max " << max_error(out, expected) << '\n';
+}
+
+// 2. Each order has a customer, and orders are sorted by customer. The flag marks the first order
+// of each customer, so the segmented scan gives the running total per customer.
+void segmented_example(ThreadPool &pool) {
+    std::vector<int> amounts{5, 3, 2, 8, 1, 1, 4, 6, 2, 7};
+    std::vector<int> first_of{1, 0, 0, 1, 0, 0, 0, 1, 1, 0};
+    std::vector<int> totals(amounts.size());
+    parallel_segmented_inclusive_scan(pool, amounts.begin(), amounts.end(), first_of.begin(),
+                                      totals.begin());
+    print("amount", amounts);
+    print("new cust", first_of);
+    print("total", totals);
+
+    // The same, on enough data to use many blocks
+    std::size_t n = 3'000'000;
+    std::vector<long> values(n), out(n), expected(n);
+    std::vector<char> flags(n);
+    std::bernoulli_distribution starts(0.00001);
+    for (std::size_t i = 0; i < n; ++i) {
+        values[i] = mt() % 100;
+        flags[i] = starts(mt);
+    }
+    for (std::size_t i = 0; i < n; ++i)
+        expected[i] = (i == 0 || flags[i]) ? values[i] : expected[i - 1] + values[i];
+    parallel_segmented_inclusive_scan(pool, values.begin(), values.end(), flags.begin(),
+                                      out.begin());
+    std::cout << "Segmented scan of " << n << " values: "
+              << (out == expected ? "correct" : "WRONG") << '\n';
+}
+
+// 3. Find the rows of a "price" column which are over a limit. Filtering the row numbers gives a
+// selection vector, which can then be used to fetch the other columns of those rows.
+void filter_example(ThreadPool &pool) {
+    std::size_t nrows = 5'000'000;
+    std::uniform_real_distribution<double> dist(0.0, 1000.0);
+    std::vector<double> price(nrows);
+    for (auto &p : price)
+        p = dist(mt);
+
+    auto rows = std::views::iota(std::uint32_t{0}, static_cast<std::uint32_t>(nrows));
+    auto expensive = [&price](std::uint32_t row) { return price[row] > 990.0; };
+
+    std::vector<std::uint32_t> selected(nrows), expected(nrows);
+    selected.erase(parallel_copy_if(pool, rows.begin(), rows.end(), selected.begin(), expensive),
+                   selected.end());
+    expected.erase(std::copy_if(rows.begin(), rows.end(), expected.begin(), expensive),
+                   expected.end());
+
+    std::cout << selected.size() << " of " << nrows << " rows have a price over 990: "
+              << (selected == expected ? "correct" : "WRONG") << '\n';
+}
+
+// 4. Group values by their last digit, as the first pass of a counting sort
+void histogram_example(ThreadPool &pool) {
+    std::vector<int> values(1'000'000);
+    for (auto &v : values)
+        v = mt() % 1000;
+
+    auto bin = [](int v) { return static_cast<std::size_t>(v % 10); };
+    std::vector<std::size_t> counts =
+        parallel_histogram(pool, values.begin(), values.end(), 10, bin);
+    std::vector<std::size_t> offsets = histogram_to_offsets(pool, counts);
+
+    // Each bin's elements go to [offsets[k], offsets[k + 1])
+    std::vector<int> grouped(values.size());
+    std::vector<std::size_t> next(offsets.begin(), offsets.end() - 1);
+    for (int v : values)
+        grouped[next[bin(v)]++] = v;
+
+    bool correct = true;
+    for (std::size_t k = 0; k < counts.size(); ++k) {
+        for (std::size_t i = offsets[k]; i < offsets[k + 1]; ++i)
+            correct &= bin(grouped[i]) == k;
+    }
+    print("counts", counts, 8);
+    print("offsets", offsets, 8);
+    std::cout << "Grouped by bin: " << (correct ? "correct" : "WRONG") << '\n';
+}
+
+// 5. Throughput in GB/s of the input
+template <typename Func> double gb_per_sec(std::size_t bytes, int repeats, Func func) {
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; ++r)
+        func();
+    double secs =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return bytes * repeats / secs / 1e9;
+}
+
+template <class T>
+void compare_speed(ThreadPool &pool, const char *type_name, std::size_t n, int repeats) {
+    std::vector<T> in(n, T{1}), out(n);
+    std::size_t bytes = n * sizeof(T);
+
+    std::cout << std::setw(8) << type_name << std::setprecision(3) << std::setw(16)
+              << gb_per_sec(bytes, repeats,
+                            [&]() { std::inclusive_scan(in.begin(), in.end(), out.begin()); })
+              << std::setw(16) << gb_per_sec(bytes, repeats, [&]() {
+                     std::inclusive_scan(std::execution::par, in.begin(), in.end(), out.begin());
+                 })
+              << std::setw(16) << gb_per_sec(bytes, repeats, [&]() {
+                     parallel_inclusive_scan(pool, in.begin(), in.end(), out.begin());
+                 })
+              << std::setw(16) << gb_per_sec(bytes, repeats, [&]() {
+                     simd_block_scan<true>(in.data(), out.data(), n, T{});
+                 })
+              << '\n';
+}
+
+// g++ -std=c++20 -Wall -Wextra -pedantic -pthread -O2 main.cpp thread_pool.cpp -ltbb && ./a.out
+int main() {
+    ThreadPool pool;
+
+    std::cout << "Largest relative error compared with the standard algorithms:\n";
+    for (std::size_t n : {0, 1, 100, 1'000'003}) {
+        check_scans<int>(pool, "int", n);
+        check_scans<std::int64_t>(pool, "int64", n);
+        check_scans<float>(pool, "float", n);
+        check_scans<double>(pool, "double", n);
+    }
+
+    std::cout << "--------------------------------\n";
+    segmented_example(pool);
+
+    std::cout << "--------------------------------\n";
+    filter_example(pool);
+
+    std::cout << "--------------------------------\n";
+    histogram_example(pool);
+
+    std::cout << "--------------------------------\n";
+    std::cout << "Inclusive scan, GB/s\n";
+    std::cout << std::setw(8) << "" << std::setw(16) << "std" << std::setw(16) << "std(par)"
+              << std::setw(16) << "parallel" << std::setw(16) << "1 thread SIMD" << '\n';
+    std::cout << "16K elements (in cache):\n";
+    compare_speed<int>(pool, "int", 16 * 1024, 20'000);
+    compare_speed<double>(pool, "double", 16 * 1024, 20'000);
+    std::cout << "64M elements:\n";
+    compare_speed<int>(pool, "int", 64 * 1024 * 1024, 10);
+    compare_speed<double>(pool, "double", 64 * 1024 * 1024, 10);
+}
@@ -0,0 +1,367 @@
+/**
+ * Parallel prefix scans, and the algorithms built from them
+ *
+ * A scan looks sequential: out[i] depends on out[i - 1]. 073-new_parallel_algorithms.cpp calls
+ * std::inclusive_scan(std::execution::par, ...), but does not show how it can be parallel.
+ * With an associative operation, the input can be split into blocks and scanned in two passes:
+ * 1. Each block is reduced in parallel, giving one total per block.
+ * 2. The block totals are scanned sequentially. There are only a few of them. This gives the
+ *    value which comes before each block (its "carry").
+ * 3. Each block is scanned in parallel, starting from its carry.
+ * This reads the input twice, so it does twice as much work as a sequential scan, but the
+ * passes over the blocks run on all the cores.
+ *
+ * For sums of numbers in contiguous memory, step 3 uses SIMD instructions as well: see
+ * simd_block_scan(). Compile with -march=native to use AVX2 where the CPU has it.
+ *
+ * Built on top of the scan:
+ * - parallel_segmented_inclusive_scan(): restarts the scan at the start of each segment.
+ * - parallel_copy_if(): each block counts the elements it keeps, an exclusive scan of the counts
+ *   gives the position of each block's output, and then the blocks copy in parallel.
+ * - parallel_histogram() and histogram_to_offsets(): the counts and starting positions of the
+ *   bins, to group the elements by bin as a counting sort does.
+ *
+ * Floating-point addition is not associative, so a parallel sum of floats or doubles may differ
+ * from the sequential one in the last bits, and it may depend on the number of threads.
+ */
+
+#ifndef PARALLEL_SCAN_H
+#define PARALLEL_SCAN_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "thread_pool.h"
+
+//----------------------------------------------------------------------------------------------
+// SIMD scan of one block
+
+// A 32-byte register of T, the size of an AVX2 register (GCC/Clang vector extension). Without
+// AVX2, the compiler uses two 16-byte SSE registers.
+template <class T> struct ScanVec {
+    static constexpr int width = 32 / sizeof(T);
+    typedef T type __attribute__((vector_size(32)));
+};
+
+// Shift the lanes of v up by S: lane j gets lane j - S, and the lowest S lanes become 0.
+// Vectors are passed by reference: passing a 32-byte vector by value has a different calling
+// convention with and without AVX, and GCC warns about it.
+template <int S, class V, std::size_t... Is>
+void shift_lanes(V &v, std::index_sequence<Is...>) {
+    constexpr int width = sizeof...(Is);
+    v = __builtin_shufflevector(v, V{}, (static_cast<int>(Is) < S ? width : Is - S)...);
+}
+
+// Inclusive prefix sum within a register, in log2(width) steps:
+//     [a, b, c, d] + [0, a, b, c] = [a, a+b, b+c, c+d]
+//     [a, a+b, b+c, c+d] + [0, 0, a, a+b] = [a, a+b, a+b+c, a+b+c+d]
+template <int S, class V, std::size_t... Is>
+void scan_in_register(V &v, std::index_sequence<Is...> lanes) {
+    if constexpr (S < static_cast<int>(sizeof...(Is))) {
+        V shifted = v;
+        shift_lanes<S>(shifted, lanes);
+        v += shifted;
+        scan_in_register<2 * S>(v, lanes);
+    }
+}
+
+/**
+ * Prefix sum of in[0..n) into out[0..n), starting from "carry". Inclusive (out[i] includes in[i])
+ * or exclusive (out[i] is the sum of the elements before in[i]). Returns the total.
+ * A sequential scan is a chain of n dependent additions. Here, the chain has one addition per
+ * register; the additions inside a register are independent of the previous register.
+ */
+template <bool Inclusive, class T>
+T simd_block_scan(const T *in, T *out, std::size_t n, T carry) {
+    using V = typename ScanVec<T>::type;
+    constexpr int width = ScanVec<T>::width;
+    constexpr auto lanes = std::make_index_sequence<width>{};
+
+    std::size_t i = 0;
+    for (; i + width <= n; i += width) {
+        V v;
+        __builtin_memcpy(&v, in + i, sizeof(v));
+        scan_in_register<1>(v, lanes);
+        T total = v[width - 1];
+        if constexpr (!Inclusive)
+            shift_lanes<1>(v, lanes);
+        v += carry; // Adds carry to every lane
+        __builtin_memcpy(out + i, &v, sizeof(v));
+        carry += total;
+    }
+
+    for (; i < n; ++i) {
+        T x = in[i];
+        if constexpr (Inclusive) {
+            carry += x;
+            out[i] = carry;
+        } else {
+            out[i] = carry;
+            carry += x;
+        }
+    }
+    return carry;
+}
+
+//----------------------------------------------------------------------------------------------
+// Inclusive and exclusive scans
+
+// True if the scan of this input with this operation can use simd_block_scan()
+template <class InIt, class OutIt, class T, class BinaryOp>
+constexpr bool use_simd_scan =
+    std::contiguous_iterator<InIt> && std::contiguous_iterator<OutIt> &&
+    (std::is_same_v<BinaryOp, std::plus<>> || std::is_same_v<BinaryOp, std::plus<T>>) &&
+    std::is_arithmetic_v<T> && !std::is_same_v<T, bool> &&
+    std::is_same_v<std::iter_value_t<InIt>, T> && std::is_same_v<std::iter_value_t<OutIt>, T> &&
+    (sizeof(T) == 4 || sizeof(T) == 8);
+
+// Scan one block, starting from "carry". Safe when "out" is the same as "first".
+template <bool Inclusive, class InIt, class OutIt, class T, class BinaryOp>
+void scan_block(InIt first, InIt last, OutIt out, T carry, BinaryOp op) {
+    if constexpr (use_simd_scan<InIt, OutIt, T, BinaryOp>) {
+        simd_block_scan<Inclusive>(std::to_address(first), std::to_address(out), last - first,
+                                   carry);
+    } else {
+        for (; first != last; ++first, ++out) {
+            T x = *first;
+            if constexpr (Inclusive) {
+                carry = op(carry, x);
+                *out = carry;
+            } else {
+                *out = carry;
+                carry = op(carry, x);
+            }
+        }
+    }
+}
+
+/**
+ * The two-pass scan, for both the inclusive and the exclusive versions.
+ * "init" comes before the first element. If has_init is false, the inclusive scan starts with the
+ * first element alone, as std::inclusive_scan does without an initial value.
+ */
+template <bool Inclusive, std::random_access_iterator InIt, std::random_access_iterator OutIt,
+          class T, class BinaryOp>
+OutIt blocked_scan(ThreadPool &pool, InIt first, InIt last, OutIt out, T init, bool has_init,
+                   BinaryOp op) {
+    std::size_t n = last - first;
+    if (n == 0)
+        return out;
+
+    if (!has_init) {
+        // Use the first element as the initial value
+        init = first[0];
+        *out = init;
+        ++first, ++out, --n;
+    }
+
+    std::size_t nblocks = block_count(pool, n);
+    if (nblocks == 1) {
+        scan_block<Inclusive>(first, last, out, init, op);
+        return out + n;
+    }
+
+    // 1. The total of each block
+    std::vector<T> carries(nblocks);
+    parallel_blocks(pool, nblocks, [&](std::size_t b) {
+        InIt begin = first + block_begin(n, nblocks, b);
+        InIt end = first + block_begin(n, nblocks, b + 1);
+        if constexpr (use_simd_scan<InIt, OutIt, T, BinaryOp>) {
+            // A sum of numbers: std::reduce may add them in any order, which is faster
+            carries[b] = std::reduce(begin + 1, end, *begin);
+        } else {
+            // Any other operation need not be commutative, so keep the order
+            T total = *begin;
+            for (++begin; begin != end; ++begin)
+                total = op(total, *begin);
+            carries[b] = total;
+        }
+    });
+
+    // 2. Exclusive scan of the totals gives the carry into each block
+    T carry = init;
+    for (auto &c : carries)
+        c = std::exchange(carry, op(carry, c));
+
+    // 3. Scan each block from its carry
+    parallel_blocks(pool, nblocks, [&](std::size_t b) {
+        std::size_t begin = block_begin(n, nblocks, b), end = block_begin(n, nblocks, b + 1);
+        scan_block<Inclusive>(first + begin, first + end, out + begin, carries[b], op);
+    });
+    return out + n;
+}
+
+template <std::random_access_iterator InIt, std::random_access_iterator OutIt,
+          class BinaryOp = std::plus<>>
+OutIt parallel_inclusive_scan(ThreadPool &pool, InIt first, InIt last, OutIt out,
+                              BinaryOp op = BinaryOp{}) {
+    using T = std::iter_value_t<InIt>;
+    return blocked_scan<true>(pool, first, last, out, T{}, false, op);
+}
+
+template <std::random_access_iterator InIt, std::random_access_iterator OutIt, class BinaryOp,
+          class T>
+OutIt parallel_inclusive_scan(ThreadPool &pool, InIt first, InIt last, OutIt out, BinaryOp op,
+                              T init) {
+    return blocked_scan<true>(pool, first, last, out, init, true, op);
+}
+
+template <std::random_access_iterator InIt, std::random_access_iterator OutIt, class T,
+          class BinaryOp = std::plus<>>
+OutIt parallel_exclusive_scan(ThreadPool &pool, InIt first, InIt last, OutIt out, T init,
+                              BinaryOp op = BinaryOp{}) {
+    return blocked_scan<false>(pool, first, last, out, init, true, op);
+}
+
+//----------------------------------------------------------------------------------------------
+// Segmented scan
+
+/**
+ * Inclusive scan which starts again at every element whose flag is true:
+ *     values 1 2 3 4 5 6
+ *     flags  1 0 0 1 0 1
+ *     out    1 3 6 4 9 6
+ * The first element always starts a segment. The carry out of a block is its last value, unless
+ * the block contains no flag, in which case the carry into the block is added to it too.
+ */
+template <std::random_access_iterator InIt, std::random_access_iterator FlagIt,
+          std::random_access_iterator OutIt, class BinaryOp = std::plus<>>
+OutIt parallel_segmented_inclusive_scan(ThreadPool &pool, InIt first, InIt last, FlagIt flags,
+                                        OutIt out, BinaryOp op = BinaryOp{}) {
+    using T = std::iter_value_t<InIt>;
+    std::size_t n = last - first;
+    if (n == 0)
+        return out;
+
+    // The summary of a block: the value it passes on, and whether it starts a new segment
+    struct Summary {
+        T value;
+        bool starts_segment;
+    };
+
+    // Scan [begin, end) from "carry" (if has_carry), writing to out if Write is true.
+    // Returns the summary of the range.
+    auto scan_range = [&]<bool Write>(std::size_t begin, std::size_t end, T carry,
+                                      bool has_carry) {
+        bool starts_segment = false;
+        for (std::size_t i = begin; i < end; ++i) {
+            if (flags[i] || !has_carry) {
+                starts_segment |= static_cast<bool>(flags[i]);
+                carry = first[i];
+                has_carry = true;
+            } else {
+                carry = op(carry, first[i]);
+            }
+            if constexpr (Write)
+                out[i] = carry;
+        }
+        return Summary{carry, starts_segment};
+    };
+
+    std::size_t nblocks = block_count(pool, n);
+
+    // 1. Summarize each block
+    std::vector<Summary> summaries(nblocks);
+    parallel_blocks(pool, nblocks, [&](std::size_t b) {
+        summaries[b] = scan_range.template operator()<false>(block_begin(n, nblocks, b),
+                                                             block_begin(n, nblocks, b + 1), T{},
+                                                             false);
+    });
+
+    // 2. The carry into each block. A block with a flag ignores the carry into it.
+    std::vector<T> carries(nblocks);
+    for (std::size_t b = 1; b < nblocks; ++b) {
+        const Summary &prev = summaries[b - 1];
+        carries[b] = (b == 1 || prev.starts_segment) ? prev.value : op(carries[b - 1], prev.value);
+    }
+
+    // 3. Scan each block from its carry
+    parallel_blocks(pool, nblocks, [&](std::size_t b) {
+        scan_range.template operator()<true>(block_begin(n, nblocks, b),
+                                             block_begin(n, nblocks, b + 1), carries[b], b > 0);
+    });
+    return out + n;
+}
+
+//----------------------------------------------------------------------------------------------
+// Stream compaction
+
+/**
+ * Copy the elements for which pred is true, keeping their order, like std::copy_if.
+ * "pred" is called twice for each element (once to count, once to copy), so it must not have side
+ * effects. Returns the end of the output.
+ */
+template <std::random_access_iterator InIt, std::random_access_iterator OutIt, class Pred>
+OutIt parallel_copy_if(ThreadPool &pool, InIt first, InIt last, OutIt out, Pred pred) {
+    std::size_t n = last - first;
+    std::size_t nblocks = block_count(pool, n);
+
+    // 1. Count the elements which each block keeps
+    std::vector<std::size_t> positions(nblocks);
+    parallel_blocks(pool, nblocks, [&](std::size_t b) {
+        positions[b] = std::count_if(first + block_begin(n, nblocks, b),
+                                     first + block_begin(n, nblocks, b + 1), pred);
+    });
+
+    // 2. Where each block's output starts
+    std::size_t total = 0;
+    for (auto &pos : positions)
+        pos = std::exchange(total, total + pos);
+
+    // 3. Copy
+    parallel_blocks(pool, nblocks, [&](std::size_t b) {
+        std::copy_if(first + block_begin(n, nblocks, b), first + block_begin(n, nblocks, b + 1),
+                     out + positions[b], pred);
+    });
+    return out + total;
+}
+
+//----------------------------------------------------------------------------------------------
+// Histograms
+
+// Count the elements in each of "nbins" bins. bin(element) must be in [0, nbins).
+template <std::random_access_iterator InIt, class BinFn>
+std::vector<std::size_t> parallel_histogram(ThreadPool &pool, InIt first, InIt last,
+                                            std::size_t nbins, BinFn bin) {
+    std::size_t n = last - first;
+    std::size_t nblocks = block_count(pool, n);
+
+    // Each block counts into its own histogram, so there is no shared counter to fight over
+    std::vector<std::vector<std::size_t>> partial(nblocks, std::vector<std::size_t>(nbins));
+    parallel_blocks(pool, nblocks, [&](std::size_t b) {
+        auto &counts = partial[b];
+        for (std::size_t i = block_begin(n, nblocks, b); i < block_begin(n, nblocks, b + 1); ++i)
+            ++counts[bin(first[i])];
+    });
+
+    // Add up the partial histograms, a range of bins per task
+    std::vector<std::size_t> counts(nbins);
+    std::size_t nranges = block_count(pool, nbins);
+    parallel_blocks(pool, nranges, [&](std::size_t r) {
+        for (std::size_t k = block_begin(nbins, nranges, r);
+             k < block_begin(nbins, nranges, r + 1); ++k) {
+            for (const auto &p : partial)
+                counts[k] += p[k];
+        }
+    });
+    return counts;
+}
+
+// The position where each bin starts when the elements are grouped by bin, followed by the total:
+//     counts  3 0 2 5
+//     offsets 0 3 3 5 10
+inline std::vector<std::size_t> histogram_to_offsets(ThreadPool &pool,
+                                                     const std::vector<std::size_t> &counts) {
+    std::vector<std::size_t> offsets(counts.size() + 1);
+    parallel_exclusive_scan(pool, counts.begin(), counts.end(), offsets.begin(), std::size_t{0});
+    offsets.back() = counts.empty() ? 0 : offsets[counts.size() - 1] + counts.back();
+    return offsets;
+}
+
+#endif // PARALLEL_SCAN_H
@@ -0,0 +1,137 @@
+/**
+ * Parallel reductions whose result does not depend on the number of threads
+ *
+ * Floating-point addition is not associative: (a + b) + c and a + (b + c) can differ in the last
+ * bits. std::reduce(std::execution::par, ...) and the block sums in 069-data_parallelism.cpp add
+ * the numbers in an order which depends on how many threads there are, so the same data can give
+ * a different sum on a machine with a different number of cores.
+ *
+ * Here the order of the operations is fixed by the size of the input only:
+ * - The input is cut into chunks of chunk_size elements. chunk_size is a constant, not a function
+ *   of the number of threads.
+ * - Each chunk is reduced with 8 accumulators (element i goes to accumulator i % 8, which lets the
+ *   compiler use SIMD), and the 8 accumulators are combined in a fixed tree.
+ * - The chunk results are combined in a balanced binary tree, whose shape depends only on the
+ *   number of chunks.
+ * Threads only decide who computes which chunk, not what is computed, so the result is the same,
+ * bit for bit, with 1 thread or 64. It is also the same on any machine with IEEE 754 arithmetic,
+ * if the compiler does not change the operations: -ffast-math allows it to reassociate them, and
+ * -ffp-contract=fast (the default of GCC in GNU mode, but not with -std=c++20) allows it to fuse a
+ * multiply and an add in transform_reduce.
+ *
+ * The result is deterministic, but it is still rounded. For the exactly rounded sum, see
+ * exact_sum.h.
+ */
+
+#ifndef DETERMINISTIC_REDUCE_H
+#define DETERMINISTIC_REDUCE_H
+
+#include "thread_pool.h"
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+// Elements per chunk. Changing it changes the results (slightly), so it must be the same on every
+// machine which has to agree on them.
+constexpr std::size_t chunk_size = 4096;
+
+namespace detail {
+
+constexpr std::size_t tree_lanes = 8;
+
+// Reduce elements [begin, end) of the input, where get(i) is the transformed element i
+template <class T, class Op, class Get>
+T reduce_chunk(std::size_t begin, std::size_t end, Op &op, Get &get) {
+    std::size_t len = end - begin;
+    if (len < tree_lanes) {
+        T acc = get(begin);
+        for (std::size_t i = begin + 1; i < end; ++i)
+            acc = op(acc, get(i));
+        return acc;
+    }
+
+    T acc[tree_lanes] = {get(begin),     get(begin + 1), get(begin + 2), get(begin + 3),
+                         get(begin + 4), get(begin + 5), get(begin + 6), get(begin + 7)};
+    std::size_t i = begin + tree_lanes;
+    for (; i + tree_lanes <= end; i += tree_lanes) {
+        for (std::size_t j = 0; j < tree_lanes; ++j)
+            acc[j] = op(acc[j], get(i + j));
+    }
+    for (std::size_t j = 0; i + j < end; ++j)
+        acc[j] = op(acc[j], get(i + j));
+
+    T left = op(op(acc[0], acc[1]), op(acc[2], acc[3]));
+    T right = op(op(acc[4], acc[5]), op(acc[6], acc[7]));
+    return op(left, right);
+}
+
+// Combine values [lo, hi) in a balanced tree. The tree depends only on hi - lo.
+template <class T, class Op>
+T combine_tree(const std::vector<T> &values, std::size_t lo, std::size_t hi, Op &op) {
+    if (hi - lo == 1)
+        return values[lo];
+    std::size_t mid = lo + (hi - lo) / 2;
+    return op(combine_tree(values, lo, mid, op), combine_tree(values, mid, hi, op));
+}
+
+// Reduce get(0), ..., get(n - 1), then combine the result with init
+template <class T, class Op, class Get>
+T deterministic_reduce_indexed(ThreadPool &pool, std::size_t n, T init, Op op, Get get) {
+    if (n == 0)
+        return init;
+
+    // The threads work on blocks of whole chunks. How many blocks there are depends on the number
+    // of threads, but the chunks, and the order in which their results are combined, do not.
+    std::size_t nchunks = (n + chunk_size - 1) / chunk_size;
+    std::vector<T> chunk_results(nchunks, init);
+    std::size_t nblocks = block_count(pool, n);
+    nblocks = std::min(nblocks, nchunks);
+
+    parallel_blocks(pool, nblocks, [&](std::size_t b) {
+        std::size_t first_chunk = block_begin(nchunks, nblocks, b);
+        std::size_t last_chunk = block_begin(nchunks, nblocks, b + 1);
+        for (std::size_t c = first_chunk; c < last_chunk; ++c) {
+            std::size_t end = std::min(n, (c + 1) * chunk_size);
+            chunk_results[c] = reduce_chunk<T>(c * chunk_size, end, op, get);
+        }
+    });
+
+    return op(init, combine_tree(chunk_results, 0, nchunks, op));
+}
+
+} // namespace detail
+
+// Like std::reduce(first, last, init, op), but the result is the same with any number of threads.
+// op must be associative (up to rounding). It does not have to be commutative.
+template <std::random_access_iterator It, class T, class BinaryOp = std::plus<>>
+T deterministic_reduce(ThreadPool &pool, It first, It last, T init, BinaryOp op = {}) {
+    auto get = [first](std::size_t i) -> T { return first[i]; };
+    return detail::deterministic_reduce_indexed(pool, static_cast<std::size_t>(last - first),
+                                                init, op, get);
+}
+
+// Like std::transform_reduce(first, last, init, reduce, transform)
+template <std::random_access_iterator It, class T, class BinaryOp, class UnaryOp>
+T deterministic_transform_reduce(ThreadPool &pool, It first, It last, T init, BinaryOp reduce,
+                                 UnaryOp transform) {
+    auto get = [first, &transform](std::size_t i) -> T { return transform(first[i]); };
+    return detail::deterministic_reduce_indexed(pool, static_cast<std::size_t>(last - first),
+                                                init, reduce, get);
+}
+
+// Like std::transform_reduce(first1, last1, first2, init, reduce, transform). The default
+// operations give the inner product.
+template <std::random_access_iterator It1, std::random_access_iterator It2, class T,
+          class BinaryOp1 = std::plus<>, class BinaryOp2 = std::multiplies<>>
+T deterministic_transform_reduce(ThreadPool &pool, It1 first1, It1 last1, It2 first2, T init,
+                                 BinaryOp1 reduce = {}, BinaryOp2 transform = {}) {
+    auto get = [first1, first2, &transform](std::size_t i) -> T {
+        return transform(first1[i], first2[i]);
+    };
+    return detail::deterministic_reduce_indexed(pool, static_cast<std::size_t>(last1 - first1),
+                                                init, reduce, get);
+}
+
+#endif // DETERMINISTIC_REDUCE_H
@@ -0,0 +1,225 @@
+/**
+ * Exact sum of doubles (a "superaccumulator")
+ *
+ * Every finite double is an integer multiple of 2^-1074, the smallest subnormal number, and is
+ * smaller than 2^1024. So every double is a fixed-point number with about 2100 bits, and the sum of
+ * any number of doubles can be held exactly in a fixed-point number a little wider than that.
+ *
+ * ExactSum stores that number as 67 "digits" of 32 bits each. A double's 53-bit mantissa covers at
+ * most 3 digits, so adding a double adds 3 integers. Nothing is rounded until value() is called,
+ * and value() rounds correctly, to the nearest double.
+ *
+ * Because the sum is exact, the order of the additions does not matter: adding ExactSums together
+ * is associative and commutative, so threads can each sum a part of the data, in any order, and the
+ * result is the same, to the last bit, with any number of threads and on any machine.
+ *
+ * exact_sum() sums an array this way in parallel. It is slower than a plain sum (about 3 integer
+ * additions and some bit manipulation per element, instead of one floating-point addition), but it
+ * still runs at memory speed when it has a few threads.
+ *
+ * Carry-save: each digit is held in a 64-bit integer, but only 32 bits are used after
+ * normalize(). Each addition adds less than 2^32 to a digit, so after 2^30 additions a digit is
+ * still far from overflowing. normalize() propagates the carries then.
+ */
+
+#ifndef EXACT_SUM_H
+#define EXACT_SUM_H
+
+#include "thread_pool.h"
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <vector>
+
+class ExactSum {
+    // Digit k has the weight 2^(32 * k - 1074)
+    static constexpr int digit_bits = 32;
+    static constexpr int ndigits = 67; // 67 * 32 = 2144 bits, more than 2098 + room for carries
+    static constexpr std::int64_t digit_mask = (std::int64_t{1} << digit_bits) - 1;
+
+    // Additions before the carries must be propagated
+    static constexpr std::uint32_t max_pending = 1u << 30;
+
+    std::int64_t digits[ndigits]{};
+    std::uint32_t pending{0};
+
+    // Infinities and NaNs cannot be held as fixed-point numbers, so they are counted separately
+    bool has_nan{false};
+    bool has_pos_inf{false};
+    bool has_neg_inf{false};
+
+    // Propagate the carries, so that every digit but the top one is in [0, 2^32).
+    // The top digit holds the sign: the number is negative if it is negative.
+    void normalize() {
+        std::int64_t carry = 0;
+        for (int k = 0; k < ndigits - 1; ++k) {
+            std::int64_t d = digits[k] + carry;
+            // An arithmetic shift, so a negative digit borrows from the next one
+            carry = d >> digit_bits;
+            digits[k] = d & digit_mask;
+        }
+        digits[ndigits - 1] += carry;
+        pending = 0;
+    }
+
+  public:
+    ExactSum() = default;
+
+    void add(double x) {
+        std::uint64_t bits = std::bit_cast<std::uint64_t>(x);
+        bool negative = bits >> 63;
+        int biased_exp = static_cast<int>((bits >> 52) & 0x7FF);
+        std::uint64_t mantissa = bits & ((std::uint64_t{1} << 52) - 1);
+
+        if (biased_exp == 0x7FF) {
+            if (mantissa != 0)
+                has_nan = true;
+            else if (negative)
+                has_neg_inf = true;
+            else
+                has_pos_inf = true;
+            return;
+        }
+
+        // x = mantissa * 2^(pos - 1074), where pos is the bit position of the mantissa's lowest
+        // bit in our fixed-point number. Normal numbers have an implicit leading 1.
+        int pos = biased_exp == 0 ? 0 : biased_exp - 1;
+        if (biased_exp != 0)
+            mantissa |= std::uint64_t{1} << 52;
+        if (mantissa == 0)
+            return;
+
+        // Split the shifted mantissa into 3 digits
+        int k = pos / digit_bits, r = pos % digit_bits;
+        std::int64_t d0 = static_cast<std::int64_t>((mantissa << r) & digit_mask);
+        std::int64_t d1 = static_cast<std::int64_t>((mantissa >> (digit_bits - r)) & digit_mask);
+        std::int64_t d2 = r == 0 ? 0 : static_cast<std::int64_t>(mantissa >> (64 - r));
+        if (r == 0)
+            d1 = static_cast<std::int64_t>(mantissa >> digit_bits);
+
+        // Negate the digits without a branch: positive and negative amounts come in random order,
+        // and a mispredicted branch would cost more than the whole addition
+        std::int64_t sign = -static_cast<std::int64_t>(negative); // 0 or -1
+        digits[k] += (d0 ^ sign) - sign;
+        digits[k + 1] += (d1 ^ sign) - sign;
+        digits[k + 2] += (d2 ^ sign) - sign;
+
+        if (++pending == max_pending)
+            normalize();
+    }
+
+    // Add another partial sum. Exact, so the order in which partial sums are added does not matter.
+    void add(const ExactSum &other) {
+        ExactSum copy = other;
+        copy.normalize();
+        normalize();
+        for (int k = 0; k < ndigits; ++k)
+            digits[k] += copy.digits[k];
+        pending = 1;
+        has_nan |= other.has_nan;
+        has_pos_inf |= other.has_pos_inf;
+        has_neg_inf |= other.has_neg_inf;
+    }
+
+    // The sum, correctly rounded to the nearest double (ties to even)
+    double value() const {
+        if (has_nan || (has_pos_inf && has_neg_inf))
+            return std::numeric_limits<double>::quiet_NaN();
+        if (has_pos_inf)
+            return std::numeric_limits<double>::infinity();
+        if (has_neg_inf)
+            return -std::numeric_limits<double>::infinity();
+
+        ExactSum acc = *this;
+        acc.normalize();
+
+        // Work with the magnitude. Negating a normalized number: flip every digit, then add 1.
+        bool negative = acc.digits[ndigits - 1] < 0;
+        if (negative) {
+            for (auto &d : acc.digits)
+                d = ~d & digit_mask;
+            acc.digits[0] += 1;
+            acc.normalize();
+        }
+
+        // The highest non-zero digit
+        int top = ndigits - 1;
+        while (top >= 0 && acc.digits[top] == 0)
+            --top;
+        if (top < 0)
+            return 0.0;
+
+        // Take the 64 bits which start at the highest 1 bit. Converting them to a double rounds
+        // them to 53 bits. For the rounding to be correct, the bits below the window must still
+        // count: if any of them is 1, set the lowest bit of the window (the "sticky" bit).
+        int lead = std::bit_width(static_cast<std::uint64_t>(acc.digits[top])); // 1..32
+        int top_bit = top * digit_bits + lead;                                   // Bits in total
+        int low_bit = top_bit - 64; // Position of the window's lowest bit
+
+        std::uint64_t window = 0;
+        bool sticky = false;
+        for (int k = top; k >= 0; --k) {
+            auto d = static_cast<std::uint64_t>(acc.digits[k]);
+            int d_low = k * digit_bits; // Position of this digit's lowest bit
+            if (d_low >= low_bit) {
+                window |= d << (d_low - low_bit);
+            } else if (d_low + digit_bits > low_bit) {
+                int cut = low_bit - d_low;
+                window |= d >> cut;
+                sticky |= (d & ((std::uint64_t{1} << cut) - 1)) != 0;
+            } else {
+                sticky |= d != 0;
+            }
+        }
+        if (low_bit < 0) {
+            // The whole number fits in the window: shift it down to be exact
+            window >>= -low_bit;
+            low_bit = 0;
+        }
+        if (sticky)
+            window |= 1;
+
+        double result = std::ldexp(static_cast<double>(window), low_bit - 1074);
+        return negative ? -result : result;
+    }
+};
+
+// The sum of transform(x) for the elements x of [first, last), correctly rounded. Each block of
+// the input is summed by one task, and the block sums are added exactly, so the number of blocks
+// (which depends on the number of threads) does not change the result.
+template <std::random_access_iterator It, class UnaryOp>
+double exact_transform_sum(ThreadPool &pool, It first, It last, UnaryOp transform) {
+    std::size_t n = last - first;
+    std::size_t nblocks = block_count(pool, n);
+    std::vector<ExactSum> block_sums(nblocks);
+
+    parallel_blocks(pool, nblocks, [&](std::size_t b) {
+        // Neighbouring numbers usually have similar exponents, so they add to the same digits, and
+        // each addition would wait for the previous one. Four sums can add in parallel.
+        ExactSum sums[4];
+        std::size_t i = block_begin(n, nblocks, b), end = block_begin(n, nblocks, b + 1);
+        for (; i + 4 <= end; i += 4) {
+            for (int j = 0; j < 4; ++j)
+                sums[j].add(static_cast<double>(transform(first[i + j])));
+        }
+        for (; i < end; ++i)
+            sums[0].add(static_cast<double>(transform(first[i])));
+        for (int j = 1; j < 4; ++j)
+            sums[0].add(sums[j]);
+        block_sums[b] = sums[0];
+    });
+
+    ExactSum total;
+    for (const auto &sum : block_sums)
+        total.add(sum);
+    return total.value();
+}
+
+template <std::random_access_iterator It> double exact_sum(ThreadPool &pool, It first, It last) {
+    return exact_transform_sum(pool, first, last, [](auto x) { return x; });
+}
+
+#endif // EXACT_SUM_H
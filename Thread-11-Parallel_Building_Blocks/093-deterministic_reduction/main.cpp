@@ -0,0 +1,190 @@
+/**
+ * Reproducible parallel sums
+ *
+ * The data are the amounts of 10 million transactions: mostly small amounts with cents, some large
+ * ones, and transfers which cancel each other out. Their sum is computed:
+ * 1. The usual way, one partial sum per block. The last bits of the result change with the number
+ *    of blocks, that is with the number of threads. std::reduce(std::execution::par) gives yet
+ *    another result.
+ * 2. With deterministic_reduce(), and with exact_sum(), on pools of 1 to 8 threads. Each gives the
+ *    same bits every time. exact_sum() is also correctly rounded.
+ * 3. transform_reduce: the value of a portfolio (price * quantity), deterministic and exact.
+ * 4. Throughput of each method, in GB/s.
+ */
+
+#include "deterministic_reduce.h"
+#include "exact_sum.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <execution>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <vector>
+
+// Transaction amounts, in dollars
+std::vector<double> make_transactions(std::size_t n) {
+    std::mt19937_64 mt(2024);
+    std::lognormal_distribution<double> small(3.0, 1.5);
+    std::uniform_real_distribution<double> large(1e6, 1e9);
+    std::uniform_int_distribution<int> kind(0, 99);
+
+    std::vector<double> amounts(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        int k = kind(mt);
+        double amount = std::round(small(mt) * 100.0) / 100.0;
+        if (k == 0)
+            amount = std::round(large(mt) * 100.0) / 100.0;
+        if (k < 50)
+            amount = -amount;
+        amounts[i] = amount;
+    }
+    // Transfers: a large amount in, and the same amount out later
+    for (std::size_t i = 0; i + n / 2 < n; i += 1000) {
+        double transfer = std::round(large(mt) * 100.0) / 100.0;
+        amounts[i] = transfer;
+        amounts[i + n / 2] = -transfer;
+    }
+    return amounts;
+}
+
+// The sum as 069-data_parallelism.cpp computes it: one sequential sum per block, then the sum of
+// the block sums
+double blocked_sum(const std::vector<double> &v, std::size_t nblocks) {
+    std::vector<double> block_sums(nblocks);
+    for (std::size_t b = 0; b < nblocks; ++b) {
+        auto first = v.begin() + block_begin(v.size(), nblocks, b);
+        auto last = v.begin() + block_begin(v.size(), nblocks, b + 1);
+        block_sums[b] = std::accumulate(first, last, 0.0);
+    }
+    return std::accumulate(block_sums.begin(), block_sums.end(), 0.0);
+}
+
+void print_sum(const char *name, double sum) {
+    std::cout << std::setw(34) << name << std::setw(26) << std::fixed << std::setprecision(6)
+              << sum << "   " << std::hexfloat << sum << std::defaultfloat << '\n';
+}
+
+// 1. The result depends on how the sum is split
+void show_variation(const std::vector<double> &amounts) {
+    print_sum("std::accumulate", std::accumulate(amounts.begin(), amounts.end(), 0.0));
+    for (std::size_t nblocks : {2, 3, 4, 8, 16, 64}) {
+        std::string name = "sum of " + std::to_string(nblocks) + " block sums";
+        print_sum(name.c_str(), blocked_sum(amounts, nblocks));
+    }
+    print_sum("std::reduce(par)",
+              std::reduce(std::execution::par, amounts.begin(), amounts.end(), 0.0));
+}
+
+// 2. The same result with any number of threads
+void show_reproducible(const std::vector<double> &amounts) {
+    double exact = 0.0;
+    for (int nthreads : {0, 1, 3, 7}) {
+        // The main thread works too, so a pool of N threads computes with N + 1 threads
+        ThreadPool pool(nthreads);
+        std::string n = "threads: " + std::to_string(nthreads + 1);
+        double det = deterministic_reduce(pool, amounts.begin(), amounts.end(), 0.0);
+        exact = exact_sum(pool, amounts.begin(), amounts.end());
+        print_sum(("deterministic_reduce, " + n).c_str(), det);
+        print_sum(("exact_sum, " + n).c_str(), exact);
+    }
+
+    // Check the exact sum: the amounts are whole numbers of cents, so the sum in cents, as an
+    // integer, is exact too
+    std::int64_t cents = 0;
+    for (double a : amounts)
+        cents += std::llround(a * 100.0);
+    std::cout << "Sum in integer cents: " << cents / 100 << '.' << std::setw(2)
+              << std::setfill('0') << std::abs(cents % 100) << std::setfill(' ') << '\n';
+    std::cout << "exact_sum rounded to cents: " << std::fixed << std::setprecision(2) << exact
+              << std::defaultfloat << '\n';
+}
+
+// 3. Value of a portfolio, with transform_reduce
+void show_transform_reduce(const std::vector<double> &amounts) {
+    std::size_t n = amounts.size();
+    std::vector<double> price(n), quantity(n);
+    std::mt19937_64 mt(7);
+    std::uniform_real_distribution<double> price_dist(0.01, 5000.0);
+    std::uniform_int_distribution<int> qty_dist(-1000, 1000);
+    for (std::size_t i = 0; i < n; ++i) {
+        price[i] = price_dist(mt);
+        quantity[i] = qty_dist(mt);
+    }
+
+    for (int nthreads : {0, 3}) {
+        ThreadPool pool(nthreads);
+        std::string n = "threads: " + std::to_string(nthreads + 1);
+        double value = deterministic_transform_reduce(pool, price.begin(), price.end(),
+                                                      quantity.begin(), 0.0);
+        print_sum(("inner product, " + n).c_str(), value);
+        double abs_total = deterministic_transform_reduce(
+            pool, amounts.begin(), amounts.end(), 0.0, std::plus<>{},
+            [](double a) { return std::abs(a); });
+        print_sum(("sum of |amount|, " + n).c_str(), abs_total);
+        double exact_abs_total = exact_transform_sum(pool, amounts.begin(), amounts.end(),
+                                                     [](double a) { return std::abs(a); });
+        print_sum(("exact sum of |amount|, " + n).c_str(), exact_abs_total);
+    }
+    print_sum("std::transform_reduce(par)",
+              std::transform_reduce(std::execution::par, price.begin(), price.end(),
+                                    quantity.begin(), 0.0));
+}
+
+// 4. Throughput in GB/s of the input
+template <typename Func> double gb_per_sec(std::size_t bytes, int repeats, Func func) {
+    volatile double sink = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; ++r)
+        sink = sink + func();
+    double secs =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return bytes * repeats / secs / 1e9;
+}
+
+void compare_speed(ThreadPool &pool, const std::vector<double> &amounts, int repeats) {
+    std::size_t bytes = amounts.size() * sizeof(double);
+    auto first = amounts.begin(), last = amounts.end();
+
+    auto show = [](const char *name, double gbs) {
+        std::cout << std::setw(34) << name << std::setw(10) << std::setprecision(3) << gbs
+                  << '\n';
+    };
+    show("std::accumulate",
+         gb_per_sec(bytes, repeats, [&]() { return std::accumulate(first, last, 0.0); }));
+    show("std::reduce", gb_per_sec(bytes, repeats, [&]() { return std::reduce(first, last); }));
+    show("std::reduce(par)", gb_per_sec(bytes, repeats, [&]() {
+             return std::reduce(std::execution::par, first, last);
+         }));
+    show("deterministic_reduce", gb_per_sec(bytes, repeats, [&]() {
+             return deterministic_reduce(pool, first, last, 0.0);
+         }));
+    show("exact_sum",
+         gb_per_sec(bytes, repeats, [&]() { return exact_sum(pool, first, last); }));
+}
+
+// g++ -std=c++20 -Wall -Wextra -pedantic -pthread -O2 main.cpp thread_pool.cpp -ltbb && ./a.out
+int main() {
+    std::vector<double> amounts = make_transactions(10'000'000);
+
+    std::cout << "Sum of " << amounts.size() << " transactions\n";
+    show_variation(amounts);
+
+    std::cout << "--------------------------------\n";
+    show_reproducible(amounts);
+
+    std::cout << "--------------------------------\n";
+    show_transform_reduce(amounts);
+
+    std::cout << "--------------------------------\n";
+    ThreadPool pool;
+    std::cout << "GB/s, with " << pool.size() + 1 << " threads\n";
+    std::cout << "16K elements (in cache):\n";
+    std::vector<double> small(amounts.begin(), amounts.begin() + 16 * 1024);
+    compare_speed(pool, small, 20'000);
+    std::cout << "10M elements:\n";
+    compare_speed(pool, amounts, 20);
+}
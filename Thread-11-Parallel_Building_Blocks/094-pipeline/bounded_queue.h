@@ -0,0 +1,114 @@
+/**
+ * Bounded lock-free queue, for any number of producers and consumers
+ *
+ * 061-lock_free_programming_lock_free_queue.cpp showed how hard it is to write a lock-free queue on
+ * top of std::list: the iterators cannot be atomic. This queue is Dmitry Vyukov's bounded MPMC
+ * queue, which avoids the problem by using a fixed array of cells instead of a linked list:
+ * - Each cell has a sequence number, which says whether the cell is ready to be written or read,
+ *   and in which "lap" around the array.
+ * - A producer claims the next cell to write with a compare-and-swap on enqueue_pos, writes the
+ *   value, then publishes it by storing the new sequence number (release). A consumer does the same
+ *   with dequeue_pos, and the sequence number it loads (acquire) tells it that the value is there.
+ * - No memory is allocated after construction, and producers and consumers only contend on their
+ *   own position counter.
+ *
+ * try_push() and try_pop() never wait: they return false if the queue is full or empty. The
+ * caller decides how to wait (see Backoff in pipeline.h).
+ *
+ * close() tells the consumers that no more values will be pushed. A consumer which reads closed()
+ * as true, and then fails to pop, knows that the queue will stay empty.
+ */
+
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+template <class T> class BoundedQueue {
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    std::size_t mask;
+
+    // On separate cache lines, so that producers and consumers do not slow each other down
+    alignas(64) std::atomic<std::size_t> enqueue_pos{0};
+    alignas(64) std::atomic<std::size_t> dequeue_pos{0};
+    alignas(64) std::atomic<bool> is_closed{false};
+
+  public:
+    // The capacity is rounded up to a power of 2, so that a position is turned into an index with
+    // a mask instead of a division
+    explicit BoundedQueue(std::size_t min_capacity)
+        : cells(std::make_unique<Cell[]>(std::bit_ceil(std::max<std::size_t>(min_capacity, 2)))),
+          mask(std::bit_ceil(std::max<std::size_t>(min_capacity, 2)) - 1) {
+        for (std::size_t i = 0; i <= mask; ++i)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    BoundedQueue(const BoundedQueue &) = delete;
+    BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+    std::size_t capacity() const { return mask + 1; }
+
+    // Returns false, and leaves value alone, if the queue is full
+    bool try_push(T &&value) {
+        std::size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            Cell &cell = cells[pos & mask];
+            std::size_t seq = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                // The cell is free in this lap. Claim it, unless another producer was faster.
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                // The cell still holds a value from the previous lap: the queue is full
+                return false;
+            } else {
+                // Another producer has taken this position
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Returns false if the queue is empty
+    bool try_pop(T &value) {
+        std::size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            Cell &cell = cells[pos & mask];
+            std::size_t seq = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = std::move(cell.value);
+                    // Free the cell for the producers' next lap
+                    cell.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                // The cell has not been written in this lap: the queue is empty
+                return false;
+            } else {
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Called by the producers when they have pushed their last value
+    void close() { is_closed.store(true, std::memory_order_release); }
+
+    bool closed() const { return is_closed.load(std::memory_order_acquire); }
+};
+
+#endif // BOUNDED_QUEUE_H
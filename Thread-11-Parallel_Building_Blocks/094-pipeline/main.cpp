@@ -0,0 +1,317 @@
+/**
+ * Log ingest with a pipeline
+ *
+ *     read -> parse -> transform -> write
+ *
+ * - read:      one line of the log at a time (serial: a file is read in order).
+ * - parse:     split the line into a record. Malformed lines are dropped. (parallel)
+ * - transform: drop DEBUG records, anonymize the client address, replace the numbers in the path
+ *              by ":id", and format the record as a line of JSON. (parallel)
+ * - write:     append the line to the output. (serial)
+ *
+ * The log is generated in memory, so that the run measures the pipeline and not the disk.
+ *
+ * 1. The pipeline's output is compared with a sequential loop which calls the same functions.
+ * 2. The same pipeline with the output in any order, and with a parallel_ordered transform stage.
+ * 3. The effect of the token limit.
+ * 4. An exception in a stage stops the pipeline and is rethrown by run().
+ *
+ * The number of lines can be given on the command line (1 million by default):
+ *     ./a.out 5000000
+ */
+
+#include "pipeline.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class Level { debug, info, warning, error };
+
+struct LogRecord {
+    std::int64_t time_ms; // Milliseconds since 1970
+    Level level;
+    std::string service;
+    std::uint32_t client_ip;
+    std::string method;
+    std::string path;
+    int status;
+    int latency_ms;
+};
+
+// A log line looks like this:
+// 2024-05-01T12:34:56.789Z INFO api-gateway 10.0.3.17 GET /orders/12345 200 17ms
+std::string make_log(std::size_t nlines) {
+    const char *levels[] = {"DEBUG", "INFO", "INFO", "INFO", "WARN", "ERROR"};
+    const char *services[] = {"api-gateway", "orders", "payments", "inventory", "auth"};
+    const char *methods[] = {"GET", "GET", "GET", "POST", "PUT", "DELETE"};
+    const char *paths[] = {"/orders/", "/customers/", "/items/", "/login", "/cart/"};
+
+    std::mt19937 mt(42);
+    std::ostringstream os;
+    std::int64_t ms = 0;
+    for (std::size_t i = 0; i < nlines; ++i) {
+        ms += mt() % 50;
+        if (mt() % 500 == 0) {
+            os << "--- log rotated ---\n"; // Malformed: dropped by the parser
+            continue;
+        }
+        std::int64_t secs = ms / 1000;
+        os << "2024-05-01T" << std::setfill('0') << std::setw(2) << (secs / 3600) % 24 << ':'
+           << std::setw(2) << (secs / 60) % 60 << ':' << std::setw(2) << secs % 60 << '.'
+           << std::setw(3) << ms % 1000 << std::setfill(' ') << "Z " << levels[mt() % 6] << ' '
+           << services[mt() % 5] << " 10." << mt() % 256 << '.' << mt() % 256 << '.'
+           << mt() % 256 << ' ' << methods[mt() % 6];
+        const char *path = paths[mt() % 5];
+        os << ' ' << path;
+        if (std::string_view(path).ends_with('/'))
+            os << mt() % 100000;
+        os << ' ' << (mt() % 10 == 0 ? 500 : 200) << ' ' << mt() % 300 << "ms\n";
+    }
+    return os.str();
+}
+
+// Split off the next field, up to a space
+std::string_view next_field(std::string_view &line) {
+    auto end = line.find(' ');
+    std::string_view field = line.substr(0, end);
+    line.remove_prefix(end == std::string_view::npos ? line.size() : end + 1);
+    return field;
+}
+
+template <class T> bool parse_number(std::string_view text, T &value) {
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc{} && ptr == text.data() + text.size();
+}
+
+std::optional<LogRecord> parse(std::string line) {
+    std::string_view rest = line;
+    std::string_view time = next_field(rest), level = next_field(rest),
+                     service = next_field(rest), ip = next_field(rest),
+                     method = next_field(rest), path = next_field(rest),
+                     status = next_field(rest), latency = next_field(rest);
+    if (time.size() != 24 || latency.size() < 3 || !latency.ends_with("ms"))
+        return std::nullopt;
+
+    LogRecord rec;
+    int year, month, day, hour, minute, second, milli;
+    if (!parse_number(time.substr(0, 4), year) || !parse_number(time.substr(5, 2), month) ||
+        !parse_number(time.substr(8, 2), day) || !parse_number(time.substr(11, 2), hour) ||
+        !parse_number(time.substr(14, 2), minute) || !parse_number(time.substr(17, 2), second) ||
+        !parse_number(time.substr(20, 3), milli))
+        return std::nullopt;
+    std::chrono::sys_days date = std::chrono::year{year} / month / day;
+    rec.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      date.time_since_epoch() + std::chrono::hours{hour} +
+                      std::chrono::minutes{minute} + std::chrono::seconds{second})
+                      .count() +
+                  milli;
+
+    if (level == "DEBUG")
+        rec.level = Level::debug;
+    else if (level == "INFO")
+        rec.level = Level::info;
+    else if (level == "WARN")
+        rec.level = Level::warning;
+    else if (level == "ERROR")
+        rec.level = Level::error;
+    else
+        return std::nullopt;
+
+    rec.client_ip = 0;
+    for (int i = 0; i < 4; ++i) {
+        auto dot = ip.find('.');
+        unsigned byte;
+        if (!parse_number(ip.substr(0, dot), byte) || byte > 255)
+            return std::nullopt;
+        rec.client_ip = rec.client_ip << 8 | byte;
+        ip.remove_prefix(dot == std::string_view::npos ? ip.size() : dot + 1);
+    }
+
+    rec.service = service;
+    rec.method = method;
+    rec.path = path;
+    latency.remove_suffix(2);
+    if (!parse_number(status, rec.status) || !parse_number(latency, rec.latency_ms))
+        return std::nullopt;
+    return rec;
+}
+
+// Replace the address by a keyed hash of it, so that requests from the same client can still be
+// grouped, but the address cannot be read back. (Several rounds, so that it costs some time, as a
+// real keyed hash would.)
+std::uint64_t anonymize(std::uint32_t ip) {
+    std::uint64_t h = ip ^ 0x5DEECE66DULL;
+    for (int round = 0; round < 64; ++round) {
+        h += 0x9E3779B97F4A7C15ULL;
+        h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+        h ^= h >> 31;
+    }
+    return h;
+}
+
+std::optional<std::string> transform(LogRecord rec) {
+    if (rec.level == Level::debug)
+        return std::nullopt;
+
+    // "/orders/12345" -> "/orders/:id"
+    std::string route;
+    for (std::size_t i = 0; i < rec.path.size();) {
+        if (std::isdigit(static_cast<unsigned char>(rec.path[i]))) {
+            route += ":id";
+            while (i < rec.path.size() && std::isdigit(static_cast<unsigned char>(rec.path[i])))
+                ++i;
+        } else {
+            route += rec.path[i++];
+        }
+    }
+
+    const char *level_names[] = {"debug", "info", "warning", "error"};
+    std::ostringstream os;
+    os << "{\"t\":" << rec.time_ms << ",\"level\":\"" << level_names[static_cast<int>(rec.level)]
+       << "\",\"service\":\"" << rec.service << "\",\"client\":\"" << std::hex
+       << anonymize(rec.client_ip) << std::dec << "\",\"route\":\"" << rec.method << ' ' << route
+       << "\",\"status\":" << rec.status << ",\"latency_ms\":" << rec.latency_ms << "}\n";
+    return os.str();
+}
+
+// Read the log one line at a time, as from a file
+class LineReader {
+    std::istringstream is;
+
+  public:
+    explicit LineReader(const std::string &text) : is(text) {}
+
+    std::optional<std::string> operator()() {
+        std::string line;
+        if (!std::getline(is, line))
+            return std::nullopt;
+        return line;
+    }
+};
+
+std::string run_sequential(const std::string &log) {
+    LineReader read(log);
+    std::string output;
+    while (auto line = read()) {
+        if (auto rec = parse(std::move(*line))) {
+            if (auto json = transform(std::move(*rec)))
+                output += *json;
+        }
+    }
+    return output;
+}
+
+// Run the log through a pipeline, and return the output
+std::string run_pipeline(const std::string &log, std::size_t tokens, int nthreads,
+                         StageKind transform_kind, StageKind write_kind, bool show_metrics) {
+    LineReader read(log);
+    std::string output;
+
+    Pipeline pipeline(tokens);
+    pipeline.source("read", std::ref(read))
+        .stage("parse", StageKind::parallel, nthreads, parse)
+        .stage("transform", transform_kind, nthreads, transform)
+        .sink("write", write_kind, [&output](std::string json) { output += json; });
+    pipeline.run();
+
+    if (show_metrics)
+        pipeline.print_metrics(std::cout);
+    return output;
+}
+
+// Sort the lines of a text, to compare two outputs whose lines may be in different orders
+std::vector<std::string_view> sorted_lines(const std::string &text) {
+    std::vector<std::string_view> lines;
+    std::string_view rest = text;
+    while (!rest.empty()) {
+        auto end = rest.find('\n');
+        lines.push_back(rest.substr(0, end));
+        rest.remove_prefix(end + 1);
+    }
+    std::sort(lines.begin(), lines.end());
+    return lines;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// g++ -std=c++20 -Wall -Wextra -pedantic -pthread -O2 main.cpp pipeline.cpp && ./a.out
+int main(int argc, char *argv[]) {
+    std::size_t nlines = argc > 1 ? std::stoull(argv[1]) : 1'000'000;
+    int nthreads = static_cast<int>(std::max(2u, std::thread::hardware_concurrency()));
+
+    std::cout << "Generating " << nlines << " log lines\n";
+    std::string log = make_log(nlines);
+
+    auto start = std::chrono::steady_clock::now();
+    std::string expected = run_sequential(log);
+    std::cout << "Sequential: " << std::fixed << std::setprecision(3) << seconds_since(start)
+              << " s" << std::defaultfloat << '\n';
+
+    // 1. In order
+    std::cout << "--------------------------------\n";
+    std::cout << "Pipeline, " << nthreads << " threads per parallel stage, output in order:\n";
+    std::string output = run_pipeline(log, 64, nthreads, StageKind::parallel,
+                                      StageKind::serial_in_order, true);
+    std::cout << "Output: " << (output == expected ? "same as sequential" : "WRONG") << '\n';
+
+    // 2. In any order, and ordered by the transform stage
+    std::cout << "--------------------------------\n";
+    std::cout << "Output in any order:\n";
+    output = run_pipeline(log, 64, nthreads, StageKind::parallel, StageKind::serial_out_of_order,
+                          true);
+    std::cout << "Output: "
+              << (sorted_lines(output) == sorted_lines(expected) ? "same lines as sequential"
+                                                                 : "WRONG")
+              << '\n';
+
+    std::cout << "--------------------------------\n";
+    std::cout << "Transform stage parallel_ordered, write stage out of order:\n";
+    output = run_pipeline(log, 64, nthreads, StageKind::parallel_ordered,
+                          StageKind::serial_out_of_order, true);
+    std::cout << "Output: " << (output == expected ? "same as sequential" : "WRONG") << '\n';
+
+    // 3. Too few tokens leave the stages without work
+    std::cout << "--------------------------------\n";
+    std::cout << "Token limit:\n";
+    for (std::size_t tokens : {1, 2, 4, 16, 64, 256, 1024}) {
+        start = std::chrono::steady_clock::now();
+        output = run_pipeline(log, tokens, nthreads, StageKind::parallel,
+                              StageKind::serial_in_order, false);
+        std::cout << std::setw(6) << tokens << " tokens: " << std::fixed << std::setprecision(3)
+                  << seconds_since(start) << " s" << std::defaultfloat
+                  << (output == expected ? "" : "   WRONG") << '\n';
+    }
+
+    // 4. Errors
+    std::cout << "--------------------------------\n";
+    try {
+        LineReader read(log);
+        std::size_t written = 0;
+        Pipeline pipeline(64);
+        pipeline.source("read", std::ref(read))
+            .stage("parse", StageKind::parallel, nthreads,
+                   [](std::string line) {
+                       if (line.find("/login") != std::string::npos &&
+                           line.find(" 500 ") != std::string::npos)
+                           throw std::runtime_error("Failed login: " + line);
+                       return parse(std::move(line));
+                   })
+            .sink("count", StageKind::serial_out_of_order, [&written](LogRecord) { ++written; });
+        pipeline.run();
+    } catch (const std::exception &e) {
+        std::cout << "Exception from the pipeline: " << e.what() << '\n';
+    }
+}
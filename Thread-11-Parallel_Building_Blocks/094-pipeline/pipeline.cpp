@@ -0,0 +1,125 @@
+/**
+ * Pipeline implementation
+ */
+
+#include "pipeline.h"
+
+#include <algorithm>
+#include <iomanip>
+
+const char *kind_name(StageKind kind) {
+    switch (kind) {
+    case StageKind::serial_in_order:
+        return "serial in order";
+    case StageKind::serial_out_of_order:
+        return "serial out of order";
+    case StageKind::parallel:
+        return "parallel";
+    case StageKind::parallel_ordered:
+        return "parallel ordered";
+    }
+    return "?";
+}
+
+StageBase::StageBase(Pipeline &pipeline, std::string name, StageKind kind, int nthreads)
+    : pipeline(pipeline), name(std::move(name)), kind(kind), nthreads(nthreads),
+      active(nthreads) {}
+
+void StageBase::finish_worker(std::uint64_t nitems, std::uint64_t ndropped,
+                              std::int64_t nbusy_ns) {
+    items.fetch_add(nitems, std::memory_order_relaxed);
+    dropped.fetch_add(ndropped, std::memory_order_relaxed);
+    busy_ns.fetch_add(nbusy_ns, std::memory_order_relaxed);
+
+    // acq_rel: the last worker must see every other worker's pushes before it closes the queue,
+    // so that a consumer which sees the queue closed also sees everything that was pushed
+    if (active.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        end_ns.store(pipeline.elapsed_ns(), std::memory_order_relaxed);
+        close_output();
+    }
+}
+
+StageMetrics StageBase::metrics() const {
+    return {name,
+            kind,
+            nthreads,
+            items.load(),
+            dropped.load(),
+            static_cast<double>(busy_ns.load()) / 1e9,
+            static_cast<double>(end_ns.load()) / 1e9};
+}
+
+Pipeline::Pipeline(std::size_t max_tokens) : max_tokens(max_tokens) {
+    if (max_tokens == 0)
+        throw std::invalid_argument("A pipeline needs at least one token");
+}
+
+bool Pipeline::try_acquire_token() {
+    // Only the source takes tokens, so nothing can take one between the check and the increment
+    if (in_flight.load(std::memory_order_acquire) >= max_tokens)
+        return false;
+    std::size_t now_in_flight = in_flight.fetch_add(1, std::memory_order_relaxed) + 1;
+    peak_tokens = std::max(peak_tokens, now_in_flight);
+    return true;
+}
+
+void Pipeline::fail(std::exception_ptr eptr) {
+    std::lock_guard<std::mutex> lck_guard(error_mut);
+    if (!error)
+        error = eptr;
+    cancelled.store(true, std::memory_order_relaxed);
+}
+
+void Pipeline::run() {
+    if (!has_source || !has_sink)
+        throw std::logic_error("A pipeline needs a source and a sink");
+    if (has_run)
+        throw std::logic_error("A pipeline can only be run once");
+    has_run = true;
+
+    start_time = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (auto &stage : stages) {
+        for (int t = 0; t < stage->thread_count(); ++t)
+            threads.emplace_back([&stage]() { stage->work(); });
+    }
+    for (auto &thr : threads)
+        thr.join();
+
+    run_secs = static_cast<double>(elapsed_ns()) / 1e9;
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+std::vector<StageMetrics> Pipeline::metrics() const {
+    std::vector<StageMetrics> result;
+    for (auto &stage : stages)
+        result.push_back(stage->metrics());
+    return result;
+}
+
+void Pipeline::print_metrics(std::ostream &os) const {
+    auto all = metrics();
+
+    // The bottleneck is the stage with the lowest capacity
+    auto bottleneck = std::min_element(all.begin(), all.end(), [](auto &a, auto &b) {
+        return a.capacity() < b.capacity();
+    });
+
+    os << std::left << std::setw(12) << "stage" << std::setw(21) << "kind" << std::right
+       << std::setw(8) << "threads" << std::setw(10) << "items" << std::setw(10) << "dropped"
+       << std::setw(10) << "busy s" << std::setw(8) << "util" << std::setw(12) << "items/s"
+       << std::setw(14) << "capacity/s" << '\n';
+    for (auto it = all.begin(); it != all.end(); ++it) {
+        os << std::left << std::setw(12) << it->name << std::setw(21) << kind_name(it->kind)
+           << std::right << std::setw(8) << it->threads << std::setw(10) << it->items
+           << std::setw(10) << it->dropped << std::fixed << std::setprecision(3) << std::setw(10)
+           << it->busy_secs << std::setprecision(0) << std::setw(7) << it->utilization() * 100
+           << '%' << std::setw(12) << it->throughput() << std::setw(14) << it->capacity()
+           << std::defaultfloat << (it == bottleneck ? "  <- bottleneck" : "") << '\n';
+    }
+    os << "Total " << std::fixed << std::setprecision(3) << run_secs << " s, at most "
+       << peak_tokens << " of " << max_tokens << " tokens in use" << std::defaultfloat << '\n';
+}
@@ -0,0 +1,483 @@
+/**
+ * Pipeline parallelism
+ *
+ * 069-data_parallelism.cpp describes pipeline parallelism: a task is divided into stages, and the
+ * stages work at the same time, each on a different item. A log-ingest job is a typical pipeline:
+ *     read a line -> parse it -> transform the record -> write it out
+ * While one line is written, the next ones are being transformed and parsed.
+ *
+ * A Pipeline is built from a source, any number of stages and a sink:
+ *     Pipeline pipeline(max_tokens);
+ *     pipeline.source("read", read_line)                       // () -> std::optional<A>
+ *         .stage("parse", StageKind::parallel, 4, parse)       // A -> B, or A -> std::optional<B>
+ *         .sink("write", StageKind::serial_in_order, write);   // B -> void
+ *     pipeline.run();
+ *
+ * - The source returns std::nullopt when there is no more input.
+ * - A stage which returns std::optional<B> can drop an item by returning std::nullopt (a filter).
+ * - The types are checked when the pipeline is built: each stage must accept what the previous
+ *   one returns.
+ *
+ * Each stage runs on its own threads: one for a serial stage, as many as asked for a parallel
+ * stage. (The work-stealing pool of 091-parallel_sort is not used: pipeline stages wait for their
+ * input, and a fork-join pool expects its tasks to run to the end without waiting.) The stages are
+ * connected by lock-free bounded queues (bounded_queue.h).
+ *
+ * Stage kinds:
+ * - serial_in_order:     one thread, which takes the items in the order in which the source
+ *                        produced them. Use it for output which must be in input order.
+ * - serial_out_of_order: one thread, which takes the items in the order they arrive.
+ * - parallel:            several threads. An item is passed on as soon as it is done, so a fast
+ *                        item can overtake a slow one.
+ * - parallel_ordered:    several threads, but the items are passed on in the source's order.
+ * Items which must come out in order wait in a reorder buffer for the items before them.
+ *
+ * Tokens: at most max_tokens items are in the pipeline at any time. The source must take a token
+ * for each item, and the sink gives it back. Without a limit, a fast source would fill memory with
+ * items that a slow stage cannot keep up with. With too few tokens, the stages run out of work.
+ * Because no more than max_tokens items exist, every queue and reorder buffer has room for
+ * max_tokens items, and a push never fails for lack of room.
+ *
+ * Every stage measures the number of items, the number dropped, and the time spent in the stage
+ * function. Pipeline::print_metrics() shows them, with each stage's capacity: the number of items
+ * per second the stage could handle if it never had to wait. The stage with the lowest capacity is
+ * the bottleneck, and is the one to make parallel or faster.
+ *
+ * If a stage throws, the source stops, the items which are already in the pipeline go through
+ * without being processed, and run() rethrows the first exception.
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "bounded_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+enum class StageKind { serial_in_order, serial_out_of_order, parallel, parallel_ordered };
+
+const char *kind_name(StageKind kind);
+
+// What one stage did in a run
+struct StageMetrics {
+    std::string name;
+    StageKind kind;
+    int threads;
+    std::uint64_t items;   // Items which the stage processed
+    std::uint64_t dropped; // Items which the stage filtered out
+    double busy_secs;      // Time in the stage function, added over the stage's threads
+    double wall_secs;      // From the start of the run to the stage's last item
+
+    // Items per second
+    double throughput() const { return wall_secs > 0.0 ? items / wall_secs : 0.0; }
+    // Items per second if the stage never had to wait for input or room
+    double capacity() const { return busy_secs > 0.0 ? items * threads / busy_secs : 0.0; }
+    // Fraction of its threads' time the stage spent working
+    double utilization() const {
+        return wall_secs > 0.0 ? busy_secs / (wall_secs * threads) : 0.0;
+    }
+};
+
+// An item on its way through the pipeline. seq is its position in the source's output, used to put
+// the items back in order. A dropped item keeps travelling with no value, so that the stages which
+// put items in order do not wait for it forever, and so that the sink can give its token back.
+template <class T> struct Token {
+    std::uint64_t seq{0};
+    std::optional<T> value;
+};
+
+// How a thread waits for a queue: try again at once a few times, then let other threads run, then
+// sleep. A stage waiting for a slow source sleeps instead of burning a core.
+class Backoff {
+    int count{0};
+
+  public:
+    void pause() {
+        if (++count < 16)
+            return;
+        if (count < 1000)
+            std::this_thread::yield();
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    void reset() { count = 0; }
+};
+
+class Pipeline;
+
+class StageBase {
+  protected:
+    Pipeline &pipeline;
+    std::string name;
+    StageKind kind;
+    int nthreads;
+
+    // Workers still running. The last one to finish closes the output queue.
+    std::atomic<int> active;
+
+    std::atomic<std::uint64_t> items{0};
+    std::atomic<std::uint64_t> dropped{0};
+    std::atomic<std::int64_t> busy_ns{0};
+    std::atomic<std::int64_t> end_ns{0};
+
+    // Add one worker's counts, and close the output if it is the last worker
+    void finish_worker(std::uint64_t nitems, std::uint64_t ndropped, std::int64_t nbusy_ns);
+    virtual void close_output() = 0;
+
+  public:
+    StageBase(Pipeline &pipeline, std::string name, StageKind kind, int nthreads);
+    virtual ~StageBase() = default;
+
+    int thread_count() const { return nthreads; }
+
+    // The body of each of the stage's threads
+    virtual void work() = 0;
+
+    StageMetrics metrics() const;
+};
+
+template <class T> class PipelineBuilder;
+
+// The type of the items a stage passes on: U for a stage function which returns U or
+// std::optional<U>
+template <class R> struct StageOutput {
+    using type = R;
+};
+template <class U> struct StageOutput<std::optional<U>> {
+    using type = U;
+};
+
+class Pipeline {
+    template <class T> friend class PipelineBuilder;
+    template <class Out, class F> friend class SourceStage;
+    template <class In, class Out, class F> friend class Stage;
+    friend class StageBase;
+
+    std::size_t max_tokens;
+    std::vector<std::unique_ptr<StageBase>> stages;
+    bool has_source{false};
+    bool has_sink{false};
+    bool has_run{false};
+
+    // Items between the source and the sink
+    alignas(64) std::atomic<std::size_t> in_flight{0};
+    std::size_t peak_tokens{0}; // Only written by the source's thread
+
+    std::atomic<bool> cancelled{false};
+    std::mutex error_mut;
+    std::exception_ptr error;
+
+    std::chrono::steady_clock::time_point start_time;
+    double run_secs{0.0};
+
+    // Called by the source. Returns false if all the tokens are in use.
+    bool try_acquire_token();
+    // Called by the sink
+    void release_token() { in_flight.fetch_sub(1, std::memory_order_release); }
+
+    // Record the first exception, and stop the source
+    void fail(std::exception_ptr eptr);
+    bool is_cancelled() const { return cancelled.load(std::memory_order_relaxed); }
+
+    std::int64_t elapsed_ns() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now() - start_time)
+            .count();
+    }
+
+  public:
+    explicit Pipeline(std::size_t max_tokens);
+
+    Pipeline(const Pipeline &) = delete;
+    Pipeline &operator=(const Pipeline &) = delete;
+
+    // func: () -> std::optional<T>. It is only ever called by one thread.
+    template <class F> auto source(std::string name, F func);
+
+    // Start all the stages' threads, and wait until every item has reached the sink.
+    // Rethrows the first exception thrown by a stage.
+    void run();
+
+    std::size_t token_limit() const { return max_tokens; }
+    // The largest number of items which were in the pipeline at once
+    std::size_t peak_in_flight() const { return peak_tokens; }
+    double elapsed_secs() const { return run_secs; }
+
+    std::vector<StageMetrics> metrics() const;
+    void print_metrics(std::ostream &os) const;
+};
+
+// Buffer for items which arrive out of order. Items are put in by sequence number, and taken out
+// in order. Since at most max_tokens items are in the pipeline, and every item between the next
+// one to take and the newest one is still in the pipeline, max_tokens slots are enough.
+template <class T> class ReorderBuffer {
+    std::vector<std::optional<Token<T>>> slots;
+    std::uint64_t next_seq{0};
+
+  public:
+    explicit ReorderBuffer(std::size_t size) : slots(size) {}
+
+    void put(Token<T> &&token) { slots[token.seq % slots.size()] = std::move(token); }
+
+    // Take the next item in order, if it has arrived
+    std::optional<Token<T>> take_next() {
+        auto &slot = slots[next_seq % slots.size()];
+        if (!slot || slot->seq != next_seq)
+            return std::nullopt;
+        std::optional<Token<T>> token = std::move(slot);
+        slot.reset();
+        ++next_seq;
+        return token;
+    }
+};
+
+// Push, waiting if the queue is full (which it can only be for a moment: see "Tokens" above)
+template <class T> void push_waiting(BoundedQueue<Token<T>> &queue, Token<T> &&token) {
+    Backoff backoff;
+    while (!queue.try_push(std::move(token)))
+        backoff.pause();
+}
+
+// The first stage: calls func() until it returns std::nullopt
+template <class Out, class F> class SourceStage : public StageBase {
+    F func;
+    BoundedQueue<Token<Out>> output;
+
+    void close_output() override { output.close(); }
+
+  public:
+    SourceStage(Pipeline &pipeline, std::string name, F func)
+        : StageBase(pipeline, std::move(name), StageKind::serial_in_order, 1),
+          func(std::move(func)), output(pipeline.max_tokens) {}
+
+    BoundedQueue<Token<Out>> &out() { return output; }
+
+    void work() override {
+        std::uint64_t seq = 0, nitems = 0;
+        std::int64_t nbusy_ns = 0;
+        Backoff backoff;
+
+        while (!pipeline.is_cancelled()) {
+            while (!pipeline.try_acquire_token())
+                backoff.pause();
+            backoff.reset();
+
+            auto start = std::chrono::steady_clock::now();
+            std::optional<Out> value;
+            try {
+                value = func();
+            } catch (...) {
+                pipeline.fail(std::current_exception());
+            }
+            nbusy_ns += (std::chrono::steady_clock::now() - start).count();
+
+            if (!value) {
+                // End of the input (or an error): this token is not needed
+                pipeline.release_token();
+                break;
+            }
+            push_waiting(output, Token<Out>{seq++, std::move(value)});
+            ++nitems;
+        }
+        finish_worker(nitems, 0, nbusy_ns);
+    }
+};
+
+// A stage from In to Out. If Out is void, the stage is the sink.
+template <class In, class Out, class F> class Stage : public StageBase {
+    static constexpr bool is_sink = std::is_void_v<Out>;
+    // A sink has no output, but the members below need a type
+    using Value = std::conditional_t<is_sink, char, Out>;
+    using OutQueue = BoundedQueue<Token<Value>>;
+
+    F func;
+    BoundedQueue<Token<In>> &input;
+    std::unique_ptr<OutQueue> output;
+
+    // parallel_ordered only: the workers' results wait here to be passed on in order
+    std::mutex reorder_mut;
+    std::unique_ptr<ReorderBuffer<Value>> reorder;
+
+    void close_output() override {
+        if constexpr (!is_sink)
+            output->close();
+    }
+
+    // Run func on one item and pass the result on
+    void process(Token<In> &&token, std::uint64_t &nitems, std::uint64_t &ndropped,
+                 std::int64_t &nbusy_ns) {
+        if constexpr (is_sink) {
+            if (token.value && !pipeline.is_cancelled()) {
+                auto start = std::chrono::steady_clock::now();
+                try {
+                    func(std::move(*token.value));
+                } catch (...) {
+                    pipeline.fail(std::current_exception());
+                }
+                nbusy_ns += (std::chrono::steady_clock::now() - start).count();
+                ++nitems;
+            }
+            pipeline.release_token();
+        } else {
+            Token<Value> result{token.seq, std::nullopt};
+            if (token.value && !pipeline.is_cancelled()) {
+                auto start = std::chrono::steady_clock::now();
+                try {
+                    result.value = func(std::move(*token.value));
+                } catch (...) {
+                    pipeline.fail(std::current_exception());
+                }
+                nbusy_ns += (std::chrono::steady_clock::now() - start).count();
+                ++nitems;
+                if (!result.value)
+                    ++ndropped;
+            }
+            pass_on(std::move(result));
+        }
+    }
+
+    void pass_on(Token<Value> &&result) {
+        if (kind != StageKind::parallel_ordered) {
+            push_waiting(*output, std::move(result));
+            return;
+        }
+        // Whichever worker completes the next item in order passes on every item that was
+        // waiting for it
+        std::lock_guard<std::mutex> lck_guard(reorder_mut);
+        reorder->put(std::move(result));
+        while (auto next = reorder->take_next())
+            push_waiting(*output, std::move(*next));
+    }
+
+  public:
+    Stage(Pipeline &pipeline, std::string name, StageKind kind, int nthreads, F func,
+          BoundedQueue<Token<In>> &input)
+        : StageBase(pipeline, std::move(name), kind, nthreads), func(std::move(func)),
+          input(input) {
+        if constexpr (!is_sink)
+            output = std::make_unique<OutQueue>(pipeline.max_tokens);
+        if (kind == StageKind::parallel_ordered)
+            reorder = std::make_unique<ReorderBuffer<Value>>(pipeline.max_tokens);
+    }
+
+    OutQueue &out() { return *output; }
+
+    void work() override {
+        std::uint64_t nitems = 0, ndropped = 0;
+        std::int64_t nbusy_ns = 0;
+        Backoff backoff;
+
+        std::optional<ReorderBuffer<In>> in_order;
+        if (kind == StageKind::serial_in_order)
+            in_order.emplace(pipeline.max_tokens);
+
+        Token<In> token;
+        while (true) {
+            // Read closed() before trying to pop: if the queue was closed before an attempt to
+            // pop failed, the queue is empty for good
+            bool closed = input.closed();
+            if (!input.try_pop(token)) {
+                if (closed)
+                    break;
+                backoff.pause();
+                continue;
+            }
+            backoff.reset();
+
+            if (in_order) {
+                in_order->put(std::move(token));
+                while (auto next = in_order->take_next())
+                    process(std::move(*next), nitems, ndropped, nbusy_ns);
+            } else {
+                process(std::move(token), nitems, ndropped, nbusy_ns);
+            }
+        }
+        finish_worker(nitems, ndropped, nbusy_ns);
+    }
+};
+
+// Returned by Pipeline::source() and by each stage(), to add the next stage. T is the type of the
+// items which the next stage receives.
+template <class T> class PipelineBuilder {
+    Pipeline &pipeline;
+    BoundedQueue<Token<T>> &queue;
+
+    static void check_threads(StageKind kind, int nthreads) {
+        if (nthreads < 1)
+            throw std::invalid_argument("A stage needs at least one thread");
+        if (nthreads != 1 &&
+            (kind == StageKind::serial_in_order || kind == StageKind::serial_out_of_order))
+            throw std::invalid_argument("A serial stage has exactly one thread");
+    }
+
+  public:
+    PipelineBuilder(Pipeline &pipeline, BoundedQueue<Token<T>> &queue)
+        : pipeline(pipeline), queue(queue) {}
+
+    // func: T -> U, or T -> std::optional<U> to filter items
+    template <class F> auto stage(std::string name, StageKind kind, int nthreads, F func) {
+        using Result = std::invoke_result_t<F &, T &&>;
+        static_assert(!std::is_void_v<Result>, "A stage must return a value. Use sink().");
+        using Out = typename StageOutput<Result>::type;
+        check_threads(kind, nthreads);
+
+        auto stage = std::make_unique<Stage<T, Out, F>>(pipeline, std::move(name), kind,
+                                                        nthreads, std::move(func), queue);
+        auto &out = stage->out();
+        pipeline.stages.push_back(std::move(stage));
+        return PipelineBuilder<Out>(pipeline, out);
+    }
+
+    // A serial stage
+    template <class F> auto stage(std::string name, StageKind kind, F func) {
+        return stage(std::move(name), kind, 1, std::move(func));
+    }
+
+    // The last stage. func: T -> void. For a sink, parallel_ordered would mean nothing: use
+    // serial_in_order to see the items in order.
+    template <class F> void sink(std::string name, StageKind kind, int nthreads, F func) {
+        static_assert(std::is_void_v<std::invoke_result_t<F &, T &&>>,
+                      "A sink must not return a value");
+        if (kind == StageKind::parallel_ordered)
+            throw std::invalid_argument("A sink cannot be parallel_ordered");
+        check_threads(kind, nthreads);
+
+        pipeline.stages.push_back(std::make_unique<Stage<T, void, F>>(
+            pipeline, std::move(name), kind, nthreads, std::move(func), queue));
+        pipeline.has_sink = true;
+    }
+
+    template <class F> void sink(std::string name, StageKind kind, F func) {
+        sink(std::move(name), kind, 1, std::move(func));
+    }
+};
+
+template <class F> auto Pipeline::source(std::string name, F func) {
+    using Result = std::invoke_result_t<F &>;
+    using Out = typename Result::value_type;
+    static_assert(std::is_same_v<Result, std::optional<Out>>,
+                  "A source must return std::optional");
+    if (has_source)
+        throw std::logic_error("A pipeline has only one source");
+    has_source = true;
+
+    auto stage = std::make_unique<SourceStage<Out, F>>(*this, std::move(name), std::move(func));
+    auto &out = stage->out();
+    stages.push_back(std::move(stage));
+    return PipelineBuilder<Out>(*this, out);
+}
+
+#endif // PIPELINE_H
@@ -0,0 +1,211 @@
+/**
+ * The examples of 071-075, with the algorithms of pool_execution.h instead of std::execution::par
+ *
+ * 1. Each algorithm gives the same result as the sequential standard algorithm.
+ * 2. The practical example of 075: the greatest difference between two vectors.
+ * 3. An exception thrown by an element function reaches the caller.
+ * 4. The grain: a few expensive elements.
+ * 5. Time of each algorithm on 10 million doubles, sequential and on the pool.
+ *
+ * This program does not include <execution> and is not linked with TBB.
+ */
+
+#include "pool_execution.h"
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::mt19937 mt;
+
+void check(const char *name, bool correct) {
+    std::cout << std::setw(40) << std::left << name << std::right
+              << (correct ? "same as sequential" : "WRONG") << '\n';
+}
+
+// 1. Compare with the sequential algorithms
+void check_algorithms() {
+    std::size_t n = 1'000'003;
+    std::uniform_int_distribution<long> dist(-1000, 1000);
+    std::vector<long> vec(n), vec2(n), out(n), expected(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        vec[i] = dist(mt);
+        vec2[i] = dist(mt);
+    }
+
+    out = vec;
+    expected = vec;
+    exec::for_each(exec::par, out.begin(), out.end(), [](long &x) { x = 3 * x + 1; });
+    std::for_each(expected.begin(), expected.end(), [](long &x) { x = 3 * x + 1; });
+    check("for_each", out == expected);
+
+    auto square = [](long x) { return x * x; };
+    exec::transform(exec::par, vec.begin(), vec.end(), out.begin(), square);
+    std::transform(vec.begin(), vec.end(), expected.begin(), square);
+    check("transform", out == expected);
+
+    exec::transform(exec::par, vec.begin(), vec.end(), vec2.begin(), out.begin(), std::minus<>{});
+    std::transform(vec.begin(), vec.end(), vec2.begin(), expected.begin(), std::minus<>{});
+    check("transform (two inputs)", out == expected);
+
+    check("reduce", exec::reduce(exec::par, vec.begin(), vec.end()) ==
+                        std::reduce(vec.begin(), vec.end()));
+    auto max_op = [](long a, long b) { return std::max(a, b); };
+    check("reduce (maximum)", exec::reduce(exec::par, vec.begin(), vec.end(), -5000L, max_op) ==
+                                  std::reduce(vec.begin(), vec.end(), -5000L, max_op));
+
+    check("transform_reduce (inner product)",
+          exec::transform_reduce(exec::par, vec.begin(), vec.end(), vec2.begin(), 0L) ==
+              std::transform_reduce(vec.begin(), vec.end(), vec2.begin(), 0L));
+    check("transform_reduce (sum of squares)",
+          exec::transform_reduce(exec::par, vec.begin(), vec.end(), 0L, std::plus<>{}, square) ==
+              std::transform_reduce(vec.begin(), vec.end(), 0L, std::plus<>{}, square));
+
+    exec::inclusive_scan(exec::par, vec.begin(), vec.end(), out.begin());
+    std::inclusive_scan(vec.begin(), vec.end(), expected.begin());
+    check("inclusive_scan", out == expected);
+
+    exec::inclusive_scan(exec::par, vec.begin(), vec.end(), out.begin(), std::plus<>{}, 100L);
+    std::inclusive_scan(vec.begin(), vec.end(), expected.begin(), std::plus<>{}, 100L);
+    check("inclusive_scan (initial value)", out == expected);
+
+    out = vec;
+    expected = vec;
+    exec::sort(exec::par, out.begin(), out.end());
+    std::sort(expected.begin(), expected.end());
+    check("sort", out == expected);
+
+    std::vector<std::string> words(200'000), sorted_words;
+    for (auto &w : words)
+        w = std::to_string(mt());
+    sorted_words = words;
+    exec::sort(exec::par, words.begin(), words.end(), std::greater<>{});
+    std::sort(sorted_words.begin(), sorted_words.end(), std::greater<>{});
+    check("sort (strings, descending)", words == sorted_words);
+}
+
+// 2. From 075-new_parallel_algorithms_practical.cpp
+void max_difference() {
+    std::vector<double> expected{0.1, 0.2, 0.3, 0.4, 0.5};
+    std::vector<double> actual{0.09, 0.22, 0.27, 0.41, 0.52};
+
+    auto max_diff = exec::transform_reduce(
+        exec::par, begin(expected), end(expected), begin(actual), 0.0,
+        [](auto diff1, auto diff2) { return std::max(diff1, diff2); },
+        [](auto exp, auto act) { return std::abs(act - exp); });
+
+    std::cout << "Max difference is: " << max_diff << '\n';
+}
+
+// 3. With std::execution::par, this would call std::terminate()
+void exception_example() {
+    std::vector<int> vec(1'000'000);
+    std::iota(vec.begin(), vec.end(), 0);
+    try {
+        exec::for_each(exec::par, vec.begin(), vec.end(), [](int x) {
+            if (x == 765'432)
+                throw std::runtime_error("Bad element " + std::to_string(x));
+        });
+    } catch (const std::exception &e) {
+        std::cout << "Caught: " << e.what() << '\n';
+    }
+}
+
+// 4. Eight elements which take 10ms each. With the default grain, they are one block, and run on
+// one thread. With a grain of 1, they are shared among the threads.
+void grain_example() {
+    std::vector<int> jobs(8);
+    auto slow = [](int &) { std::this_thread::sleep_for(std::chrono::milliseconds(10)); };
+
+    for (std::size_t grain : {block_grain, std::size_t{1}}) {
+        auto start = std::chrono::steady_clock::now();
+        exec::for_each(exec::par.with_grain(grain), jobs.begin(), jobs.end(), slow);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                              start)
+                        .count();
+        std::cout << "Grain " << std::setw(6) << grain << ": " << std::setw(5) << std::fixed
+                  << std::setprecision(1) << ms << " ms" << std::defaultfloat << '\n';
+    }
+}
+
+// 5. Time in milliseconds
+template <typename Func> double time_ms(Func func) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+template <typename Seq, typename Par> void compare(const char *name, Seq seq, Par par) {
+    std::cout << std::setw(20) << std::left << name << std::right << std::fixed
+              << std::setprecision(1) << std::setw(12) << time_ms(seq) << std::setw(12)
+              << time_ms(par) << std::defaultfloat << '\n';
+}
+
+void compare_speed(std::size_t n) {
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    std::vector<double> vec(n), vec2(n), out(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        vec[i] = dist(mt);
+        vec2[i] = dist(mt);
+    }
+    auto work = [](double x) { return std::sqrt(x) * std::sin(x); };
+    volatile double sink;
+
+    std::cout << std::setw(20) << std::left << "ms" << std::right << std::setw(12) << "std"
+              << std::setw(12) << "exec::par" << '\n';
+    compare(
+        "for_each",
+        [&]() { std::for_each(out.begin(), out.end(), [](double &x) { x = std::sqrt(x); }); },
+        [&]() {
+            exec::for_each(exec::par, out.begin(), out.end(), [](double &x) { x = std::sqrt(x); });
+        });
+    compare(
+        "transform", [&]() { std::transform(vec.begin(), vec.end(), out.begin(), work); },
+        [&]() { exec::transform(exec::par, vec.begin(), vec.end(), out.begin(), work); });
+    compare(
+        "reduce", [&]() { sink = std::reduce(vec.begin(), vec.end()); },
+        [&]() { sink = exec::reduce(exec::par, vec.begin(), vec.end()); });
+    compare(
+        "transform_reduce",
+        [&]() { sink = std::transform_reduce(vec.begin(), vec.end(), vec2.begin(), 0.0); },
+        [&]() {
+            sink = exec::transform_reduce(exec::par, vec.begin(), vec.end(), vec2.begin(), 0.0);
+        });
+    compare(
+        "inclusive_scan", [&]() { std::inclusive_scan(vec.begin(), vec.end(), out.begin()); },
+        [&]() { exec::inclusive_scan(exec::par, vec.begin(), vec.end(), out.begin()); });
+    std::vector<double> copy = vec;
+    compare(
+        "sort", [&]() { std::sort(copy.begin(), copy.end()); },
+        [&]() { exec::sort(exec::par, vec.begin(), vec.end()); });
+    (void)sink;
+}
+
+// g++ -std=c++20 -Wall -Wextra -pedantic -pthread -O2 main.cpp thread_pool.cpp && ./a.out
+int main() {
+    std::cout << "Default pool: " << exec::default_pool().size()
+              << " threads, plus the calling thread\n";
+
+    std::cout << "--------------------------------\n";
+    check_algorithms();
+
+    std::cout << "--------------------------------\n";
+    max_difference();
+
+    std::cout << "--------------------------------\n";
+    exception_example();
+
+    std::cout << "--------------------------------\n";
+    grain_example();
+
+    std::cout << "--------------------------------\n";
+    compare_speed(10'000'000);
+}
@@ -0,0 +1,241 @@
+/**
+ * Parallel standard algorithms without TBB
+ *
+ * With GCC, std::execution::par is only parallel if the program is compiled and linked with TBB
+ * (071-075 are built with -ltbb). If the TBB headers are not installed, libstdc++ quietly runs
+ * the "parallel" algorithms sequentially.
+ *
+ * The algorithms in namespace exec take the same arguments as the standard ones, but the first
+ * argument is a policy which says which ThreadPool to run on:
+ *     std::sort(std::execution::par, v.begin(), v.end());      // Needs TBB
+ *     exec::sort(exec::par, v.begin(), v.end());               // Runs on exec::default_pool()
+ *     exec::sort(exec::par_on(pool), v.begin(), v.end());      // Runs on "pool"
+ *
+ * The pool is the work-stealing pool of 088-thread_pool_work_stealing_contd, as extended in
+ * 091-parallel_sort (thread_pool.h). Nothing else is needed: no TBB, no OpenMP.
+ *
+ * Algorithms: for_each, transform, reduce, transform_reduce, sort and inclusive_scan.
+ * - for_each, transform, reduce and transform_reduce split the range into blocks, one task per
+ *   block, with at most 4 blocks per thread. The policy's grain is the smallest block: the
+ *   default suits cheap functions, and a smaller grain lets a short range of expensive elements
+ *   be shared among the threads.
+ * - sort is parallel_sort() from parallel_sort.h (radix sort for numbers, sample sort otherwise)
+ *   if the data is in contiguous memory, and std::sort otherwise.
+ * - inclusive_scan is parallel_inclusive_scan() from parallel_scan.h.
+ *
+ * The iterators must be random access. As with std::execution::par, reduce and transform_reduce
+ * may combine the elements in any order, so the operation should be associative and commutative.
+ *
+ * Unlike the standard parallel algorithms, which call std::terminate() if an element function
+ * throws, these algorithms rethrow the first exception in the calling thread, once all the tasks
+ * have finished.
+ */
+
+#ifndef POOL_EXECUTION_H
+#define POOL_EXECUTION_H
+
+#include "parallel_scan.h"
+#include "parallel_sort.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <vector>
+
+namespace exec {
+
+// The pool used by exec::par. It is created on first use, and its threads are joined when the
+// program exits.
+inline ThreadPool &default_pool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+// Execution policy: where to run, and how finely to split the work
+class PoolPolicy {
+    ThreadPool *pool_ptr{nullptr}; // nullptr: default_pool()
+    std::size_t grain_size{block_grain};
+
+  public:
+    constexpr PoolPolicy() = default;
+    constexpr explicit PoolPolicy(ThreadPool &pool) : pool_ptr(&pool) {}
+
+    ThreadPool &pool() const { return pool_ptr ? *pool_ptr : default_pool(); }
+    std::size_t grain() const { return grain_size; }
+
+    // A copy of this policy, with blocks of at least "grain" elements
+    constexpr PoolPolicy with_grain(std::size_t grain) const {
+        PoolPolicy copy = *this;
+        copy.grain_size = std::max<std::size_t>(grain, 1);
+        return copy;
+    }
+};
+
+inline constexpr PoolPolicy par{};
+
+inline PoolPolicy par_on(ThreadPool &pool) { return PoolPolicy(pool); }
+
+namespace detail {
+
+// Split n elements into blocks of at least policy.grain() elements, at most 4 blocks per thread,
+// and call func(begin, end) for each block in parallel
+template <class F> void for_blocks(const PoolPolicy &policy, std::size_t n, F func) {
+    ThreadPool &pool = policy.pool();
+    std::size_t max_blocks = 4 * (pool.size() + 1);
+    std::size_t nblocks = std::clamp<std::size_t>(n / policy.grain(), 1, max_blocks);
+    if (nblocks == 1) {
+        func(std::size_t{0}, n);
+        return;
+    }
+    parallel_blocks(pool, nblocks, [&](std::size_t b) {
+        func(block_begin(n, nblocks, b), block_begin(n, nblocks, b + 1));
+    });
+}
+
+// Reduce n elements and init. reduce_block(begin, end) reduces the elements of one block, which
+// is never empty, and the results of the blocks are combined in order.
+template <class T, class BinaryOp, class ReduceBlock>
+T reduce_blocks(const PoolPolicy &policy, std::size_t n, T init, BinaryOp op,
+                ReduceBlock reduce_block) {
+    if (n == 0)
+        return init;
+
+    ThreadPool &pool = policy.pool();
+    std::size_t max_blocks = 4 * (pool.size() + 1);
+    std::size_t nblocks = std::clamp<std::size_t>(n / policy.grain(), 1, max_blocks);
+    if (nblocks == 1)
+        return op(std::move(init), reduce_block(std::size_t{0}, n));
+
+    std::vector<T> partial(nblocks, init);
+    parallel_blocks(pool, nblocks, [&](std::size_t b) {
+        partial[b] = reduce_block(block_begin(n, nblocks, b), block_begin(n, nblocks, b + 1));
+    });
+
+    T result = std::move(init);
+    for (auto &p : partial)
+        result = op(std::move(result), std::move(p));
+    return result;
+}
+
+} // namespace detail
+
+//----------------------------------------------------------------------------------------------
+// for_each, transform
+
+template <std::random_access_iterator It, class UnaryFunc>
+void for_each(const PoolPolicy &policy, It first, It last, UnaryFunc func) {
+    detail::for_blocks(policy, last - first, [&](std::size_t begin, std::size_t end) {
+        std::for_each(first + begin, first + end, func);
+    });
+}
+
+template <std::random_access_iterator InIt, std::random_access_iterator OutIt, class UnaryOp>
+OutIt transform(const PoolPolicy &policy, InIt first, InIt last, OutIt out, UnaryOp op) {
+    std::size_t n = last - first;
+    detail::for_blocks(policy, n, [&](std::size_t begin, std::size_t end) {
+        std::transform(first + begin, first + end, out + begin, op);
+    });
+    return out + n;
+}
+
+template <std::random_access_iterator InIt1, std::random_access_iterator InIt2,
+          std::random_access_iterator OutIt, class BinaryOp>
+OutIt transform(const PoolPolicy &policy, InIt1 first1, InIt1 last1, InIt2 first2, OutIt out,
+                BinaryOp op) {
+    std::size_t n = last1 - first1;
+    detail::for_blocks(policy, n, [&](std::size_t begin, std::size_t end) {
+        std::transform(first1 + begin, first1 + end, first2 + begin, out + begin, op);
+    });
+    return out + n;
+}
+
+//----------------------------------------------------------------------------------------------
+// reduce, transform_reduce
+
+template <std::random_access_iterator It, class T, class BinaryOp>
+T reduce(const PoolPolicy &policy, It first, It last, T init, BinaryOp op) {
+    // Each block starts from its first element, so no identity element is needed
+    return detail::reduce_blocks(policy, last - first, std::move(init), op,
+                                 [&](std::size_t begin, std::size_t end) {
+                                     T first_value = first[begin];
+                                     return std::reduce(first + begin + 1, first + end,
+                                                        std::move(first_value), op);
+                                 });
+}
+
+template <std::random_access_iterator It, class T>
+T reduce(const PoolPolicy &policy, It first, It last, T init) {
+    return exec::reduce(policy, first, last, std::move(init), std::plus<>{});
+}
+
+template <std::random_access_iterator It>
+std::iter_value_t<It> reduce(const PoolPolicy &policy, It first, It last) {
+    return exec::reduce(policy, first, last, std::iter_value_t<It>{}, std::plus<>{});
+}
+
+template <std::random_access_iterator It1, std::random_access_iterator It2, class T,
+          class BinaryReduce, class BinaryTransform>
+T transform_reduce(const PoolPolicy &policy, It1 first1, It1 last1, It2 first2, T init,
+                   BinaryReduce reduce, BinaryTransform transform) {
+    return detail::reduce_blocks(policy, last1 - first1, std::move(init), reduce,
+                                 [&](std::size_t begin, std::size_t end) {
+                                     T first_value = transform(first1[begin], first2[begin]);
+                                     return std::transform_reduce(
+                                         first1 + begin + 1, first1 + end, first2 + begin + 1,
+                                         std::move(first_value), reduce, transform);
+                                 });
+}
+
+// Inner product
+template <std::random_access_iterator It1, std::random_access_iterator It2, class T>
+T transform_reduce(const PoolPolicy &policy, It1 first1, It1 last1, It2 first2, T init) {
+    return exec::transform_reduce(policy, first1, last1, first2, std::move(init), std::plus<>{},
+                                  std::multiplies<>{});
+}
+
+template <std::random_access_iterator It, class T, class BinaryReduce, class UnaryTransform>
+T transform_reduce(const PoolPolicy &policy, It first, It last, T init, BinaryReduce reduce,
+                   UnaryTransform transform) {
+    return detail::reduce_blocks(policy, last - first, std::move(init), reduce,
+                                 [&](std::size_t begin, std::size_t end) {
+                                     T first_value = transform(first[begin]);
+                                     return std::transform_reduce(first + begin + 1, first + end,
+                                                                  std::move(first_value), reduce,
+                                                                  transform);
+                                 });
+}
+
+//----------------------------------------------------------------------------------------------
+// sort
+
+template <std::random_access_iterator It, class Compare = std::less<>>
+void sort(const PoolPolicy &policy, It first, It last, Compare comp = Compare{}) {
+    if constexpr (std::contiguous_iterator<It>)
+        parallel_sort(policy.pool(), first, last, comp);
+    else
+        std::sort(first, last, comp);
+}
+
+//----------------------------------------------------------------------------------------------
+// inclusive_scan
+
+template <std::random_access_iterator InIt, std::random_access_iterator OutIt,
+          class BinaryOp = std::plus<>>
+OutIt inclusive_scan(const PoolPolicy &policy, InIt first, InIt last, OutIt out,
+                     BinaryOp op = BinaryOp{}) {
+    return parallel_inclusive_scan(policy.pool(), first, last, out, op);
+}
+
+template <std::random_access_iterator InIt, std::random_access_iterator OutIt, class BinaryOp,
+          class T>
+OutIt inclusive_scan(const PoolPolicy &policy, InIt first, InIt last, OutIt out, BinaryOp op,
+                     T init) {
+    return parallel_inclusive_scan(policy.pool(), first, last, out, op, init);
+}
+
+} // namespace exec
+
+#endif // POOL_EXECUTION_H
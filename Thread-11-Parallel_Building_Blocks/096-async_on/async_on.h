@@ -0,0 +1,98 @@
+/**
+ * async_on(): std::async on a thread pool
+ *
+ * std::async(std::launch::async, func) starts a new thread for every call (064-async.cpp,
+ * 065-async_launch_options.cpp). Creating and joining a thread costs tens of microseconds, which
+ * is more than many tasks take to run. async_on(pool, func, args...) runs the task on one of the
+ * pool's threads, which already exist.
+ *
+ * It behaves like std::async in the ways which matter to the caller:
+ * - The arguments are copied (or moved) when async_on() is called. Use std::ref() to pass a
+ *   reference.
+ * - It returns a std::future of the function's result, and get() rethrows any exception thrown
+ *   by the function.
+ * There is one difference: as 066-choosing_a_thread_object.cpp shows, the destructor of a future
+ * returned by std::async(std::launch::async, ...) waits for the task to finish. A future returned
+ * by async_on() is an ordinary std::future: its destructor does not wait, and the task still
+ * runs. The pool's destructor waits for every queued task.
+ *
+ * Tasks do not necessarily run in the order in which they were submitted: a worker takes the
+ * newest task in its queue first, and other workers steal the oldest ones.
+ *
+ * async_detached(pool, func, args...) is fire-and-forget: there is no future, so it costs one
+ * allocation less. As with a detached std::thread, an exception which escapes func calls
+ * std::terminate().
+ *
+ * A task which waits for another task's future blocks its pool thread. If every thread of the pool
+ * is waiting like this, no thread is left to run the tasks they wait for, and the program
+ * deadlocks. Inside a task, use get_helping(pool, future), which runs queued tasks while it waits.
+ */
+
+#ifndef ASYNC_ON_H
+#define ASYNC_ON_H
+
+#include "thread_pool.h"
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// The pool shared by all the callers which do not need a pool of their own. It is created on first
+// use, and its destructor, at the end of the program, waits for the queued tasks.
+inline ThreadPool &shared_pool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+// A function object which calls func with the arguments saved when it was made
+template <class F, class... Args> auto bind_arguments(F &&func, Args &&...args) {
+    return [func = std::forward<F>(func),
+            args = std::make_tuple(std::forward<Args>(args)...)]() mutable -> decltype(auto) {
+        return std::apply(std::move(func), std::move(args));
+    };
+}
+
+template <class F, class... Args>
+using async_result_t = std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>;
+
+template <class F, class... Args>
+[[nodiscard]] std::future<async_result_t<F, Args...>> async_on(ThreadPool &pool, F &&func,
+                                                               Args &&...args) {
+    using R = async_result_t<F, Args...>;
+
+    // The pool stores its tasks in std::function, which must be copyable, and a packaged_task is
+    // move-only: share it instead
+    auto task = std::make_shared<std::packaged_task<R()>>(
+        bind_arguments(std::forward<F>(func), std::forward<Args>(args)...));
+    std::future<R> result = task->get_future();
+    pool.submit([task]() { (*task)(); });
+    return result;
+}
+
+template <class F, class... Args> void async_detached(ThreadPool &pool, F &&func, Args &&...args) {
+    // std::function needs a copyable function object: if func or an argument is move-only, the
+    // bound call is kept on the heap
+    auto call = bind_arguments(std::forward<F>(func), std::forward<Args>(args)...);
+    if constexpr (std::is_copy_constructible_v<decltype(call)>) {
+        pool.submit(std::move(call));
+    } else {
+        auto shared = std::make_shared<decltype(call)>(std::move(call));
+        pool.submit([shared]() { (*shared)(); });
+    }
+}
+
+// Wait for a future, running the pool's queued tasks in the meantime, then return its value
+template <class T> T get_helping(ThreadPool &pool, std::future<T> &fut) {
+    while (fut.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        if (!pool.run_pending_task())
+            std::this_thread::yield();
+    }
+    return fut.get();
+}
+
+#endif // ASYNC_ON_H
@@ -0,0 +1,190 @@
+/**
+ * async_on() compared with std::async
+ *
+ * 1. The cost of a call: std::async(std::launch::async) starts a thread for every task, async_on()
+ *    queues the task for a thread which already exists.
+ * 2. The same future semantics: a result, an exception, arguments copied or moved, and references
+ *    with std::ref().
+ * 3. The future's destructor does not wait (compare with 066-choosing_a_thread_object.cpp).
+ * 4. Fire-and-forget tasks with async_detached().
+ * 5. The sum of 069-data_parallelism.cpp, and a recursive computation which waits for its own
+ *    subtasks with get_helping().
+ */
+
+#include "async_on.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std::literals;
+
+double microseconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+// 1. Start many small tasks, and wait for all of them
+void compare_cost(ThreadPool &pool, int ntasks) {
+    auto small_task = [](int i) { return i * 2; };
+
+    for (int round = 0; round < 2; ++round) {
+        long total = 0;
+        auto start = std::chrono::steady_clock::now();
+        {
+            std::vector<std::future<int>> futures;
+            for (int i = 0; i < ntasks; ++i)
+                futures.push_back(std::async(std::launch::async, small_task, i));
+            for (auto &fut : futures)
+                total += fut.get();
+        }
+        double async_us = microseconds_since(start) / ntasks;
+
+        start = std::chrono::steady_clock::now();
+        {
+            std::vector<std::future<int>> futures;
+            for (int i = 0; i < ntasks; ++i)
+                futures.push_back(async_on(pool, small_task, i));
+            for (auto &fut : futures)
+                total -= fut.get();
+        }
+        double pool_us = microseconds_since(start) / ntasks;
+
+        std::cout << ntasks << " tasks, microseconds per task: std::async " << std::fixed
+                  << std::setprecision(2) << async_us << ", async_on " << pool_us
+                  << std::defaultfloat << std::setprecision(6) << (total == 0 ? "" : "   WRONG")
+                  << '\n';
+    }
+}
+
+// 2. Future semantics
+void semantics(ThreadPool &pool) {
+    // A result
+    std::future<std::string> greeting =
+        async_on(pool, [](const std::string &name) { return "Hello, " + name; }, "pool"s);
+    std::cout << greeting.get() << '\n';
+
+    // An exception
+    std::future<int> failing = async_on(pool, []() -> int { throw std::out_of_range("Oops"); });
+    try {
+        failing.get();
+    } catch (const std::exception &e) {
+        std::cout << "Exception from the task: " << e.what() << '\n';
+    }
+
+    // A reference, and a move-only argument
+    int counter = 0;
+    auto owned = std::make_unique<int>(41);
+    std::future<void> done = async_on(
+        pool, [](int &count, std::unique_ptr<int> p) { count = *p + 1; }, std::ref(counter),
+        std::move(owned));
+    done.get();
+    std::cout << "Counter set by the task: " << counter << '\n';
+
+    // Member functions work as with std::async
+    std::string text = "pipeline";
+    std::future<std::size_t> length = async_on(pool, &std::string::size, &text);
+    std::cout << "Length: " << length.get() << '\n';
+}
+
+// 3. As in 066, but the future's destructor does not wait for the task
+void task() {
+    std::this_thread::sleep_for(200ms);
+    std::cout << "Task result: " << 42 << '\n';
+}
+
+void func(ThreadPool &pool) {
+    std::cout << "Calling async_on\n";
+    std::future<void> fut = async_on(pool, task);
+    std::cout << "async_on is called\n";
+}
+
+// 4. Write log messages without waiting for them. The pool does not promise to run tasks in the
+// order in which they were submitted: a worker takes the newest task in its queue first.
+void detached_example() {
+    std::mutex cout_mut;
+    {
+        ThreadPool log_pool(1);
+        for (int i = 0; i < 3; ++i) {
+            async_detached(log_pool, [&cout_mut, i]() {
+                std::this_thread::sleep_for(20ms);
+                std::lock_guard<std::mutex> lck_guard(cout_mut);
+                std::cout << "Log message " << i << " written\n";
+            });
+        }
+        std::lock_guard<std::mutex> lck_guard(cout_mut);
+        std::cout << "Messages queued\n";
+        // log_pool's destructor waits for the messages
+    }
+}
+
+// 5. The sum of 069, in 4 parts
+double accum(double *beg, double *end) { return std::accumulate(beg, end, 0.0); }
+
+double add_parallel(ThreadPool &pool, std::vector<double> &vec) {
+    double *vec0 = &vec[0];
+    auto vsize = vec.size();
+
+    auto fut1 = async_on(pool, accum, vec0, vec0 + vsize / 4);
+    auto fut2 = async_on(pool, accum, vec0 + vsize / 4, vec0 + 2 * vsize / 4);
+    auto fut3 = async_on(pool, accum, vec0 + 2 * vsize / 4, vec0 + 3 * vsize / 4);
+    auto fut4 = async_on(pool, accum, vec0 + 3 * vsize / 4, vec0 + vsize);
+
+    return fut1.get() + fut2.get() + fut3.get() + fut4.get();
+}
+
+// Recursive tasks which wait for their subtasks. With fut.get(), every pool thread could end up
+// waiting for a subtask which no thread is free to run. get_helping() runs the subtasks itself.
+long fib(ThreadPool &pool, int n) {
+    if (n < 20) {
+        long a = 0, b = 1;
+        for (int i = 0; i < n; ++i)
+            b = std::exchange(a, b) + b;
+        return a;
+    }
+    std::future<long> left = async_on(pool, fib, std::ref(pool), n - 1);
+    long right = fib(pool, n - 2);
+    return get_helping(pool, left) + right;
+}
+
+// g++ -std=c++20 -Wall -Wextra -pedantic -pthread -O2 main.cpp thread_pool.cpp && ./a.out
+int main() {
+    ThreadPool &pool = shared_pool();
+    std::cout << "Shared pool with " << pool.size() << " threads\n";
+
+    std::cout << "--------------------------------\n";
+    compare_cost(pool, 10'000);
+
+    std::cout << "--------------------------------\n";
+    semantics(pool);
+
+    std::cout << "--------------------------------\n";
+    func(pool);
+    std::cout << "Task started\n";
+    std::this_thread::sleep_for(300ms);
+
+    std::cout << "--------------------------------\n";
+    detached_example();
+
+    std::cout << "--------------------------------\n";
+    std::mt19937 mt;
+    std::uniform_real_distribution<double> dist(0, 100);
+    std::vector<double> vec(16);
+    std::generate(vec.begin(), vec.end(), [&]() { return dist(mt); });
+    std::cout << "Sum of data: " << add_parallel(pool, vec)
+              << " (sequential: " << std::accumulate(vec.begin(), vec.end(), 0.0) << ")\n";
+
+    // A pool with a single thread, which would deadlock at once if tasks waited with get()
+    ThreadPool small_pool(1);
+    std::cout << "fib(32) = " << fib(small_pool, 32) << '\n';
+}
@@ -0,0 +1,378 @@
+/**
+ * Cache-blocked kernels implementation
+ *
+ * The simd kernels are templates on the number of doubles per register, written with the GCC/Clang
+ * vector extensions, and compiled inside functions with a "target" attribute, as in
+ * 090-simd_reductions. With the "fma" target, the compiler turns acc += x * b into a fused
+ * multiply-add.
+ */
+
+#include "kernels.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// W doubles in one register
+template <int W> struct Simd {
+    typedef double type __attribute__((vector_size(W * sizeof(double))));
+};
+template <int W> using Vec = typename Simd<W>::type;
+
+// Unaligned loads and stores. Vectors are passed by reference: see 090-simd_reductions.
+template <class V> [[gnu::always_inline]] inline void load(V &v, const double *p) {
+    std::memcpy(&v, p, sizeof(v));
+}
+template <class V> [[gnu::always_inline]] inline void store(double *p, const V &v) {
+    std::memcpy(p, &v, sizeof(v));
+}
+
+void check_tile(const char *kernel, std::size_t n, std::size_t tile, std::size_t multiple) {
+    if (tile == 0 || tile % multiple != 0 || n % tile != 0)
+        throw std::invalid_argument(std::string(kernel) + ": n (" + std::to_string(n) +
+                                    ") must be a multiple of the tile (" + std::to_string(tile) +
+                                    "), and the tile a multiple of " + std::to_string(multiple));
+}
+
+//----------------------------------------------------------------------------------------------
+// Matrix multiply
+
+// c[i0.., j0..] += a[i0.., k0..] * b[k0.., j0..] for one tile of each. A block of 4 rows and 2W
+// columns of c stays in 8 registers while k runs through the tile: each element of b which is
+// loaded is used 4 times, and each element of a 2W times.
+template <int W>
+[[gnu::always_inline]] inline void matmul_tile(const double *a, const double *b, double *c,
+                                               std::size_t n, std::size_t i0, std::size_t j0,
+                                               std::size_t k0, std::size_t tile) {
+    for (std::size_t i = i0; i < i0 + tile; i += 4) {
+        double *c0 = c + i * n, *c1 = c0 + n, *c2 = c1 + n, *c3 = c2 + n;
+        const double *a0 = a + i * n, *a1 = a0 + n, *a2 = a1 + n, *a3 = a2 + n;
+        for (std::size_t j = j0; j < j0 + tile; j += 2 * W) {
+            Vec<W> acc00, acc01, acc10, acc11, acc20, acc21, acc30, acc31;
+            load(acc00, c0 + j), load(acc01, c0 + j + W);
+            load(acc10, c1 + j), load(acc11, c1 + j + W);
+            load(acc20, c2 + j), load(acc21, c2 + j + W);
+            load(acc30, c3 + j), load(acc31, c3 + j + W);
+            for (std::size_t k = k0; k < k0 + tile; ++k) {
+                Vec<W> b0, b1;
+                load(b0, b + k * n + j);
+                load(b1, b + k * n + j + W);
+                acc00 += a0[k] * b0, acc01 += a0[k] * b1;
+                acc10 += a1[k] * b0, acc11 += a1[k] * b1;
+                acc20 += a2[k] * b0, acc21 += a2[k] * b1;
+                acc30 += a3[k] * b0, acc31 += a3[k] * b1;
+            }
+            store(c0 + j, acc00), store(c0 + j + W, acc01);
+            store(c1 + j, acc10), store(c1 + j + W, acc11);
+            store(c2 + j, acc20), store(c2 + j + W, acc21);
+            store(c3 + j, acc30), store(c3 + j + W, acc31);
+        }
+    }
+}
+
+// Rows [row_begin, row_end) of c, which are a whole number of tiles
+template <int W>
+[[gnu::always_inline]] inline void matmul_rows(const double *a, const double *b, double *c,
+                                               std::size_t n, std::size_t tile,
+                                               std::size_t row_begin, std::size_t row_end) {
+    for (std::size_t ii = row_begin; ii < row_end; ii += tile) {
+        std::fill(c + ii * n, c + (ii + tile) * n, 0.0);
+        for (std::size_t kk = 0; kk < n; kk += tile)
+            for (std::size_t jj = 0; jj < n; jj += tile)
+                matmul_tile<W>(a, b, c, n, ii, jj, kk, tile);
+    }
+}
+
+//----------------------------------------------------------------------------------------------
+// Transpose
+
+// Transpose the W x W block at (i, j) of "in" into the block at (j, i) of "out"
+template <int W>
+[[gnu::always_inline]] inline void transpose_block(const double *in, double *out, std::size_t n,
+                                                   std::size_t i, std::size_t j) {
+    if constexpr (W == 2) {
+        Vec<2> r0, r1;
+        load(r0, in + i * n + j);
+        load(r1, in + (i + 1) * n + j);
+        Vec<2> o0 = __builtin_shufflevector(r0, r1, 0, 2);
+        Vec<2> o1 = __builtin_shufflevector(r0, r1, 1, 3);
+        store(out + j * n + i, o0);
+        store(out + (j + 1) * n + i, o1);
+    } else {
+        static_assert(W == 4);
+        Vec<4> r0, r1, r2, r3;
+        load(r0, in + i * n + j);
+        load(r1, in + (i + 1) * n + j);
+        load(r2, in + (i + 2) * n + j);
+        load(r3, in + (i + 3) * n + j);
+        // Interleave pairs of rows, then pairs of pairs
+        Vec<4> t0 = __builtin_shufflevector(r0, r1, 0, 4, 2, 6);
+        Vec<4> t1 = __builtin_shufflevector(r0, r1, 1, 5, 3, 7);
+        Vec<4> t2 = __builtin_shufflevector(r2, r3, 0, 4, 2, 6);
+        Vec<4> t3 = __builtin_shufflevector(r2, r3, 1, 5, 3, 7);
+        Vec<4> o0 = __builtin_shufflevector(t0, t2, 0, 1, 4, 5);
+        Vec<4> o1 = __builtin_shufflevector(t1, t3, 0, 1, 4, 5);
+        Vec<4> o2 = __builtin_shufflevector(t0, t2, 2, 3, 6, 7);
+        Vec<4> o3 = __builtin_shufflevector(t1, t3, 2, 3, 6, 7);
+        store(out + j * n + i, o0);
+        store(out + (j + 1) * n + i, o1);
+        store(out + (j + 2) * n + i, o2);
+        store(out + (j + 3) * n + i, o3);
+    }
+}
+
+template <int W>
+[[gnu::always_inline]] inline void transpose_rows(const double *in, double *out, std::size_t n,
+                                                  std::size_t tile, std::size_t row_begin,
+                                                  std::size_t row_end) {
+    for (std::size_t ii = row_begin; ii < row_end; ii += tile)
+        for (std::size_t jj = 0; jj < n; jj += tile)
+            for (std::size_t i = ii; i < ii + tile; i += W)
+                for (std::size_t j = jj; j < jj + tile; j += W)
+                    transpose_block<W>(in, out, n, i, j);
+}
+
+//----------------------------------------------------------------------------------------------
+// Stencil
+
+void copy_boundary(const double *in, double *out, std::size_t n) {
+    std::copy(in, in + n, out);
+    std::copy(in + (n - 1) * n, in + n * n, out + (n - 1) * n);
+    for (std::size_t i = 1; i < n - 1; ++i) {
+        out[i * n] = in[i * n];
+        out[i * n + n - 1] = in[i * n + n - 1];
+    }
+}
+
+// Interior points [j_begin, j_end) of row i. The additions are grouped as in the simd kernel, so
+// that every version gives the same bits.
+inline void stencil_row(const double *in, double *out, std::size_t n, std::size_t i,
+                        std::size_t j_begin, std::size_t j_end) {
+    const double *up = in + (i - 1) * n, *mid = in + i * n, *down = in + (i + 1) * n;
+    for (std::size_t j = j_begin; j < j_end; ++j)
+        out[i * n + j] = 0.25 * ((up[j] + down[j]) + (mid[j - 1] + mid[j + 1]));
+}
+
+template <int W>
+[[gnu::always_inline]] inline void stencil_row_simd(const double *in, double *out, std::size_t n,
+                                                    std::size_t i, std::size_t j_begin,
+                                                    std::size_t j_end) {
+    const double *up = in + (i - 1) * n, *mid = in + i * n, *down = in + (i + 1) * n;
+    std::size_t j = j_begin;
+    for (; j + W <= j_end; j += W) {
+        Vec<W> u, d, l, r;
+        load(u, up + j);
+        load(d, down + j);
+        load(l, mid + j - 1);
+        load(r, mid + j + 1);
+        Vec<W> result = 0.25 * ((u + d) + (l + r));
+        store(out + i * n + j, result);
+    }
+    for (; j < j_end; ++j)
+        out[i * n + j] = 0.25 * ((up[j] + down[j]) + (mid[j - 1] + mid[j + 1]));
+}
+
+// Interior rows [row_begin, row_end), in strips of "tile" columns
+template <int W>
+[[gnu::always_inline]] inline void stencil_rows(const double *in, double *out, std::size_t n,
+                                                std::size_t tile, std::size_t row_begin,
+                                                std::size_t row_end) {
+    for (std::size_t jj = 1; jj < n - 1; jj += tile) {
+        std::size_t j_end = std::min(jj + tile, n - 1);
+        for (std::size_t i = row_begin; i < row_end; ++i)
+            stencil_row_simd<W>(in, out, n, i, jj, j_end);
+    }
+}
+
+//----------------------------------------------------------------------------------------------
+// The simd kernels for each instruction set
+
+struct SimdKernels {
+    const char *name;
+    void (*matmul_rows)(const double *, const double *, double *, std::size_t, std::size_t,
+                        std::size_t, std::size_t);
+    void (*transpose_rows)(const double *, double *, std::size_t, std::size_t, std::size_t,
+                           std::size_t);
+    void (*stencil_rows)(const double *, double *, std::size_t, std::size_t, std::size_t,
+                         std::size_t);
+};
+
+// SSE2 is part of x86-64, and the vector extensions have a generic fallback elsewhere
+void sse2_matmul_rows(const double *a, const double *b, double *c, std::size_t n, std::size_t tile,
+                      std::size_t row_begin, std::size_t row_end) {
+    matmul_rows<2>(a, b, c, n, tile, row_begin, row_end);
+}
+void sse2_transpose_rows(const double *in, double *out, std::size_t n, std::size_t tile,
+                         std::size_t row_begin, std::size_t row_end) {
+    transpose_rows<2>(in, out, n, tile, row_begin, row_end);
+}
+void sse2_stencil_rows(const double *in, double *out, std::size_t n, std::size_t tile,
+                       std::size_t row_begin, std::size_t row_end) {
+    stencil_rows<2>(in, out, n, tile, row_begin, row_end);
+}
+
+const SimdKernels sse2_kernels{"SSE2", sse2_matmul_rows, sse2_transpose_rows, sse2_stencil_rows};
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CACHE_KERNELS_X86 1
+
+[[gnu::target("avx2,fma")]] void avx2_matmul_rows(const double *a, const double *b, double *c,
+                                                  std::size_t n, std::size_t tile,
+                                                  std::size_t row_begin, std::size_t row_end) {
+    matmul_rows<4>(a, b, c, n, tile, row_begin, row_end);
+}
+[[gnu::target("avx2,fma")]] void avx2_transpose_rows(const double *in, double *out, std::size_t n,
+                                                     std::size_t tile, std::size_t row_begin,
+                                                     std::size_t row_end) {
+    transpose_rows<4>(in, out, n, tile, row_begin, row_end);
+}
+[[gnu::target("avx2,fma")]] void avx2_stencil_rows(const double *in, double *out, std::size_t n,
+                                                   std::size_t tile, std::size_t row_begin,
+                                                   std::size_t row_end) {
+    stencil_rows<4>(in, out, n, tile, row_begin, row_end);
+}
+
+const SimdKernels avx2_kernels{"AVX2+FMA", avx2_matmul_rows, avx2_transpose_rows,
+                               avx2_stencil_rows};
+#endif
+
+const SimdKernels &simd_kernels() {
+    static const SimdKernels &best = []() -> const SimdKernels & {
+#ifdef CACHE_KERNELS_X86
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            return avx2_kernels;
+#endif
+        return sse2_kernels;
+    }();
+    return best;
+}
+
+// Split "count" units of work (tiles or rows) into blocks for the pool
+std::size_t work_blocks(const ThreadPool &pool, std::size_t count) {
+    return std::clamp<std::size_t>(count, 1, 4 * (pool.size() + 1));
+}
+
+} // namespace
+
+const char *simd_isa_name() { return simd_kernels().name; }
+
+//----------------------------------------------------------------------------------------------
+// Matrix multiply
+
+void matmul_naive(const double *a, const double *b, double *c, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+        for (std::size_t j = 0; j < n; ++j) {
+            double sum = 0.0;
+            for (std::size_t k = 0; k < n; ++k)
+                sum += a[i * n + k] * b[k * n + j];
+            c[i * n + j] = sum;
+        }
+    }
+}
+
+void matmul_tiled(const double *a, const double *b, double *c, std::size_t n, std::size_t tile) {
+    check_tile("matmul_tiled", n, tile, 8);
+    std::fill(c, c + n * n, 0.0);
+    for (std::size_t ii = 0; ii < n; ii += tile)
+        for (std::size_t kk = 0; kk < n; kk += tile)
+            for (std::size_t jj = 0; jj < n; jj += tile)
+                // i-k-j order: the innermost loop runs along rows of b and c
+                for (std::size_t i = ii; i < ii + tile; ++i)
+                    for (std::size_t k = kk; k < kk + tile; ++k) {
+                        double x = a[i * n + k];
+                        for (std::size_t j = jj; j < jj + tile; ++j)
+                            c[i * n + j] += x * b[k * n + j];
+                    }
+}
+
+void matmul_simd(const double *a, const double *b, double *c, std::size_t n, std::size_t tile) {
+    check_tile("matmul_simd", n, tile, 8);
+    simd_kernels().matmul_rows(a, b, c, n, tile, 0, n);
+}
+
+void matmul_parallel(ThreadPool &pool, const double *a, const double *b, double *c, std::size_t n,
+                     std::size_t tile) {
+    check_tile("matmul_parallel", n, tile, 8);
+    auto kernel = simd_kernels().matmul_rows;
+    std::size_t ntiles = n / tile;
+    std::size_t nblocks = work_blocks(pool, ntiles);
+    parallel_blocks(pool, nblocks, [&](std::size_t blk) {
+        kernel(a, b, c, n, tile, block_begin(ntiles, nblocks, blk) * tile,
+               block_begin(ntiles, nblocks, blk + 1) * tile);
+    });
+}
+
+//----------------------------------------------------------------------------------------------
+// Transpose
+
+void transpose_naive(const double *in, double *out, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i)
+        for (std::size_t j = 0; j < n; ++j)
+            out[j * n + i] = in[i * n + j];
+}
+
+void transpose_tiled(const double *in, double *out, std::size_t n, std::size_t tile) {
+    check_tile("transpose_tiled", n, tile, 4);
+    for (std::size_t ii = 0; ii < n; ii += tile)
+        for (std::size_t jj = 0; jj < n; jj += tile)
+            for (std::size_t i = ii; i < ii + tile; ++i)
+                for (std::size_t j = jj; j < jj + tile; ++j)
+                    out[j * n + i] = in[i * n + j];
+}
+
+void transpose_simd(const double *in, double *out, std::size_t n, std::size_t tile) {
+    check_tile("transpose_simd", n, tile, 4);
+    simd_kernels().transpose_rows(in, out, n, tile, 0, n);
+}
+
+void transpose_parallel(ThreadPool &pool, const double *in, double *out, std::size_t n,
+                        std::size_t tile) {
+    check_tile("transpose_parallel", n, tile, 4);
+    auto kernel = simd_kernels().transpose_rows;
+    std::size_t ntiles = n / tile;
+    std::size_t nblocks = work_blocks(pool, ntiles);
+    parallel_blocks(pool, nblocks, [&](std::size_t blk) {
+        kernel(in, out, n, tile, block_begin(ntiles, nblocks, blk) * tile,
+               block_begin(ntiles, nblocks, blk + 1) * tile);
+    });
+}
+
+//----------------------------------------------------------------------------------------------
+// Stencil
+
+void stencil_naive(const double *in, double *out, std::size_t n) {
+    copy_boundary(in, out, n);
+    for (std::size_t i = 1; i < n - 1; ++i)
+        stencil_row(in, out, n, i, 1, n - 1);
+}
+
+void stencil_tiled(const double *in, double *out, std::size_t n, std::size_t tile) {
+    tile = std::max<std::size_t>(tile, 1);
+    copy_boundary(in, out, n);
+    for (std::size_t jj = 1; jj < n - 1; jj += tile) {
+        std::size_t j_end = std::min(jj + tile, n - 1);
+        for (std::size_t i = 1; i < n - 1; ++i)
+            stencil_row(in, out, n, i, jj, j_end);
+    }
+}
+
+void stencil_simd(const double *in, double *out, std::size_t n, std::size_t tile) {
+    copy_boundary(in, out, n);
+    simd_kernels().stencil_rows(in, out, n, std::max<std::size_t>(tile, 1), 1, n - 1);
+}
+
+void stencil_parallel(ThreadPool &pool, const double *in, double *out, std::size_t n,
+                      std::size_t tile) {
+    copy_boundary(in, out, n);
+    auto kernel = simd_kernels().stencil_rows;
+    tile = std::max<std::size_t>(tile, 1);
+    std::size_t rows = n - 2;
+    std::size_t nblocks = work_blocks(pool, rows);
+    parallel_blocks(pool, nblocks, [&](std::size_t blk) {
+        kernel(in, out, n, tile, 1 + block_begin(rows, nblocks, blk),
+               1 + block_begin(rows, nblocks, blk + 1));
+    });
+}
@@ -0,0 +1,64 @@
+/**
+ * Cache-blocked kernels: matrix multiply, transpose and a 2D stencil
+ *
+ * The header of 069-data_parallelism.cpp says that data parallelism improves data locality: "each
+ * core can cache its own 8 MB subset". These kernels show how much locality is worth, each in four
+ * versions:
+ * - naive: the textbook loops.
+ * - tiled: the same arithmetic, in square tiles (or strips) small enough to stay in the cache
+ *   while they are used. The tile size is a parameter, so that a sweep over tile sizes shows where
+ *   the working set stops fitting in L1 and L2.
+ * - simd: tiled, with the innermost loops written with vectors (as in 090-simd_reductions): SSE2,
+ *   or AVX2 with FMA if the CPU has it, chosen at run time.
+ * - parallel: the simd kernel, with the tiles shared among the threads of a ThreadPool. Each task
+ *   writes its own rows of the output, so no locking is needed.
+ *
+ * All matrices are n x n doubles in row-major order. The output array must not overlap an input.
+ *
+ * Matrix multiply: c = a * b. 2 n^3 floating-point operations.
+ * - The naive loop reads b by column, one cache line for each element.
+ * - The tiled kernels need n to be a multiple of the tile, and the tile a multiple of 8, and throw
+ *   std::invalid_argument otherwise. Three tiles of tile x tile doubles are in use at once.
+ * - The simd kernel keeps a 4 x 8 block of c in registers while it runs along k.
+ *
+ * Transpose: out = transpose(in). No arithmetic: only memory traffic.
+ * - The naive loop writes out by column.
+ * - The tiled kernels need n to be a multiple of the tile, and the tile a multiple of 4.
+ * - The simd kernel transposes 4 x 4 (or 2 x 2) blocks in registers with shuffles.
+ *
+ * Stencil: one Jacobi sweep of the 5-point Laplace stencil. Each interior point of out is the mean
+ * of its four neighbours in "in"; the boundary is copied. 4 operations per interior point.
+ * - The tiled kernels process strips of "tile" columns, so that three rows of a strip stay in L1
+ *   even when three whole rows do not. Any n >= 3 and tile >= 1.
+ */
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include "thread_pool.h"
+
+#include <cstddef>
+
+// "AVX2+FMA" or "SSE2": the instruction set used by the simd and parallel kernels, chosen on the
+// first call
+const char *simd_isa_name();
+
+void matmul_naive(const double *a, const double *b, double *c, std::size_t n);
+void matmul_tiled(const double *a, const double *b, double *c, std::size_t n, std::size_t tile);
+void matmul_simd(const double *a, const double *b, double *c, std::size_t n, std::size_t tile);
+void matmul_parallel(ThreadPool &pool, const double *a, const double *b, double *c, std::size_t n,
+                     std::size_t tile);
+
+void transpose_naive(const double *in, double *out, std::size_t n);
+void transpose_tiled(const double *in, double *out, std::size_t n, std::size_t tile);
+void transpose_simd(const double *in, double *out, std::size_t n, std::size_t tile);
+void transpose_parallel(ThreadPool &pool, const double *in, double *out, std::size_t n,
+                        std::size_t tile);
+
+void stencil_naive(const double *in, double *out, std::size_t n);
+void stencil_tiled(const double *in, double *out, std::size_t n, std::size_t tile);
+void stencil_simd(const double *in, double *out, std::size_t n, std::size_t tile);
+void stencil_parallel(ThreadPool &pool, const double *in, double *out, std::size_t n,
+                      std::size_t tile);
+
+#endif // KERNELS_H
@@ -0,0 +1,238 @@
+/**
+ * How data locality affects throughput: a benchmark of kernels.h
+ *
+ * 1. The machine: hardware threads and cache sizes, as reported by the C library.
+ * 2. Matrix multiply: naive, tiled, tiled+SIMD and tiled+parallel, then a sweep over tile sizes.
+ * 3. Transpose: the same four versions, and a sweep over tile sizes.
+ * 4. Stencil: the same four versions, and a sweep over matrix sizes, from one which fits in L1 to
+ *    one which only fits in memory.
+ *
+ * Each version is checked against the naive one. The tables show:
+ * - GFLOP/s: floating-point operations per second (none for the transpose).
+ * - GB/s: the least memory traffic the kernel could need, each input read once and the output
+ *   written once, divided by the time. A kernel which reads the same data again from memory moves
+ *   more bytes than this, so its GB/s is low.
+ * - In the sweeps, the working set: the bytes in use at once, to be compared with the cache sizes.
+ *   The best tile is the largest one whose working set still fits in L1 (or L2), and throughput
+ *   falls where the working set crosses a cache size. On new hardware, these are the numbers to
+ *   check against the cache sizes which the vendor gives.
+ *
+ * Usage: ./a.out [n [threads]]
+ *   n: size of the matrices to multiply (default 1024, a multiple of 256). The transpose and the
+ *      stencil use 4n x 4n matrices.
+ *   threads: threads for the parallel versions, counting the calling thread (default: all the
+ *            hardware threads, and at least 2)
+ */
+
+#include "kernels.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static std::mt19937 mt;
+
+// The best time of several runs of func, in seconds. func runs at least once, and again until
+// about 0.3 s have passed.
+template <typename Func> double best_seconds(Func func) {
+    double best = 1e30, total = 0.0;
+    do {
+        auto start = std::chrono::steady_clock::now();
+        func();
+        double s =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::min(best, s);
+        total += s;
+    } while (total < 0.3);
+    return best;
+}
+
+std::vector<double> random_matrix(std::size_t n) {
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    std::vector<double> m(n * n);
+    for (auto &x : m)
+        x = dist(mt);
+    return m;
+}
+
+double max_abs_diff(const std::vector<double> &x, const std::vector<double> &y) {
+    double diff = 0.0;
+    for (std::size_t i = 0; i < x.size(); ++i)
+        diff = std::max(diff, std::abs(x[i] - y[i]));
+    return diff;
+}
+
+std::string kib(double bytes) {
+    if (bytes >= 1024 * 1024)
+        return std::to_string(static_cast<long>(bytes / (1024 * 1024))) + " MiB";
+    if (bytes >= 1024)
+        return std::to_string(static_cast<long>(bytes / 1024)) + " KiB";
+    return std::to_string(static_cast<long>(bytes)) + " B";
+}
+
+void header() {
+    std::cout << std::setw(12) << std::left << "version" << std::right << std::setw(12) << "ms"
+              << std::setw(10) << "GFLOP/s" << std::setw(10) << "GB/s" << "  result\n";
+}
+
+// One line of a table. flops and bytes are per run.
+void report(const char *name, double seconds, double flops, double bytes, bool correct) {
+    std::cout << std::setw(12) << std::left << name << std::right << std::fixed
+              << std::setprecision(2) << std::setw(12) << seconds * 1e3 << std::setw(10);
+    if (flops > 0)
+        std::cout << flops / seconds * 1e-9;
+    else
+        std::cout << "-";
+    std::cout << std::setw(10) << bytes / seconds * 1e-9
+              << std::defaultfloat << std::setprecision(6) << "  " << (correct ? "ok" : "WRONG")
+              << '\n';
+}
+
+// 1. The machine
+void describe_machine(const ThreadPool &pool) {
+    std::cout << "Hardware threads: " << std::thread::hardware_concurrency()
+              << ", parallel versions use " << pool.size() + 1 << " threads\n";
+    std::cout << "SIMD kernels: " << simd_isa_name() << '\n';
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+    std::cout << "Caches: L1d " << kib(sysconf(_SC_LEVEL1_DCACHE_SIZE)) << ", L2 "
+              << kib(sysconf(_SC_LEVEL2_CACHE_SIZE)) << ", L3 "
+              << kib(sysconf(_SC_LEVEL3_CACHE_SIZE)) << ", line "
+              << sysconf(_SC_LEVEL1_DCACHE_LINESIZE) << " bytes\n";
+#endif
+}
+
+// 2. Matrix multiply
+void benchmark_matmul(ThreadPool &pool, std::size_t n) {
+    auto a = random_matrix(n), b = random_matrix(n);
+    std::vector<double> expected(n * n), c(n * n);
+    double flops = 2.0 * n * n * n, bytes = 3.0 * n * n * sizeof(double);
+    // The versions add in different orders: allow for rounding
+    double tolerance = 1e-12 * n;
+    std::size_t tile = 64;
+
+    std::cout << "Matrix multiply, n = " << n << ", tile = " << tile << '\n';
+    header();
+    double s = best_seconds([&]() { matmul_naive(a.data(), b.data(), expected.data(), n); });
+    report("naive", s, flops, bytes, true);
+    s = best_seconds([&]() { matmul_tiled(a.data(), b.data(), c.data(), n, tile); });
+    report("tiled", s, flops, bytes, max_abs_diff(c, expected) < tolerance);
+    std::fill(c.begin(), c.end(), 0.0);
+    s = best_seconds([&]() { matmul_simd(a.data(), b.data(), c.data(), n, tile); });
+    report("simd", s, flops, bytes, max_abs_diff(c, expected) < tolerance);
+    std::fill(c.begin(), c.end(), 0.0);
+    s = best_seconds([&]() { matmul_parallel(pool, a.data(), b.data(), c.data(), n, tile); });
+    report("parallel", s, flops, bytes, max_abs_diff(c, expected) < tolerance);
+
+    std::cout << "\nsimd version by tile size\n"
+              << std::setw(6) << "tile" << std::setw(14) << "working set" << std::setw(10)
+              << "GFLOP/s\n";
+    for (std::size_t t : {8, 16, 32, 64, 128, 256}) {
+        if (n % t != 0)
+            continue;
+        s = best_seconds([&]() { matmul_simd(a.data(), b.data(), c.data(), n, t); });
+        std::cout << std::setw(6) << t << std::setw(14) << kib(3.0 * t * t * sizeof(double))
+                  << std::fixed << std::setprecision(2) << std::setw(10) << flops / s * 1e-9
+                  << std::defaultfloat << std::setprecision(6) << '\n';
+    }
+}
+
+// 3. Transpose
+void benchmark_transpose(ThreadPool &pool, std::size_t n) {
+    auto in = random_matrix(n);
+    std::vector<double> expected(n * n), out(n * n);
+    double bytes = 2.0 * n * n * sizeof(double);
+    std::size_t tile = 32;
+
+    std::cout << "Transpose, n = " << n << " (" << kib(n * n * sizeof(double))
+              << " per matrix), tile = " << tile << '\n';
+    header();
+    double s = best_seconds([&]() { transpose_naive(in.data(), expected.data(), n); });
+    report("naive", s, 0, bytes, true);
+    s = best_seconds([&]() { transpose_tiled(in.data(), out.data(), n, tile); });
+    report("tiled", s, 0, bytes, out == expected);
+    std::fill(out.begin(), out.end(), 0.0);
+    s = best_seconds([&]() { transpose_simd(in.data(), out.data(), n, tile); });
+    report("simd", s, 0, bytes, out == expected);
+    std::fill(out.begin(), out.end(), 0.0);
+    s = best_seconds([&]() { transpose_parallel(pool, in.data(), out.data(), n, tile); });
+    report("parallel", s, 0, bytes, out == expected);
+
+    std::cout << "\nsimd version by tile size\n"
+              << std::setw(6) << "tile" << std::setw(14) << "working set" << std::setw(10)
+              << "GB/s\n";
+    for (std::size_t t : {4, 8, 16, 32, 64, 128, 256}) {
+        if (n % t != 0)
+            continue;
+        s = best_seconds([&]() { transpose_simd(in.data(), out.data(), n, t); });
+        std::cout << std::setw(6) << t << std::setw(14) << kib(2.0 * t * t * sizeof(double))
+                  << std::fixed << std::setprecision(2) << std::setw(10) << bytes / s * 1e-9
+                  << std::defaultfloat << std::setprecision(6) << '\n';
+    }
+}
+
+// 4. Stencil
+void benchmark_stencil(ThreadPool &pool, std::size_t n) {
+    auto in = random_matrix(n);
+    std::vector<double> expected(n * n), out(n * n);
+    double flops = 4.0 * (n - 2) * (n - 2), bytes = 2.0 * n * n * sizeof(double);
+    std::size_t tile = 512;
+
+    std::cout << "Stencil, n = " << n << " (" << kib(n * n * sizeof(double))
+              << " per matrix), strips of " << tile << " columns\n";
+    header();
+    double s = best_seconds([&]() { stencil_naive(in.data(), expected.data(), n); });
+    report("naive", s, flops, bytes, true);
+    s = best_seconds([&]() { stencil_tiled(in.data(), out.data(), n, tile); });
+    report("tiled", s, flops, bytes, out == expected);
+    std::fill(out.begin(), out.end(), 0.0);
+    s = best_seconds([&]() { stencil_simd(in.data(), out.data(), n, tile); });
+    report("simd", s, flops, bytes, out == expected);
+    std::fill(out.begin(), out.end(), 0.0);
+    s = best_seconds([&]() { stencil_parallel(pool, in.data(), out.data(), n, tile); });
+    report("parallel", s, flops, bytes, out == expected);
+
+    // Repeated sweeps over a small grid find it in the cache; a large one comes from memory
+    std::cout << "\nsimd version by matrix size\n"
+              << std::setw(6) << "n" << std::setw(14) << "working set" << std::setw(10)
+              << "GB/s\n";
+    for (std::size_t m = 32; m <= n; m *= 2) {
+        auto grid = random_matrix(m);
+        std::vector<double> next(m * m);
+        s = best_seconds([&]() { stencil_simd(grid.data(), next.data(), m, tile); });
+        std::cout << std::setw(6) << m << std::setw(14) << kib(2.0 * m * m * sizeof(double))
+                  << std::fixed << std::setprecision(2) << std::setw(10)
+                  << 2.0 * m * m * sizeof(double) / s * 1e-9 << std::defaultfloat
+                  << std::setprecision(6) << '\n';
+    }
+}
+
+// g++ -std=c++20 -Wall -Wextra -pedantic -pthread -O2 main.cpp kernels.cpp thread_pool.cpp && ./a.out
+int main(int argc, char *argv[]) {
+    std::size_t n = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1024;
+    if (n == 0 || n % 256 != 0) {
+        std::cerr << "n must be a multiple of 256\n";
+        return 1;
+    }
+    int nthreads = argc > 2 ? std::atoi(argv[2]) : ThreadPool::default_thread_count() + 1;
+    ThreadPool pool(nthreads - 1); // The calling thread works too
+
+    describe_machine(pool);
+
+    std::cout << "--------------------------------\n";
+    benchmark_matmul(pool, n);
+
+    std::cout << "--------------------------------\n";
+    benchmark_transpose(pool, 4 * n);
+
+    std::cout << "--------------------------------\n";
+    benchmark_stencil(pool, 4 * n);
+}
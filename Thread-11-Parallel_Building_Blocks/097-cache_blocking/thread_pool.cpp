@@ -0,0 +1,156 @@
+/**
+ * Work-stealing thread pool for fork-join algorithms
+ */
+
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace {
+// Which pool the current thread works for, and its queue
+thread_local const ThreadPool *current_pool = nullptr;
+thread_local int current_queue = -1;
+} // namespace
+
+int ThreadPool::default_thread_count() {
+    // hardware_concurrency() may return 0 if it does not know
+    return std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+}
+
+// Constructor
+ThreadPool::ThreadPool(int nthreads) {
+    this->thread_count = std::max(1, nthreads);
+
+    // Create a dynamic array of queues
+    this->work_queues = std::make_unique<WorkQueue[]>(this->thread_count);
+
+    // Start the threads
+    for (int i = 0; i < this->thread_count; ++i) {
+        this->threads.push_back(std::thread{&ThreadPool::worker, this, i});
+    }
+}
+
+// Destructor
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lck_guard(this->sleep_mut);
+        this->stopping = true;
+    }
+    this->sleep_cv.notify_all();
+
+    // Wait for the threads to finish
+    for (auto &thr : this->threads) {
+        thr.join();
+    }
+}
+
+int ThreadPool::current_index() const { return current_pool == this ? current_queue : -1; }
+
+bool ThreadPool::try_pop(int idx, Func &task) {
+    WorkQueue &que = this->work_queues[idx];
+    std::lock_guard<std::mutex> lck_guard(que.mut);
+    if (que.tasks.empty())
+        return false;
+    task = std::move(que.tasks.back());
+    que.tasks.pop_back();
+    this->queued.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool ThreadPool::try_steal(int idx, Func &task) {
+    // Visit the other queues in turn, starting with the next one
+    for (int n = 0; n < this->thread_count; ++n) {
+        int victim = (idx + 1 + n) % this->thread_count;
+        if (victim == idx)
+            continue;
+
+        WorkQueue &que = this->work_queues[victim];
+        std::lock_guard<std::mutex> lck_guard(que.mut);
+        if (!que.tasks.empty()) {
+            task = std::move(que.tasks.front());
+            que.tasks.pop_front();
+            this->queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::run_pending_task() {
+    // A thread which is not a worker has no queue of its own (idx is -1), so it steals from all
+    // of them
+    int idx = this->current_index();
+    Func task;
+    if ((idx >= 0 && this->try_pop(idx, task)) || this->try_steal(idx, task)) {
+        task();
+        return true;
+    }
+    return false;
+}
+
+// Entry point function for the threads
+void ThreadPool::worker(int idx) {
+    current_pool = this;
+    current_queue = idx;
+
+    while (true) {
+        Func task;
+        if (this->try_pop(idx, task) || this->try_steal(idx, task)) {
+            // Invoke the task function
+            task();
+            continue;
+        }
+
+        // Nothing to do. Sleep until a task is submitted.
+        // submit() increments "queued" and then checks "sleepers"; we increment "sleepers" and
+        // then check "queued". With sequentially consistent operations, at least one of us sees
+        // the other's increment, so a task cannot be submitted without waking anybody.
+        std::unique_lock<std::mutex> lck_guard(this->sleep_mut);
+        this->sleepers.fetch_add(1);
+        this->sleep_cv.wait(lck_guard, [this]() { return this->stopping || this->queued > 0; });
+        this->sleepers.fetch_sub(1);
+
+        // Finish the queued tasks before stopping
+        if (this->stopping && this->queued == 0)
+            return;
+    }
+}
+
+// Choose a queue and add a task to it
+void ThreadPool::submit(Func func) {
+    int idx = current_index();
+    if (idx < 0)
+        idx = this->next_queue.fetch_add(1, std::memory_order_relaxed) % this->thread_count;
+
+    {
+        WorkQueue &que = this->work_queues[idx];
+        std::lock_guard<std::mutex> lck_guard(que.mut);
+        que.tasks.push_back(std::move(func));
+    }
+    this->queued.fetch_add(1);
+
+    // Only take the lock if a worker may be asleep
+    if (this->sleepers.load() > 0) {
+        std::lock_guard<std::mutex> lck_guard(this->sleep_mut);
+        this->sleep_cv.notify_one();
+    }
+}
+
+void TaskGroup::wait_for_tasks() {
+    while (this->unfinished.load(std::memory_order_acquire) > 0) {
+        // Help with the queued tasks. If there are none, the last of our tasks are running on
+        // other threads, and will not be long.
+        if (!this->pool.run_pending_task())
+            std::this_thread::yield();
+    }
+}
+
+void TaskGroup::wait() {
+    this->wait_for_tasks();
+
+    if (this->error) {
+        std::exception_ptr err = this->error;
+        this->error = nullptr;
+        std::rethrow_exception(err);
+    }
+}
@@ -0,0 +1,353 @@
+/**
+ * Parallel histogram and group-by aggregation
+ *
+ * 075-new_parallel_algorithms_practical.cpp reduces a whole range to one value with
+ * transform_reduce. A group-by reduces it to one value per key, like
+ *     SELECT key, COUNT(*), SUM(value), MIN(value), MAX(value) FROM data GROUP BY key
+ * The per-key results are an Aggregate: count, sum, min and max (and the mean from those).
+ *
+ * Updating one shared table from every thread would need a lock, or an atomic, for every element.
+ * Instead, each thread aggregates into its own table, and the tables are combined at the end:
+ *
+ * - parallel_histogram(): keys which are small integers, [0, nbins). Each block of the input
+ *   counts into its own array, and the arrays are added up.
+ * - group_by_local(): any keys. Each block of the input aggregates into its own hash table, and
+ *   the tables are merged into one. Fast when there are few distinct keys: the tables are small,
+ *   stay in the cache, and merging them costs little. With many distinct keys, every block's table
+ *   holds most of the keys, the tables do not fit in the cache, and the merge redoes the work.
+ * - group_by_partitioned(): for many distinct keys. The elements are first moved into 256
+ *   partitions by the top byte of the hash of their key, as a radix sort moves them by a digit
+ *   (091-parallel_sort). Each key is in exactly one partition, so the partitions are aggregated
+ *   independently, in parallel, into tables about 256 times smaller, and there is nothing to
+ *   merge. The price is one extra pass which copies every key and value.
+ * - group_by(): looks at a sample of the keys, and chooses one of the two.
+ *
+ * The results are returned as a vector of (key, Aggregate) pairs, in no particular order.
+ *
+ * Keys need std::hash (or another hash function given as the Hash argument), operator== and a
+ * default constructor. Values need +, < and a default constructor. Floating-point sums are added
+ * in an order which depends on the number of threads, so they may differ in the last bits from
+ * one run to another; integer sums are exact.
+ */
+
+#ifndef GROUP_BY_H
+#define GROUP_BY_H
+
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+template <class V> struct Aggregate {
+    std::size_t count{0};
+    V sum{};
+    V min{};
+    V max{};
+
+    void add(const V &value) {
+        if (count == 0) {
+            min = max = value;
+        } else {
+            if (value < min)
+                min = value;
+            if (max < value)
+                max = value;
+        }
+        sum = sum + value;
+        ++count;
+    }
+
+    void merge(const Aggregate &other) {
+        if (other.count == 0)
+            return;
+        if (count == 0) {
+            *this = other;
+            return;
+        }
+        count += other.count;
+        sum = sum + other.sum;
+        if (other.min < min)
+            min = other.min;
+        if (max < other.max)
+            max = other.max;
+    }
+
+    double mean() const { return static_cast<double>(sum) / static_cast<double>(count); }
+};
+
+template <class K, class V> using GroupByResult = std::vector<std::pair<K, Aggregate<V>>>;
+
+namespace group_by_detail {
+
+// std::hash of an integer is the integer itself in libstdc++. Keys which differ only in their high
+// bits would all land in the same slot, and keys which differ only in their low bits in the same
+// partition. Multiplying by 2^64 / golden ratio ("Fibonacci hashing") makes the high bits of the
+// product depend on every bit of the hash, and costs a single multiplication.
+inline std::uint64_t mix(std::uint64_t h) { return h * 0x9E3779B97F4A7C15ULL; }
+
+// The partition is chosen by the top byte of the mixed hash, and the slot in a table by the bits
+// below it, so the keys of one partition are still spread over the slots of its table
+constexpr int partition_bits = 8;
+constexpr std::size_t partitions = std::size_t{1} << partition_bits;
+
+inline std::size_t partition_of(std::uint64_t h) { return h >> (64 - partition_bits); }
+
+} // namespace group_by_detail
+
+// A hash table from keys to Aggregates, with open addressing and linear probing: the slots are in
+// one array, and a key which finds its slot taken goes to the next one. It grows when it is half
+// full. Keys are never removed.
+template <class K, class V, class Hash = std::hash<K>> class AggregateTable {
+    struct Slot {
+        K key{};
+        Aggregate<V> agg{};
+        bool used{false};
+    };
+
+    std::vector<Slot> slots;
+    std::size_t mask;
+    int shift; // The slot is (hash >> shift) & mask
+    std::size_t used_count{0};
+    Hash hasher;
+
+    void grow() {
+        std::vector<Slot> old(2 * slots.size());
+        old.swap(slots);
+        mask = slots.size() - 1;
+        shift = 64 - group_by_detail::partition_bits - std::countr_zero(slots.size());
+        for (Slot &s : old) {
+            if (s.used) {
+                Slot &dst = slots[find_slot(s.key, hash(s.key))];
+                dst = std::move(s);
+            }
+        }
+    }
+
+    // The slot which holds key, or the empty slot where it belongs
+    std::size_t find_slot(const K &key, std::uint64_t h) const {
+        std::size_t i = (h >> shift) & mask;
+        while (slots[i].used && !(slots[i].key == key))
+            i = (i + 1) & mask;
+        return i;
+    }
+
+  public:
+    // Room for "expected" keys without growing
+    explicit AggregateTable(std::size_t expected = 16, Hash hash_fn = Hash{})
+        : slots(std::bit_ceil(std::max<std::size_t>(2 * expected, 16))), mask(slots.size() - 1),
+          shift(64 - group_by_detail::partition_bits - std::countr_zero(slots.size())),
+          hasher(std::move(hash_fn)) {}
+
+    std::uint64_t hash(const K &key) const { return group_by_detail::mix(hasher(key)); }
+
+    std::size_t size() const { return used_count; }
+
+    // The Aggregate of key, which is added if it is not there. h is hash(key).
+    Aggregate<V> &operator()(const K &key, std::uint64_t h) {
+        std::size_t i = find_slot(key, h);
+        if (!slots[i].used) {
+            if (2 * (used_count + 1) > slots.size()) {
+                grow();
+                i = find_slot(key, h);
+            }
+            slots[i].key = key;
+            slots[i].used = true;
+            ++used_count;
+        }
+        return slots[i].agg;
+    }
+
+    void add(const K &key, const V &value) { (*this)(key, hash(key)).add(value); }
+
+    void merge(const AggregateTable &other) {
+        for (const Slot &s : other.slots)
+            if (s.used)
+                (*this)(s.key, hash(s.key)).merge(s.agg);
+    }
+
+    // Move the (key, Aggregate) pairs to the end of "out"
+    void extract(GroupByResult<K, V> &out) {
+        for (Slot &s : slots)
+            if (s.used)
+                out.emplace_back(std::move(s.key), s.agg);
+    }
+};
+
+//----------------------------------------------------------------------------------------------
+// Histogram
+
+// Count the elements in each bin. bin(element) must be in [0, nbins).
+template <std::random_access_iterator It, class BinFn>
+std::vector<std::size_t> parallel_histogram(ThreadPool &pool, It first, It last,
+                                            std::size_t nbins, BinFn bin) {
+    std::size_t n = last - first;
+    if (nbins == 0)
+        return {};
+    std::size_t nblocks = block_count(pool, n);
+    std::vector<std::vector<std::size_t>> local(nblocks);
+
+    parallel_blocks(pool, nblocks, [&](std::size_t b) {
+        std::vector<std::size_t> counts(nbins);
+        for (std::size_t i = block_begin(n, nblocks, b); i < block_begin(n, nblocks, b + 1); ++i)
+            ++counts[bin(first[i])];
+        local[b] = std::move(counts);
+    });
+
+    // Add up the blocks' counts, one range of bins per task
+    std::vector<std::size_t> result(nbins);
+    std::size_t nranges = std::min(nblocks, nbins);
+    parallel_blocks(pool, nranges, [&](std::size_t r) {
+        for (std::size_t bin_index = block_begin(nbins, nranges, r);
+             bin_index < block_begin(nbins, nranges, r + 1); ++bin_index)
+            for (const auto &counts : local)
+                result[bin_index] += counts[bin_index];
+    });
+    return result;
+}
+
+//----------------------------------------------------------------------------------------------
+// Group-by
+
+// Aggregate value(element) by key(element), with one hash table per block, merged at the end
+template <class Hash = void, std::random_access_iterator It, class KeyFn, class ValueFn>
+auto group_by_local(ThreadPool &pool, It first, It last, KeyFn key, ValueFn value) {
+    using K = std::decay_t<decltype(key(*first))>;
+    using V = std::decay_t<decltype(value(*first))>;
+    using H = std::conditional_t<std::is_void_v<Hash>, std::hash<K>, Hash>;
+    using Table = AggregateTable<K, V, H>;
+
+    std::size_t n = last - first;
+    std::size_t nblocks = block_count(pool, n);
+    std::vector<std::unique_ptr<Table>> tables(nblocks);
+
+    parallel_blocks(pool, nblocks, [&](std::size_t b) {
+        auto table = std::make_unique<Table>();
+        for (std::size_t i = block_begin(n, nblocks, b); i < block_begin(n, nblocks, b + 1); ++i)
+            table->add(key(first[i]), value(first[i]));
+        tables[b] = std::move(table);
+    });
+
+    // Merge pairs of tables, in rounds, so that the merging is parallel too
+    for (std::size_t step = 1; step < nblocks; step *= 2) {
+        std::size_t npairs = (nblocks - step + 2 * step - 1) / (2 * step);
+        parallel_blocks(pool, npairs, [&](std::size_t p) {
+            std::size_t dst = 2 * step * p;
+            tables[dst]->merge(*tables[dst + step]);
+            tables[dst + step].reset();
+        });
+    }
+
+    GroupByResult<K, V> result;
+    result.reserve(tables[0]->size());
+    tables[0]->extract(result);
+    return result;
+}
+
+// Aggregate value(element) by key(element): move the keys and values into partitions by the
+// hash of the key, then aggregate each partition on its own
+template <class Hash = void, std::random_access_iterator It, class KeyFn, class ValueFn>
+auto group_by_partitioned(ThreadPool &pool, It first, It last, KeyFn key, ValueFn value) {
+    using K = std::decay_t<decltype(key(*first))>;
+    using V = std::decay_t<decltype(value(*first))>;
+    using H = std::conditional_t<std::is_void_v<Hash>, std::hash<K>, Hash>;
+    using Table = AggregateTable<K, V, H>;
+    using group_by_detail::partition_of;
+    using group_by_detail::partitions;
+
+    std::size_t n = last - first;
+    std::size_t nblocks = block_count(pool, n);
+    const Table hasher(0); // Only used for hash()
+
+    // 1. Count the elements of each block in each partition
+    std::vector<std::array<std::size_t, partitions>> offsets(nblocks);
+    parallel_blocks(pool, nblocks, [&](std::size_t b) {
+        auto &counts = offsets[b];
+        counts.fill(0);
+        for (std::size_t i = block_begin(n, nblocks, b); i < block_begin(n, nblocks, b + 1); ++i)
+            ++counts[partition_of(hasher.hash(key(first[i])))];
+    });
+
+    // 2. Positions: partition 0 (from block 0, then block 1, ...), then partition 1, and so on
+    std::array<std::size_t, partitions + 1> partition_begin;
+    std::size_t pos = 0;
+    for (std::size_t p = 0; p < partitions; ++p) {
+        partition_begin[p] = pos;
+        for (std::size_t b = 0; b < nblocks; ++b) {
+            std::size_t count = offsets[b][p];
+            offsets[b][p] = pos;
+            pos += count;
+        }
+    }
+    partition_begin[partitions] = pos;
+
+    // 3. Scatter the keys and values. The buffers are not initialized: each element is written
+    // exactly once.
+    auto keys = std::make_unique_for_overwrite<K[]>(n);
+    auto values = std::make_unique_for_overwrite<V[]>(n);
+    parallel_blocks(pool, nblocks, [&](std::size_t b) {
+        auto &next = offsets[b];
+        for (std::size_t i = block_begin(n, nblocks, b); i < block_begin(n, nblocks, b + 1); ++i) {
+            K k = key(first[i]);
+            std::size_t pos = next[partition_of(hasher.hash(k))]++;
+            keys[pos] = std::move(k);
+            values[pos] = value(first[i]);
+        }
+    });
+
+    // 4. Aggregate each partition. Its table starts small, since there may be far fewer keys than
+    // elements, and grows if it must.
+    std::vector<GroupByResult<K, V>> groups(partitions);
+    parallel_blocks(pool, partitions, [&](std::size_t p) {
+        std::size_t begin = partition_begin[p], end = partition_begin[p + 1];
+        if (begin == end)
+            return;
+        Table table(std::min<std::size_t>(end - begin, 1024));
+        for (std::size_t i = begin; i < end; ++i)
+            table.add(keys[i], values[i]);
+        groups[p].reserve(table.size());
+        table.extract(groups[p]);
+    });
+
+    // 5. Concatenate
+    std::size_t total = 0;
+    for (auto &g : groups)
+        total += g.size();
+    GroupByResult<K, V> result;
+    result.reserve(total);
+    for (auto &g : groups)
+        std::move(g.begin(), g.end(), std::back_inserter(result));
+    return result;
+}
+
+// Above this fraction of distinct keys in a sample, group_by() partitions
+constexpr double group_by_distinct_fraction = 0.25;
+
+// group_by_local() or group_by_partitioned(), depending on how many distinct keys there are in a
+// sample of up to 16K elements, spread over the range
+template <class Hash = void, std::random_access_iterator It, class KeyFn, class ValueFn>
+auto group_by(ThreadPool &pool, It first, It last, KeyFn key, ValueFn value) {
+    using K = std::decay_t<decltype(key(*first))>;
+    using H = std::conditional_t<std::is_void_v<Hash>, std::hash<K>, Hash>;
+
+    std::size_t n = last - first;
+    std::size_t sample = std::min<std::size_t>(n, 16 * 1024);
+    std::unordered_set<K, H> distinct;
+    for (std::size_t s = 0; s < sample; ++s)
+        distinct.insert(key(first[n / sample * s]));
+
+    if (distinct.size() > group_by_distinct_fraction * sample)
+        return group_by_partitioned<Hash>(pool, first, last, key, value);
+    return group_by_local<Hash>(pool, first, last, key, value);
+}
+
+#endif // GROUP_BY_H
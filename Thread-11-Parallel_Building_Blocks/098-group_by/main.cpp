@@ -0,0 +1,170 @@
+/**
+ * Aggregation by key with group_by.h, on a table of sales
+ *
+ * 1. A histogram: the number of sales in each hour of the day.
+ * 2. A report: count, total, smallest, largest and mean sale for each product category.
+ * 3. Few distinct keys: totals per store. Each version is compared with a sequential
+ *    std::unordered_map, for its result and its time.
+ * 4. Many distinct keys: totals per customer, where the partitioned version wins.
+ *
+ * Usage: ./a.out [number of sales] (default 10 million)
+ */
+
+#include "group_by.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+static std::mt19937_64 mt;
+
+struct Sale {
+    std::uint64_t customer;
+    std::int64_t cents;
+    std::uint32_t store;
+    std::uint8_t hour;
+    std::uint8_t category;
+};
+
+const std::vector<std::string> categories{"books", "clothes", "food", "garden", "music", "toys"};
+
+std::vector<Sale> make_sales(std::size_t n, std::size_t nstores, std::size_t ncustomers) {
+    std::uniform_int_distribution<std::uint64_t> customer(0, ncustomers - 1);
+    std::uniform_int_distribution<std::uint32_t> store(0, nstores - 1);
+    std::lognormal_distribution<double> amount(3.0, 1.0);
+    std::normal_distribution<double> hour(14.0, 3.5);
+    std::uniform_int_distribution<int> category(0, categories.size() - 1);
+
+    std::vector<Sale> sales(n);
+    for (auto &s : sales) {
+        // Spread the customer numbers over 64 bits, as real identifiers would be
+        s.customer = customer(mt) * 0xD6E8FEB86659FD93ULL;
+        s.cents = 1 + static_cast<std::int64_t>(amount(mt) * 100);
+        s.store = store(mt);
+        s.hour = static_cast<std::uint8_t>(std::fmod(hour(mt) + 24.0, 24.0)); // Wrap at midnight
+        s.category = static_cast<std::uint8_t>(category(mt));
+    }
+    return sales;
+}
+
+template <typename Func> double time_ms(Func func) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+// The sequential version: one std::unordered_map
+template <class KeyFn>
+GroupByResult<decltype(KeyFn{}(Sale{})), std::int64_t>
+sequential_group_by(const std::vector<Sale> &sales, KeyFn key) {
+    using K = decltype(key(Sale{}));
+    std::unordered_map<K, Aggregate<std::int64_t>> map;
+    for (const auto &s : sales)
+        map[key(s)].add(s.cents);
+    return {map.begin(), map.end()};
+}
+
+template <class K, class V> bool same_groups(GroupByResult<K, V> x, GroupByResult<K, V> y) {
+    auto by_key = [](const auto &a, const auto &b) { return a.first < b.first; };
+    std::sort(x.begin(), x.end(), by_key);
+    std::sort(y.begin(), y.end(), by_key);
+    return std::equal(x.begin(), x.end(), y.begin(), y.end(), [](const auto &a, const auto &b) {
+        return a.first == b.first && a.second.count == b.second.count &&
+               a.second.sum == b.second.sum && a.second.min == b.second.min &&
+               a.second.max == b.second.max;
+    });
+}
+
+// 1. Histogram
+void sales_by_hour(ThreadPool &pool, const std::vector<Sale> &sales) {
+    auto counts = parallel_histogram(pool, sales.begin(), sales.end(), 24,
+                                     [](const Sale &s) { return s.hour; });
+    std::size_t largest = *std::max_element(counts.begin(), counts.end());
+    for (int h = 0; h < 24; ++h) {
+        std::cout << std::setw(2) << h << ":00 " << std::setw(9) << counts[h] << ' '
+                  << std::string(50 * counts[h] / largest, '#') << '\n';
+    }
+}
+
+// 2. A small report, with a string key
+void category_report(ThreadPool &pool, const std::vector<Sale> &sales) {
+    auto groups = group_by(
+        pool, sales.begin(), sales.end(),
+        [](const Sale &s) { return categories[s.category]; },
+        [](const Sale &s) { return s.cents; });
+    std::sort(groups.begin(), groups.end(),
+              [](const auto &a, const auto &b) { return a.second.sum > b.second.sum; });
+
+    std::cout << std::setw(10) << std::left << "category" << std::right << std::setw(10)
+              << "sales" << std::setw(16) << "total" << std::setw(10) << "min" << std::setw(12)
+              << "max" << std::setw(10) << "mean" << '\n'
+              << std::fixed << std::setprecision(2);
+    for (const auto &[name, agg] : groups) {
+        std::cout << std::setw(10) << std::left << name << std::right << std::setw(10)
+                  << agg.count << std::setw(16) << agg.sum / 100.0 << std::setw(10)
+                  << agg.min / 100.0 << std::setw(12) << agg.max / 100.0 << std::setw(10)
+                  << agg.mean() / 100.0 << '\n';
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+// 3. and 4. Each version, compared with the sequential one
+template <class KeyFn>
+void compare_versions(ThreadPool &pool, const std::vector<Sale> &sales, KeyFn key) {
+    auto cents = [](const Sale &s) { return s.cents; };
+    GroupByResult<decltype(key(Sale{})), std::int64_t> expected, groups;
+
+    double ms = time_ms([&]() { expected = sequential_group_by(sales, key); });
+    std::cout << expected.size() << " groups\n";
+    std::cout << std::setw(24) << std::left << "std::unordered_map" << std::right << std::fixed
+              << std::setprecision(1) << std::setw(10) << ms << " ms\n";
+
+    auto run = [&](const char *name, auto group_by_func) {
+        double ms = time_ms([&]() { groups = group_by_func(); });
+        std::cout << std::setw(24) << std::left << name << std::right << std::setw(10) << ms
+                  << " ms  " << (same_groups(groups, expected) ? "same result" : "WRONG") << '\n';
+    };
+    run("group_by_local", [&]() {
+        return group_by_local(pool, sales.begin(), sales.end(), key, cents);
+    });
+    run("group_by_partitioned", [&]() {
+        return group_by_partitioned(pool, sales.begin(), sales.end(), key, cents);
+    });
+    run("group_by", [&]() { return group_by(pool, sales.begin(), sales.end(), key, cents); });
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+// g++ -std=c++20 -Wall -Wextra -pedantic -pthread -O2 main.cpp thread_pool.cpp && ./a.out
+int main(int argc, char *argv[]) {
+    std::size_t n = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10'000'000;
+    if (n == 0) {
+        std::cerr << "The number of sales must be positive\n";
+        return 1;
+    }
+    ThreadPool pool;
+    std::cout << n << " sales, " << pool.size() + 1 << " threads\n";
+    auto sales = make_sales(n, 1000, std::max<std::size_t>(n / 4, 1));
+
+    std::cout << "--------------------------------\n";
+    sales_by_hour(pool, sales);
+
+    std::cout << "--------------------------------\n";
+    category_report(pool, sales);
+
+    std::cout << "--------------------------------\n";
+    std::cout << "Group by store: ";
+    compare_versions(pool, sales, [](const Sale &s) { return s.store; });
+
+    std::cout << "--------------------------------\n";
+    std::cout << "Group by customer: ";
+    compare_versions(pool, sales, [](const Sale &s) { return s.customer; });
+}
@@ -0,0 +1,467 @@
+/**
+ * The benchmarks: one operation on each primitive of the Thread-* chapters
+ *
+ * Where a chapter has its primitive in a header, the header is copied into this directory and
+ * benchmarked as it is. 081-semaphore.cpp prints from inside acquire() and release(), so its
+ * Semaphore is repeated here without the printing. So are the thread pools of 085 to 088, which
+ * print from their constructors, and are all named ThreadPool.
+ *
+ * Operations which need a partner run in pairs of threads: thread 2k and thread 2k + 1 (ping-pong),
+ * or even threads producing and odd threads consuming (queues). In the ping-pong benchmarks, one
+ * operation is one hand-off, so the latency is half a round trip plus the time the partner took.
+ */
+
+#include "harness.h"
+
+#include "async_on.h"
+#include "bounded_queue.h"
+#include "concurrent_queue.h"
+#include "concurrent_queue_cv.h"
+#include "sharded_counter.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <semaphore>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// The Semaphore of 081-semaphore.cpp, without the printing
+class Semaphore {
+    std::mutex mtx;
+    std::condition_variable cv;
+    int counter;
+
+  public:
+    explicit Semaphore(int initial = 0) : counter(initial) {}
+
+    void release() {
+        std::lock_guard<std::mutex> lock(mtx);
+        ++counter;
+        cv.notify_all();
+    }
+
+    void acquire() {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (counter == 0)
+            cv.wait(lock);
+        --counter;
+    }
+};
+
+// The Thread-10 pools start hardware_concurrency() - 1 workers. Here there is at least one: with
+// none, on a machine with one core, a task would never run.
+int thread10_pool_size() {
+    return std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+}
+
+// The ThreadPool of 085-thread_pool_basic_implementation, without the printing
+// One queue, shared by all the workers
+class BasicPool {
+    ConcurrentQueueCondVar<Func> work_queue;
+    std::vector<std::thread> threads;
+    int thread_count{thread10_pool_size()};
+
+    void worker() {
+        while (true) {
+            Func task;
+            work_queue.pop(task);
+
+            // Poison pill
+            if (!task)
+                break;
+            task();
+        }
+    }
+
+  public:
+    BasicPool() {
+        for (int i = 0; i < thread_count; ++i)
+            threads.push_back(std::thread{&BasicPool::worker, this});
+    }
+
+    ~BasicPool() {
+        for (int i = 0; i < thread_count; ++i)
+            work_queue.push(Func{});
+        for (auto &thr : threads)
+            thr.join();
+    }
+
+    void submit(Func func) { work_queue.push(func); }
+};
+
+// The ThreadPool of 086-thread_pool_multiple_queues and 087-thread_pool_work_stealing, without
+// the printing. One queue per worker, which submit() fills in turn. Its queue is the same as
+// ConcurrentQueueCondVar. 086 only submits from the main thread, so "pos" is a plain int there;
+// here several threads submit, so it is atomic.
+class MultiQueuePool {
+    // Before the queues, which are made in the constructor
+    int thread_count{thread10_pool_size()};
+    std::unique_ptr<ConcurrentQueueCondVar<Func>[]> work_queues;
+    std::vector<std::thread> threads;
+    std::atomic<unsigned> pos{0};
+
+    void worker(int idx) {
+        while (true) {
+            Func task;
+            work_queues[idx].pop(task);
+            if (!task)
+                return;
+            task();
+        }
+    }
+
+  public:
+    MultiQueuePool() : work_queues(std::make_unique<ConcurrentQueueCondVar<Func>[]>(thread_count)) {
+        for (int i = 0; i < thread_count; ++i)
+            threads.push_back(std::thread{&MultiQueuePool::worker, this, i});
+    }
+
+    ~MultiQueuePool() {
+        for (int i = 0; i < thread_count; ++i)
+            work_queues[i].push(Func{});
+        for (auto &thr : threads)
+            thr.join();
+    }
+
+    void submit(Func func) {
+        work_queues[pos.fetch_add(1, std::memory_order_relaxed) % thread_count].push(func);
+    }
+};
+
+// The ThreadPool of 088-thread_pool_work_stealing_contd, without the printing
+// A worker with nothing to do checks every queue, then sleeps for 10ms. That sleep is most of the
+// time a task takes when the pool is not busy. 088's destructor never stops the workers (its
+// TODO), so here they stop when "done" is set.
+class StealingPool {
+    std::mt19937 mt;
+    // Before the queues, which are made in the constructor
+    int thread_count{thread10_pool_size()};
+    std::unique_ptr<ConcurrentQueue<Func>[]> work_queues;
+    std::vector<std::thread> threads;
+    std::mutex rand_mut;
+    std::atomic<bool> done{false};
+
+    int get_random() {
+        std::lock_guard<std::mutex> lck_guard(rand_mut);
+        std::uniform_int_distribution<int> dist(0, thread_count - 1);
+        return dist(mt);
+    }
+
+    void worker(int idx) {
+        while (!done) {
+            int visited = 0;
+            Func task;
+            int i = idx;
+            while (!work_queues[i].try_pop(task)) {
+                if (done)
+                    return;
+                i = get_random();
+                if (++visited == thread_count) {
+                    std::this_thread::sleep_for(10ms);
+                    visited = 0;
+                    i = idx;
+                }
+            }
+            task();
+        }
+    }
+
+  public:
+    StealingPool() : work_queues(std::make_unique<ConcurrentQueue<Func>[]>(thread_count)) {
+        for (int i = 0; i < thread_count; ++i)
+            threads.push_back(std::thread{&StealingPool::worker, this, i});
+    }
+
+    ~StealingPool() {
+        done = true;
+        for (auto &thr : threads)
+            thr.join();
+    }
+
+    void submit(Func func) {
+        int i;
+        do {
+            i = get_random();
+        } while (!work_queues[i].try_push(func));
+    }
+};
+
+// Submit an empty task to a pool and wait until a promise which it sets is ready
+// The task owns the promise, so the promise lives until set_value() has returned.
+template <class Pool> auto make_submit_wait_op(std::shared_ptr<Pool> pool) {
+    return [pool](int) {
+        auto promise = std::make_shared<std::promise<void>>();
+        std::future<void> ready = promise->get_future();
+        pool->submit([promise]() { promise->set_value(); });
+        ready.get();
+    };
+}
+
+// A test-and-test-and-set spinlock on std::atomic_flag. It yields while it waits: with more
+// threads than cores, a thread which spins without yielding can keep the holder from running.
+class SpinLock {
+    std::atomic_flag flag;
+
+  public:
+    void lock() {
+        while (flag.test_and_set(std::memory_order_acquire)) {
+            while (flag.test(std::memory_order_relaxed))
+                std::this_thread::yield();
+        }
+    }
+    void unlock() { flag.clear(std::memory_order_release); }
+};
+
+// A counter on a cache line of its own
+struct alignas(cache_line_size) PaddedCounter {
+    std::atomic<long> value{0};
+};
+
+// Queue capacity, the same for every queue
+constexpr std::size_t queue_capacity = 1024;
+
+// Even threads push, odd threads pop, with try_push() and try_pop(), yielding while they fail
+template <class Queue> auto make_try_queue_op(std::shared_ptr<Queue> que) {
+    return [que](int thread) {
+        if (thread % 2 == 0) {
+            while (!que->try_push(int{thread}))
+                std::this_thread::yield();
+        } else {
+            int value;
+            while (!que->try_pop(value))
+                std::this_thread::yield();
+        }
+    };
+}
+
+void mutex_benchmarks(Registry &registry) {
+    registry.add("mutex", "std::mutex", 1, [](int) {
+        struct State {
+            std::mutex mut;
+            long counter{0};
+        };
+        auto state = std::make_shared<State>();
+        return [state](int) {
+            std::lock_guard<std::mutex> lck_guard(state->mut);
+            ++state->counter;
+        };
+    });
+    registry.add("mutex", "std::timed_mutex try_lock_for", 1, [](int) {
+        struct State {
+            std::timed_mutex mut;
+            long counter{0};
+        };
+        auto state = std::make_shared<State>();
+        return [state](int) {
+            while (!state->mut.try_lock_for(std::chrono::milliseconds(1))) {
+            }
+            ++state->counter;
+            state->mut.unlock();
+        };
+    });
+    registry.add("mutex", "SpinLock (atomic_flag)", 1, [](int) {
+        struct State {
+            SpinLock lock;
+            long counter{0};
+        };
+        auto state = std::make_shared<State>();
+        return [state](int) {
+            std::lock_guard<SpinLock> lck_guard(state->lock);
+            ++state->counter;
+        };
+    });
+    registry.add("mutex", "std::shared_mutex shared", 1, [](int) {
+        struct State {
+            std::shared_mutex mut;
+            long counter{0};
+        };
+        auto state = std::make_shared<State>();
+        return [state](int) {
+            std::shared_lock<std::shared_mutex> lck(state->mut);
+            volatile long value = state->counter;
+            (void)value;
+        };
+    });
+    registry.add("mutex", "std::shared_mutex exclusive", 1, [](int) {
+        struct State {
+            std::shared_mutex mut;
+            long counter{0};
+        };
+        auto state = std::make_shared<State>();
+        return [state](int) {
+            std::lock_guard<std::shared_mutex> lck_guard(state->mut);
+            ++state->counter;
+        };
+    });
+}
+
+void atomic_benchmarks(Registry &registry) {
+    registry.add("atomic", "fetch_add seq_cst (shared)", 1, [](int) {
+        auto counter = std::make_shared<PaddedCounter>();
+        return [counter](int) { counter->value.fetch_add(1); };
+    });
+    registry.add("atomic", "fetch_add relaxed (shared)", 1, [](int) {
+        auto counter = std::make_shared<PaddedCounter>();
+        return [counter](int) { counter->value.fetch_add(1, std::memory_order_relaxed); };
+    });
+    registry.add("atomic", "compare_exchange loop (shared)", 1, [](int) {
+        auto counter = std::make_shared<PaddedCounter>();
+        return [counter](int) {
+            long old = counter->value.load(std::memory_order_relaxed);
+            while (!counter->value.compare_exchange_weak(old, old + 1, std::memory_order_relaxed)) {
+            }
+        };
+    });
+    registry.add("atomic", "fetch_add relaxed (own cache line)", 1, [](int threads) {
+        std::shared_ptr<PaddedCounter[]> counters(new PaddedCounter[threads]);
+        return [counters](int thread) {
+            counters[thread].value.fetch_add(1, std::memory_order_relaxed);
+        };
+    });
+    registry.add("atomic", "ShardedCounter::add (058)", 1, [](int) {
+        auto counter = std::make_shared<ShardedCounter>();
+        return [counter](int) { counter->add(1); };
+    });
+}
+
+void condvar_benchmarks(Registry &registry) {
+    registry.add("condvar", "ping-pong (mutex + condition_variable)", 2, [](int threads) {
+        struct Pair {
+            std::mutex mut;
+            std::condition_variable cv;
+            bool even_turn{true};
+        };
+        std::shared_ptr<Pair[]> pairs(new Pair[threads / 2]);
+        return [pairs](int thread) {
+            Pair &p = pairs[thread / 2];
+            bool even = thread % 2 == 0;
+            std::unique_lock<std::mutex> lck(p.mut);
+            p.cv.wait(lck, [&]() { return p.even_turn == even; });
+            p.even_turn = !even;
+            p.cv.notify_one();
+        };
+    });
+    registry.add("condvar", "ping-pong (atomic wait/notify)", 2, [](int threads) {
+        struct alignas(cache_line_size) Pair {
+            std::atomic<bool> even_turn{true};
+        };
+        std::shared_ptr<Pair[]> pairs(new Pair[threads / 2]);
+        return [pairs](int thread) {
+            Pair &p = pairs[thread / 2];
+            bool even = thread % 2 == 0;
+            p.even_turn.wait(!even);
+            p.even_turn.store(!even);
+            p.even_turn.notify_one();
+        };
+    });
+}
+
+void semaphore_benchmarks(Registry &registry) {
+    registry.add("semaphore", "ping-pong std::binary_semaphore", 2, [](int threads) {
+        struct Pair {
+            std::binary_semaphore even_turn{1};
+            std::binary_semaphore odd_turn{0};
+        };
+        std::shared_ptr<Pair[]> pairs(new Pair[threads / 2]);
+        return [pairs](int thread) {
+            Pair &p = pairs[thread / 2];
+            if (thread % 2 == 0) {
+                p.even_turn.acquire();
+                p.odd_turn.release();
+            } else {
+                p.odd_turn.acquire();
+                p.even_turn.release();
+            }
+        };
+    });
+    registry.add("semaphore", "ping-pong Semaphore (081)", 2, [](int threads) {
+        struct Pair {
+            Semaphore even_turn{1};
+            Semaphore odd_turn{0};
+        };
+        std::shared_ptr<Pair[]> pairs(new Pair[threads / 2]);
+        return [pairs](int thread) {
+            Pair &p = pairs[thread / 2];
+            if (thread % 2 == 0) {
+                p.even_turn.acquire();
+                p.odd_turn.release();
+            } else {
+                p.odd_turn.acquire();
+                p.even_turn.release();
+            }
+        };
+    });
+    registry.add("semaphore", "std::counting_semaphore acquire+release", 1, [](int threads) {
+        // Half of the threads may hold it at once
+        auto sem = std::make_shared<std::counting_semaphore<>>(std::max(threads / 2, 1));
+        return [sem](int) {
+            sem->acquire();
+            sem->release();
+        };
+    });
+}
+
+void queue_benchmarks(Registry &registry) {
+    registry.add("queue", "ConcurrentQueueCondVar push/pop (085)", 2, [](int) {
+        auto que = std::make_shared<ConcurrentQueueCondVar<int>>(queue_capacity);
+        return [que](int thread) {
+            if (thread % 2 == 0) {
+                que->push(thread);
+            } else {
+                int value;
+                que->pop(value);
+            }
+        };
+    });
+    registry.add("queue", "ConcurrentQueue try_push/try_pop (088)", 2, [](int) {
+        return make_try_queue_op(std::make_shared<ConcurrentQueue<int>>(queue_capacity));
+    });
+    registry.add("queue", "BoundedQueue try_push/try_pop (094)", 2, [](int) {
+        return make_try_queue_op(std::make_shared<BoundedQueue<int>>(queue_capacity));
+    });
+}
+
+void pool_benchmarks(Registry &registry) {
+    registry.add("pool", "std::thread create+join", 1, [](int) {
+        return [](int) { std::thread([]() {}).join(); };
+    });
+    registry.add("pool", "std::async(launch::async) + get", 1, [](int) {
+        return [](int) { std::async(std::launch::async, []() {}).get(); };
+    });
+    registry.add("pool", "ThreadPool submit+wait (085)", 1,
+                 [](int) { return make_submit_wait_op(std::make_shared<BasicPool>()); });
+    registry.add("pool", "ThreadPool submit+wait (086/087)", 1,
+                 [](int) { return make_submit_wait_op(std::make_shared<MultiQueuePool>()); });
+    registry.add("pool", "ThreadPool submit+wait (088)", 1,
+                 [](int) { return make_submit_wait_op(std::make_shared<StealingPool>()); });
+    registry.add("pool", "async_on + get (096)", 1, [](int) {
+        return [](int) { async_on(shared_pool(), []() {}).get(); };
+    });
+    registry.add("pool", "TaskGroup run+wait (091)", 1, [](int) {
+        return [](int) {
+            TaskGroup group(shared_pool());
+            group.run([]() {});
+            group.wait();
+        };
+    });
+}
+
+} // namespace
+
+void register_benchmarks(Registry &registry) {
+    mutex_benchmarks(registry);
+    atomic_benchmarks(registry);
+    condvar_benchmarks(registry);
+    semaphore_benchmarks(registry);
+    queue_benchmarks(registry);
+    pool_benchmarks(registry);
+}
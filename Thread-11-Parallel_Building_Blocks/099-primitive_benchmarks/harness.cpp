@@ -0,0 +1,204 @@
+/**
+ * Microbenchmark harness implementation
+ */
+
+#include "harness.h"
+
+#include <cmath>
+#include <iomanip>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+
+namespace {
+
+// The value below which "fraction" of the samples lie. Sorts the samples.
+double percentile(std::vector<double> &samples, double fraction) {
+    if (samples.empty())
+        return 0.0;
+    auto k = static_cast<std::size_t>(fraction * (samples.size() - 1));
+    std::nth_element(samples.begin(), samples.begin() + k, samples.end());
+    return samples[k];
+}
+
+// 1234 -> "1.23 us"
+std::string format_ns(double ns) {
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(ns < 10 ? 2 : ns < 100 ? 1 : 0);
+    if (ns < 1e3)
+        os << ns << " ns";
+    else if (ns < 1e6)
+        os << std::setprecision(2) << ns / 1e3 << " us";
+    else
+        os << std::setprecision(2) << ns / 1e6 << " ms";
+    return os.str();
+}
+
+std::string json_string(const std::string &s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+    return out + '"';
+}
+
+const char *csv_header = "group,name,threads,ops,seconds,ops_per_second,p50_ns,p90_ns,p99_ns,"
+                         "p999_ns";
+
+} // namespace
+
+Result measure(const Benchmark &b, int threads, double target_seconds) {
+    // 1. Calibrate: find how long one operation takes on one thread, with all threads running
+    std::uint64_t iterations = 16;
+    Measurement m;
+    while (true) {
+        m = b.run(threads, iterations, iterations);
+        if (m.seconds >= target_seconds / 10 || iterations >= (std::uint64_t{1} << 32))
+            break;
+        iterations *= 8;
+    }
+    double op_seconds = m.seconds / iterations;
+
+    // 2. The measured run
+    iterations =
+        std::max<std::uint64_t>(1, static_cast<std::uint64_t>(target_seconds / op_seconds));
+    auto batch = static_cast<std::uint64_t>(std::clamp(1e-6 / op_seconds, 1.0, 1000.0));
+    m = b.run(threads, iterations, batch);
+
+    Result r;
+    r.group = b.group;
+    r.name = b.name;
+    r.threads = threads;
+    r.ops = iterations * threads;
+    r.seconds = m.seconds;
+    r.ops_per_second = r.ops / m.seconds;
+    r.p50_ns = percentile(m.op_nanoseconds, 0.5);
+    r.p90_ns = percentile(m.op_nanoseconds, 0.9);
+    r.p99_ns = percentile(m.op_nanoseconds, 0.99);
+    r.p999_ns = percentile(m.op_nanoseconds, 0.999);
+    return r;
+}
+
+//----------------------------------------------------------------------------------------------
+// Output
+
+void print_table_header(std::ostream &os) {
+    os << std::left << std::setw(10) << "group" << std::setw(38) << "operation" << std::right
+       << std::setw(8) << "threads" << std::setw(12) << "Mops/s" << std::setw(11) << "p50"
+       << std::setw(11) << "p90" << std::setw(11) << "p99" << std::setw(11) << "p99.9" << '\n';
+}
+
+void print_table_row(std::ostream &os, const Result &r) {
+    os << std::left << std::setw(10) << r.group << std::setw(38) << r.name << std::right
+       << std::setw(8) << r.threads << std::fixed << std::setprecision(3) << std::setw(12)
+       << r.ops_per_second / 1e6 << std::defaultfloat << std::setprecision(6) << std::setw(11)
+       << format_ns(r.p50_ns) << std::setw(11) << format_ns(r.p90_ns) << std::setw(11)
+       << format_ns(r.p99_ns) << std::setw(11) << format_ns(r.p999_ns) << '\n';
+}
+
+// Names must not contain commas: the harness's own names do not
+void write_csv(std::ostream &os, const std::vector<Result> &results) {
+    os << csv_header << '\n' << std::setprecision(10);
+    for (const auto &r : results) {
+        os << r.group << ',' << r.name << ',' << r.threads << ',' << r.ops << ',' << r.seconds
+           << ',' << r.ops_per_second << ',' << r.p50_ns << ',' << r.p90_ns << ',' << r.p99_ns
+           << ',' << r.p999_ns << '\n';
+    }
+    os << std::setprecision(6);
+}
+
+void write_json(std::ostream &os, const std::vector<Result> &results) {
+    os << "[\n" << std::setprecision(10);
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const auto &r = results[i];
+        os << "  {\"group\": " << json_string(r.group) << ", \"name\": " << json_string(r.name)
+           << ", \"threads\": " << r.threads << ", \"ops\": " << r.ops
+           << ", \"seconds\": " << r.seconds << ", \"ops_per_second\": " << r.ops_per_second
+           << ", \"p50_ns\": " << r.p50_ns << ", \"p90_ns\": " << r.p90_ns
+           << ", \"p99_ns\": " << r.p99_ns << ", \"p999_ns\": " << r.p999_ns << '}'
+           << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    os << "]\n" << std::setprecision(6);
+}
+
+std::vector<Result> read_csv(std::istream &is) {
+    std::string line;
+    if (!std::getline(is, line) || line != csv_header)
+        throw std::runtime_error("not a benchmark CSV file: the header is missing");
+
+    std::vector<Result> results;
+    int line_number = 1;
+    while (std::getline(is, line)) {
+        ++line_number;
+        if (line.empty())
+            continue;
+        std::vector<std::string> fields;
+        std::istringstream ss(line);
+        for (std::string field; std::getline(ss, field, ',');)
+            fields.push_back(field);
+        if (fields.size() != 10)
+            throw std::runtime_error("line " + std::to_string(line_number) +
+                                     ": expected 10 fields");
+
+        try {
+            Result r;
+            r.group = fields[0];
+            r.name = fields[1];
+            r.threads = std::stoi(fields[2]);
+            r.ops = std::stoull(fields[3]);
+            r.seconds = std::stod(fields[4]);
+            r.ops_per_second = std::stod(fields[5]);
+            r.p50_ns = std::stod(fields[6]);
+            r.p90_ns = std::stod(fields[7]);
+            r.p99_ns = std::stod(fields[8]);
+            r.p999_ns = std::stod(fields[9]);
+            results.push_back(r);
+        } catch (const std::logic_error &) { // std::stoi and friends throw invalid_argument
+            throw std::runtime_error("line " + std::to_string(line_number) + ": bad number");
+        }
+    }
+    return results;
+}
+
+//----------------------------------------------------------------------------------------------
+// Comparison
+
+int compare_results(std::ostream &os, const std::vector<Result> &baseline,
+                    const std::vector<Result> &results, double threshold_percent) {
+    std::map<std::tuple<std::string, std::string, int>, const Result *> old_results;
+    for (const auto &r : baseline)
+        old_results[{r.group, r.name, r.threads}] = &r;
+
+    os << std::left << std::setw(10) << "group" << std::setw(38) << "operation" << std::right
+       << std::setw(8) << "threads" << std::setw(12) << "old Mops/s" << std::setw(12)
+       << "new Mops/s" << std::setw(9) << "change" << std::setw(11) << "old p99" << std::setw(11)
+       << "new p99" << '\n';
+
+    int regressions = 0;
+    for (const auto &r : results) {
+        os << std::left << std::setw(10) << r.group << std::setw(38) << r.name << std::right
+           << std::setw(8) << r.threads;
+        auto it = old_results.find({r.group, r.name, r.threads});
+        if (it == old_results.end()) {
+            os << std::setw(12) << "-" << std::fixed << std::setprecision(3) << std::setw(12)
+               << r.ops_per_second / 1e6 << std::defaultfloat << std::setprecision(6)
+               << "  (not in the baseline)\n";
+            continue;
+        }
+        const Result &old = *it->second;
+        double change = 100.0 * (r.ops_per_second / old.ops_per_second - 1.0);
+        bool regression = change < -threshold_percent;
+        regressions += regression;
+        os << std::fixed << std::setprecision(3) << std::setw(12) << old.ops_per_second / 1e6
+           << std::setw(12) << r.ops_per_second / 1e6 << std::setprecision(1) << std::setw(8)
+           << std::showpos << change << '%' << std::noshowpos << std::defaultfloat
+           << std::setprecision(6) << std::setw(11) << format_ns(old.p99_ns) << std::setw(11)
+           << format_ns(r.p99_ns) << (regression ? "  REGRESSION" : "") << '\n';
+    }
+    return regressions;
+}
@@ -0,0 +1,153 @@
+/**
+ * A small microbenchmark harness for concurrency primitives
+ *
+ * A benchmark is one operation on a primitive: lock and unlock a mutex, push or pop a queue, run a
+ * task on a pool. It is registered with a function which, given the number of threads, creates a
+ * fresh primitive and returns the operation as a function object op(thread), where thread is
+ * 0, 1, ..., threads - 1:
+ *     registry.add("mutex", "std::mutex", 1, [](int threads) {
+ *         auto mut = std::make_shared<std::mutex>();
+ *         return [mut](int) { std::lock_guard<std::mutex> lck_guard(*mut); };
+ *     });
+ * Some operations only make sense in pairs of threads, e.g. a producer (even thread) and a
+ * consumer (odd thread). thread_multiple is 2 for them, and they only run with an even number of
+ * threads.
+ *
+ * Each thread runs the operation the same number of times, so that a producer and a consumer make
+ * the same number of calls and both finish. The harness:
+ * 1. Calibrates: runs with more and more iterations until a run takes a tenth of the target time,
+ *    then picks the number of iterations for the target time.
+ * 2. Starts the threads together, and measures the time until the last one finishes.
+ * 3. Times the operations in batches. A clock read costs about 20 ns, which is more than some
+ *    operations take, so a fast operation is timed in batches of up to 1000, long enough to take
+ *    about a microsecond, and each operation in a batch is given the batch's mean time. Operations
+ *    which take a microsecond or more are timed one by one.
+ *
+ * A Result holds the throughput (operations per second, all threads together) and latency
+ * percentiles (p50, p90, p99 and p99.9) in nanoseconds. Results can be written as CSV or JSON,
+ * and compared with the CSV of an earlier run: an operation whose throughput fell by more than the
+ * threshold is a regression.
+ */
+
+#ifndef HARNESS_H
+#define HARNESS_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// What one run measured
+struct Measurement {
+    double seconds{0.0};               // From the start of the threads until the last one finished
+    std::vector<double> op_nanoseconds; // One per operation or batch, from all the threads
+};
+
+// Run op(thread) "iterations" times on each of "nthreads" threads, timing it in batches
+template <class Op>
+Measurement run_threads(int nthreads, std::uint64_t iterations, std::uint64_t batch, Op &op) {
+    using Clock = std::chrono::steady_clock;
+    std::vector<std::vector<double>> samples(nthreads);
+    std::atomic<int> ready{0};
+    std::atomic<bool> go{false};
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nthreads; ++t) {
+        threads.emplace_back([&, t]() {
+            auto &my_samples = samples[t];
+            my_samples.reserve(iterations / batch + 1);
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+
+            for (std::uint64_t done = 0; done < iterations;) {
+                std::uint64_t n = std::min(batch, iterations - done);
+                auto start = Clock::now();
+                for (std::uint64_t k = 0; k < n; ++k)
+                    op(t);
+                auto end = Clock::now();
+                my_samples.push_back(std::chrono::duration<double, std::nano>(end - start).count() /
+                                     n);
+                done += n;
+            }
+        });
+    }
+
+    // Start the clock when every thread is ready
+    while (ready.load() < nthreads)
+        std::this_thread::yield();
+    auto start = Clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto &thr : threads)
+        thr.join();
+
+    Measurement m;
+    m.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    for (auto &s : samples)
+        m.op_nanoseconds.insert(m.op_nanoseconds.end(), s.begin(), s.end());
+    return m;
+}
+
+struct Benchmark {
+    std::string group;
+    std::string name;
+    int thread_multiple;
+    // Run with a fresh primitive: (threads, iterations per thread, batch size)
+    std::function<Measurement(int, std::uint64_t, std::uint64_t)> run;
+};
+
+class Registry {
+    std::vector<Benchmark> list;
+
+  public:
+    // make_op(threads) returns the operation, a function object called as op(thread)
+    template <class MakeOp>
+    void add(std::string group, std::string name, int thread_multiple, MakeOp make_op) {
+        list.push_back({std::move(group), std::move(name), thread_multiple,
+                        [make_op](int threads, std::uint64_t iterations, std::uint64_t batch) {
+                            auto op = make_op(threads);
+                            return run_threads(threads, iterations, batch, op);
+                        }});
+    }
+
+    const std::vector<Benchmark> &benchmarks() const { return list; }
+};
+
+struct Result {
+    std::string group;
+    std::string name;
+    int threads{0};
+    std::uint64_t ops{0}; // All threads together
+    double seconds{0.0};
+    double ops_per_second{0.0};
+    double p50_ns{0.0};
+    double p90_ns{0.0};
+    double p99_ns{0.0};
+    double p999_ns{0.0};
+};
+
+// Calibrate, then run b on "threads" threads for about target_seconds
+Result measure(const Benchmark &b, int threads, double target_seconds);
+
+// Output
+void print_table_header(std::ostream &os);
+void print_table_row(std::ostream &os, const Result &r);
+void write_csv(std::ostream &os, const std::vector<Result> &results);
+void write_json(std::ostream &os, const std::vector<Result> &results);
+std::vector<Result> read_csv(std::istream &is); // Throws std::runtime_error if malformed
+
+// Print each result next to the baseline's, and return the number of regressions: results whose
+// throughput is more than threshold_percent below the baseline's
+int compare_results(std::ostream &os, const std::vector<Result> &baseline,
+                    const std::vector<Result> &results, double threshold_percent);
+
+// The benchmarks of the primitives of the Thread-* chapters (benchmarks.cpp)
+void register_benchmarks(Registry &registry);
+
+#endif // HARNESS_H
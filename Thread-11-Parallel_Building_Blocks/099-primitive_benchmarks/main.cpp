@@ -0,0 +1,188 @@
+/**
+ * Microbenchmarks of the concurrency primitives of the Thread-* chapters
+ *
+ * The chapters print to std::cout and sleep, to show how the primitives behave. This program
+ * measures them instead: for each primitive and each number of threads, the throughput in
+ * millions of operations per second and the latency percentiles of one operation. See harness.h
+ * for how it measures, and benchmarks.cpp for the operations.
+ *
+ * Usage: ./a.out [options]
+ *   --list             List the benchmarks, and stop
+ *   --filter=TEXT      Only run the benchmarks whose "group/name" contains TEXT
+ *   --threads=1,2,4    Numbers of threads (default: 1, 2, 4, ... up to the hardware threads)
+ *   --time=SECONDS     Target time of each measurement (default 0.2)
+ *   --csv=FILE         Also write the results to FILE as CSV
+ *   --json=FILE        Also write the results to FILE as JSON
+ *   --compare=FILE     Compare with the results of an earlier run, saved with --csv
+ *   --threshold=PCT    With --compare: a throughput more than PCT percent lower is a regression
+ *                      (default 10)
+ *
+ * The exit status is 1 if --compare found a regression, and 2 for a usage error. A typical use:
+ *     ./a.out --csv=baseline.csv                 # Before the change
+ *     ./a.out --compare=baseline.csv             # After it
+ *
+ * Compare runs made on the same machine, with nothing else running. With more threads than cores,
+ * the operations which wait for another thread measure the scheduler more than the primitive.
+ */
+
+#include "harness.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+struct Options {
+    bool list{false};
+    std::string filter;
+    std::vector<int> thread_counts;
+    double seconds{0.2};
+    std::string csv_file;
+    std::string json_file;
+    std::string compare_file;
+    double threshold{10.0};
+};
+
+std::vector<int> default_thread_counts() {
+    int hardware = std::max(2, static_cast<int>(std::thread::hardware_concurrency()));
+    std::vector<int> counts;
+    for (int n = 1; n < hardware; n *= 2)
+        counts.push_back(n);
+    counts.push_back(hardware);
+    return counts;
+}
+
+// A number, or std::invalid_argument naming the option
+double parse_number(std::string_view option, const std::string &value) {
+    try {
+        std::size_t used;
+        double number = std::stod(value, &used);
+        if (used == value.size())
+            return number;
+    } catch (const std::logic_error &) { // std::invalid_argument or std::out_of_range
+    }
+    throw std::invalid_argument("bad value for " + std::string(option) + ": \"" + value + '"');
+}
+
+std::vector<int> parse_thread_counts(const std::string &text) {
+    std::vector<int> counts;
+    std::istringstream ss(text);
+    for (std::string item; std::getline(ss, item, ',');) {
+        double n = parse_number("--threads", item);
+        if (n < 1 || n != static_cast<int>(n))
+            throw std::invalid_argument("thread counts must be positive integers");
+        counts.push_back(static_cast<int>(n));
+    }
+    return counts;
+}
+
+// Throws std::invalid_argument for an unknown option or a bad value
+Options parse_options(int argc, char *argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        std::string_view name = arg.substr(0, arg.find('='));
+        std::string value = arg.find('=') == std::string_view::npos
+                                ? ""
+                                : std::string(arg.substr(arg.find('=') + 1));
+        if (name == "--list")
+            options.list = true;
+        else if (name == "--filter")
+            options.filter = value;
+        else if (name == "--threads")
+            options.thread_counts = parse_thread_counts(value);
+        else if (name == "--time")
+            options.seconds = parse_number(name, value);
+        else if (name == "--csv")
+            options.csv_file = value;
+        else if (name == "--json")
+            options.json_file = value;
+        else if (name == "--compare")
+            options.compare_file = value;
+        else if (name == "--threshold")
+            options.threshold = parse_number(name, value);
+        else
+            throw std::invalid_argument("unknown option " + std::string(arg));
+    }
+    if (options.thread_counts.empty())
+        options.thread_counts = default_thread_counts();
+    if (options.seconds <= 0)
+        throw std::invalid_argument("--time must be positive");
+    return options;
+}
+
+template <class Write>
+void write_file(const std::string &file, const std::vector<Result> &results, Write write) {
+    std::ofstream out(file);
+    if (!out)
+        throw std::runtime_error("cannot write " + file);
+    write(out, results);
+}
+
+// g++ -std=c++20 -Wall -Wextra -pedantic -pthread -O2 main.cpp harness.cpp benchmarks.cpp thread_pool.cpp && ./a.out
+int main(int argc, char *argv[]) {
+    Options options;
+    try {
+        options = parse_options(argc, argv);
+    } catch (const std::invalid_argument &e) {
+        std::cerr << "Usage error: " << e.what() << '\n';
+        return 2;
+    }
+
+    Registry registry;
+    register_benchmarks(registry);
+
+    std::vector<const Benchmark *> selected;
+    for (const auto &b : registry.benchmarks()) {
+        if ((b.group + "/" + b.name).find(options.filter) != std::string::npos)
+            selected.push_back(&b);
+    }
+    if (options.list) {
+        for (const auto *b : selected)
+            std::cout << b->group << '/' << b->name
+                      << (b->thread_multiple > 1 ? " (pairs of threads)" : "") << '\n';
+        return 0;
+    }
+
+    try {
+        std::vector<Result> baseline;
+        if (!options.compare_file.empty()) {
+            std::ifstream in(options.compare_file);
+            if (!in)
+                throw std::runtime_error("cannot read " + options.compare_file);
+            baseline = read_csv(in);
+        }
+
+        std::vector<Result> results;
+        print_table_header(std::cout);
+        for (const auto *b : selected) {
+            for (int threads : options.thread_counts) {
+                if (threads % b->thread_multiple != 0)
+                    continue;
+                results.push_back(measure(*b, threads, options.seconds));
+                print_table_row(std::cout, results.back());
+            }
+        }
+
+        if (!options.csv_file.empty())
+            write_file(options.csv_file, results, write_csv);
+        if (!options.json_file.empty())
+            write_file(options.json_file, results, write_json);
+
+        if (!options.compare_file.empty()) {
+            std::cout << "--------------------------------\n";
+            int regressions = compare_results(std::cout, baseline, results, options.threshold);
+            std::cout << regressions << " regression(s) of more than " << options.threshold
+                      << "%\n";
+            return regressions > 0 ? 1 : 0;
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 2;
+    }
+}
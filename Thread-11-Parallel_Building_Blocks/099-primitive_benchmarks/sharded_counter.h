@@ -0,0 +1,259 @@
+/**
+ * Sharded counters and statistics
+ *
+ * `055-integer_operations_and_threads.cpp` and `056-atomic_types.cpp` make a shared counter correct
+ * with a mutex or with std::atomic<int>. Both are correct, but neither scales:
+ * - Every ++counter needs exclusive ownership of the cache line which holds the counter.
+ * - With many cores incrementing, the cache line "ping-pongs" between them and each increment
+ *   waits for the line to arrive from another core.
+ *
+ * A sharded counter splits the count into slots:
+ * - Each thread is given its own slot, and each slot is padded to a cache line of its own.
+ * - Incrementing only touches this thread's slot. The cache line stays in this core's cache, so
+ *   the atomic increment is as cheap as an uncontended one.
+ * - Reading the value adds up all the slots. Reads are much rarer than increments, so we move the
+ *   cost from the writers to the readers.
+ *
+ * A slot is still an atomic, because there may be more threads than slots and two threads may
+ * share one. The operations use std::memory_order_relaxed: a statistic needs atomicity, not
+ * ordering with other data.
+ *
+ * A snapshot is not taken at a single instant. Slots which are read later may include increments
+ * made after earlier slots were read. For a statistic this is fine: once the writers stop, the
+ * snapshot is exact.
+ */
+
+#ifndef SHARDED_COUNTER_H
+#define SHARDED_COUNTER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+// Size of a cache line. std::hardware_destructive_interference_size is C++17, but some compilers
+// warn about using it in headers because its value may differ between translation units.
+constexpr std::size_t cache_line_size = 64;
+
+// Threads are numbered in the order they first use ANY sharded object, whatever its slot type.
+// Consecutive threads get different slots. This is not a member of Shards, which would number the
+// threads again for each slot type.
+inline std::size_t thread_index() {
+    static std::atomic<std::size_t> next_index{0};
+    thread_local std::size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+// Owns one padded slot per shard and maps each thread to a slot
+template <class Slot> class Shards {
+    struct alignas(cache_line_size) PaddedSlot {
+        Slot slot;
+    };
+
+    std::unique_ptr<PaddedSlot[]> slots;
+    std::size_t mask;
+
+    // Enough slots for every hardware thread, rounded up to a power of two
+    static std::size_t default_count() {
+        std::size_t wanted = std::max(1u, std::thread::hardware_concurrency());
+        std::size_t count = 1;
+        while (count < wanted)
+            count *= 2;
+        return count;
+    }
+
+  public:
+    explicit Shards(std::size_t count = default_count()) {
+        // The thread index is masked, so round the count up to a power of two
+        std::size_t pow2 = 1;
+        while (pow2 < count)
+            pow2 *= 2;
+        mask = pow2 - 1;
+        slots = std::make_unique<PaddedSlot[]>(pow2);
+    }
+
+    // This thread's slot
+    Slot &local() { return slots[thread_index() & mask].slot; }
+
+    std::size_t size() const { return mask + 1; }
+    const Slot &operator[](std::size_t i) const { return slots[i].slot; }
+    Slot &operator[](std::size_t i) { return slots[i].slot; }
+};
+
+// A counter which many threads can increment without contention
+class ShardedCounter {
+    Shards<std::atomic<long>> shards;
+
+  public:
+    ShardedCounter() = default;
+    explicit ShardedCounter(std::size_t nshards) : shards(nshards) {}
+
+    void add(long n) { shards.local().fetch_add(n, std::memory_order_relaxed); }
+    void operator++() { add(1); }
+    void operator+=(long n) { add(n); }
+
+    // Sum of all the slots
+    long value() const {
+        long sum = 0;
+        for (std::size_t i = 0; i < shards.size(); ++i)
+            sum += shards[i].load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    // Only call this when no other thread is adding
+    void reset() {
+        for (std::size_t i = 0; i < shards.size(); ++i)
+            shards[i].store(0, std::memory_order_relaxed);
+    }
+};
+
+// Replace "extreme" by "value" if better(value, extreme). Only writes when the value is a new
+// extreme, so after a short warm-up almost every call is just a load and the cache line is not
+// even modified.
+template <class T, class Better>
+void update_extreme(std::atomic<T> &extreme, T value, Better better) {
+    T current = extreme.load(std::memory_order_relaxed);
+    while (better(value, current) &&
+           !extreme.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+// Tracks the smallest and largest value seen
+template <class T> class ShardedMinMax {
+    struct Slot {
+        std::atomic<T> min{std::numeric_limits<T>::max()};
+        std::atomic<T> max{std::numeric_limits<T>::lowest()};
+    };
+
+    Shards<Slot> shards;
+
+  public:
+    struct Snapshot {
+        T min{std::numeric_limits<T>::max()};
+        T max{std::numeric_limits<T>::lowest()};
+    };
+
+    ShardedMinMax() = default;
+    explicit ShardedMinMax(std::size_t nshards) : shards(nshards) {}
+
+    void record(T value) {
+        Slot &slot = shards.local();
+        update_extreme(slot.min, value, [](T a, T b) { return a < b; });
+        update_extreme(slot.max, value, [](T a, T b) { return a > b; });
+    }
+
+    Snapshot snapshot() const {
+        Snapshot snap;
+        for (std::size_t i = 0; i < shards.size(); ++i) {
+            snap.min = std::min(snap.min, shards[i].min.load(std::memory_order_relaxed));
+            snap.max = std::max(snap.max, shards[i].max.load(std::memory_order_relaxed));
+        }
+        return snap;
+    }
+};
+
+/**
+ * Histogram with fixed bucket boundaries, e.g. {10, 100, 1000} gives the buckets
+ * (-inf, 10), [10, 100), [100, 1000), [1000, +inf)
+ * It also keeps the count, sum, minimum and maximum of the recorded values.
+ */
+template <class T> class ShardedHistogram {
+    std::vector<T> bounds;
+
+    // The bucket counts of a slot are stored in whole cache lines of their own, so that they do
+    // not share a cache line with another slot's buckets
+    static constexpr std::size_t per_line = cache_line_size / sizeof(std::atomic<long>);
+    struct alignas(cache_line_size) BucketLine {
+        std::atomic<long> counts[per_line];
+    };
+
+    struct Slot {
+        std::unique_ptr<BucketLine[]> lines;
+        std::atomic<long> count{0};
+        std::atomic<T> sum{0};
+        std::atomic<T> min{std::numeric_limits<T>::max()};
+        std::atomic<T> max{std::numeric_limits<T>::lowest()};
+    };
+
+    Shards<Slot> shards;
+
+    void init() {
+        std::sort(bounds.begin(), bounds.end());
+        for (std::size_t i = 0; i < shards.size(); ++i)
+            shards[i].lines = std::make_unique<BucketLine[]>(bounds.size() / per_line + 1);
+    }
+
+  public:
+    struct Snapshot {
+        std::vector<T> bounds;
+        std::vector<long> buckets; // buckets.size() == bounds.size() + 1
+        long count{0};
+        T sum{0};
+        T min{std::numeric_limits<T>::max()};
+        T max{std::numeric_limits<T>::lowest()};
+
+        double mean() const { return count ? static_cast<double>(sum) / count : 0.0; }
+
+        // Estimate of the value below which "fraction" of the values lie, e.g. 0.99 for p99.
+        // Returns the upper bound of the bucket which contains it (or max, for the last bucket).
+        T percentile(double fraction) const {
+            long target = static_cast<long>(fraction * count);
+            long seen = 0;
+            for (std::size_t i = 0; i < bounds.size(); ++i) {
+                seen += buckets[i];
+                if (seen > target)
+                    return bounds[i];
+            }
+            return max;
+        }
+    };
+
+    explicit ShardedHistogram(std::vector<T> bounds) : bounds(std::move(bounds)) { init(); }
+    ShardedHistogram(std::vector<T> bounds, std::size_t nshards)
+        : bounds(std::move(bounds)), shards(nshards) {
+        init();
+    }
+
+    void record(T value) {
+        Slot &slot = shards.local();
+
+        // Index of the first bound which is greater than the value
+        auto bucket = std::upper_bound(bounds.begin(), bounds.end(), value) - bounds.begin();
+        slot.lines[bucket / per_line].counts[bucket % per_line].fetch_add(1,
+                                                                     std::memory_order_relaxed);
+        slot.count.fetch_add(1, std::memory_order_relaxed);
+
+        // std::atomic<double>::fetch_add is C++20, but not every library has it yet, so use a
+        // compare-exchange loop. It almost never retries, because the slot is rarely shared.
+        T sum = slot.sum.load(std::memory_order_relaxed);
+        while (!slot.sum.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed)) {
+        }
+
+        update_extreme(slot.min, value, [](T a, T b) { return a < b; });
+        update_extreme(slot.max, value, [](T a, T b) { return a > b; });
+    }
+
+    Snapshot snapshot() const {
+        Snapshot snap;
+        snap.bounds = bounds;
+        snap.buckets.assign(bounds.size() + 1, 0);
+
+        for (std::size_t i = 0; i < shards.size(); ++i) {
+            const Slot &slot = shards[i];
+            for (std::size_t b = 0; b <= bounds.size(); ++b)
+                snap.buckets[b] +=
+                    slot.lines[b / per_line].counts[b % per_line].load(std::memory_order_relaxed);
+            snap.count += slot.count.load(std::memory_order_relaxed);
+            snap.sum += slot.sum.load(std::memory_order_relaxed);
+            snap.min = std::min(snap.min, slot.min.load(std::memory_order_relaxed));
+            snap.max = std::max(snap.max, slot.max.load(std::memory_order_relaxed));
+        }
+        return snap;
+    }
+};
+
+#endif // SHARDED_COUNTER_H